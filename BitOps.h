@@ -0,0 +1,102 @@
+//==============================================================================================================================================================
+// Bit manipulation helpers for processing packed voxel words
+//==============================================================================================================================================================
+
+#pragma once
+
+#include <Windows.h>
+#include <intrin.h>
+
+//==============================================================================================================================================================
+
+// index of the lowest set bit; m must not be zero
+inline UINT LowestSetBit(UINT32 m) {
+	unsigned long index;
+	_BitScanForward(&index, m);
+	return UINT(index);
+}
+
+inline UINT LowestSetBit(UINT64 m) {
+	unsigned long index;
+	_BitScanForward64(&index, m);
+	return UINT(index);
+}
+
+// mask with bits [begin, end) set, for 0 <= begin < end <= 32
+inline UINT32 BitRangeMask(UINT begin, UINT end) {
+	return (~0u >> (32 - (end - begin))) << begin;
+}
+
+// Occluded fills: the bits of mask reachable from seeds, which have to be a subset of mask, by moving through mask towards higher
+// (FillRunsUp) or lower (FillRunsDown) bits, i.e. each seed's run of mask above or below it; doubles the distance filled per step
+// (Kogge-Stone), taking log2 of the word size steps.
+template<typename T>
+inline T FillRunsUp(T seeds, T mask) {
+	for(UINT shift = 1; shift < sizeof(T) * 8; shift <<= 1) {
+		seeds |= mask & (seeds << shift);
+		mask &= mask << shift;
+	}
+	return seeds;
+}
+
+template<typename T>
+inline T FillRunsDown(T seeds, T mask) {
+	for(UINT shift = 1; shift < sizeof(T) * 8; shift <<= 1) {
+		seeds |= mask & (seeds >> shift);
+		mask &= mask >> shift;
+	}
+	return seeds;
+}
+
+// Transposes a 32x32 bit matrix in place, so that bit j of m[i] ends up as bit i of m[j]; recursively swaps the off-diagonal blocks
+// of size 16, 8, 4, 2 and 1 (Hacker's Delight, 7-3).
+inline void Transpose32x32(UINT32 m[32]) {
+	UINT32 mask = 0x0000ffffu;
+	for(UINT j = 16; j != 0; j >>= 1, mask ^= mask << j) {
+		for(UINT k = 0; k < 32; k = ((k | j) + 1) & ~j) {
+			const UINT32 t = ((m[k] >> j) ^ m[k | j]) & mask;
+			m[k] ^= t << j;
+			m[k | j] ^= t;
+		}
+	}
+}
+
+// Transpose32x32 with four rows per SSE2 register: the swaps of blocks of size 16, 8 and 4 pair whole registers, those of size 2 and
+// 1 pair rows within a register.
+inline void Transpose32x32Sse2(UINT32 m[32]) {
+	__m128i r[8];
+	for(UINT i = 0; i < 8; i++)
+		r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m + i * 4));
+
+	const int shifts[3] = { 16, 8, 4 };
+	const UINT32 masks[3] = { 0x0000ffffu, 0x00ff00ffu, 0x0f0f0f0fu };
+	for(UINT level = 0; level < 3; level++) {
+		const UINT j = 4 >> level;		// distance of paired registers
+		const __m128i mask = _mm_set1_epi32(int(masks[level]));
+		const __m128i shift = _mm_cvtsi32_si128(shifts[level]);
+		for(UINT k = 0; k < 8; k = ((k | j) + 1) & ~j) {
+			const __m128i t = _mm_and_si128(_mm_xor_si128(_mm_srl_epi32(r[k], shift), r[k | j]), mask);
+			r[k] = _mm_xor_si128(r[k], _mm_sll_epi32(t, shift));
+			r[k | j] = _mm_xor_si128(r[k | j], t);
+		}
+	}
+
+	const __m128i mask2 = _mm_set1_epi32(0x33333333);
+	const __m128i mask1 = _mm_set1_epi32(0x55555555);
+	for(UINT i = 0; i < 8; i++) {
+		// rows 0, 1 with rows 2, 3
+		__m128i a = _mm_shuffle_epi32(r[i], _MM_SHUFFLE(1, 0, 1, 0));
+		__m128i b = _mm_shuffle_epi32(r[i], _MM_SHUFFLE(3, 2, 3, 2));
+		__m128i t = _mm_and_si128(_mm_xor_si128(_mm_srli_epi32(a, 2), b), mask2);
+		r[i] = _mm_unpacklo_epi64(_mm_xor_si128(a, _mm_slli_epi32(t, 2)), _mm_xor_si128(b, t));
+
+		// rows 0, 2 with rows 1, 3
+		a = _mm_shuffle_epi32(r[i], _MM_SHUFFLE(2, 0, 2, 0));
+		b = _mm_shuffle_epi32(r[i], _MM_SHUFFLE(3, 1, 3, 1));
+		t = _mm_and_si128(_mm_xor_si128(_mm_srli_epi32(a, 1), b), mask1);
+		r[i] = _mm_unpacklo_epi32(_mm_xor_si128(a, _mm_slli_epi32(t, 1)), _mm_xor_si128(b, t));
+	}
+
+	for(UINT i = 0; i < 8; i++)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(m + i * 4), r[i]);
+}
@@ -0,0 +1,1539 @@
+//==============================================================================================================================================================
+// CPU implementation of the compute-shader voxelization methods, with configurable voxel word width
+//==============================================================================================================================================================
+
+#include "CpuVoxelizer.h"
+#include "BitOps.h"
+#include "VoxelizationCommon.hlsli"
+#include "Parallel.h"
+#include "Profiler.h"
+#include <intrin.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// vector types and the code shared with the shaders
+	using namespace hlsl;
+
+	// triangles are handed out to worker threads in chunks of this size
+	const UINT64 c_trianglesPerChunk = 1024;
+
+	// rows of the bands of the grid that VoxelizeOnCpu fills the attributes of one at a time
+	const UINT c_attributeBandRows = 8;
+
+	// size of the pixel tiles of the rasterization in VoxelizeSurface
+	const int c_tileSize = 8;
+
+	inline void AtomicOr(UINT32* address, UINT32 voxels) {
+		_InterlockedOr(reinterpret_cast<volatile long*>(address), long(voxels));
+	}
+
+	inline void AtomicOr(UINT64* address, UINT64 voxels) {
+		_InterlockedOr64(reinterpret_cast<volatile __int64*>(address), __int64(voxels));
+	}
+
+	inline UINT32 AtomicIncrement(UINT32* address) {
+		return UINT32(_InterlockedExchangeAdd(reinterpret_cast<volatile long*>(address), 1));
+	}
+
+	inline UINT CountBits(UINT32 voxels) {
+		return __popcnt(voxels);
+	}
+
+	inline UINT CountBits(UINT64 voxels) {
+		return UINT(__popcnt64(voxels));
+	}
+
+	inline void AtomicXor(UINT32* address, UINT32 voxels) {
+		_InterlockedXor(reinterpret_cast<volatile long*>(address), long(voxels));
+	}
+
+	inline void AtomicXor(UINT64* address, UINT64 voxels) {
+		_InterlockedXor64(reinterpret_cast<volatile __int64*>(address), __int64(voxels));
+	}
+
+	inline float min3(float a, float b, float c) {
+		return std::min(a, std::min(b, c));
+	}
+
+	inline float max3(float a, float b, float c) {
+		return std::max(a, std::max(b, c));
+	}
+
+	// Normals are summed with 8 fractional bits in three signed 21-bit fields of a 64-bit integer. A negative field borrows from the
+	// next one, which is undone when unpacking, so the sums are exact while each component's magnitude stays below 2^20, i.e. for up
+	// to 4112 unit normals.
+	const float c_normalScale = 255.0f;
+	const INT64 c_normalField = INT64(1) << 21;
+
+	inline INT64 PackNormal(const float3& n) {
+		return INT64(lroundf(n.x * c_normalScale)) + INT64(lroundf(n.y * c_normalScale)) * c_normalField + INT64(lroundf(n.z * c_normalScale)) * c_normalField * c_normalField;
+	}
+
+	// normalized sum as DXGI_FORMAT_R8G8B8A8_SNORM, zero if the normals cancel out
+	inline UINT32 UnpackNormalSum(INT64 sum) {
+		float n[3];
+		for(UINT i = 0; i < 2; i++) {
+			const INT64 component = INT64(UINT64(sum) << 43) >> 43;
+			n[i] = float(component);
+			sum = (sum - component) / c_normalField;
+		}
+		n[2] = float(sum);
+
+		const float lengthSq = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+		if(lengthSq == 0.0f)
+			return 0;
+
+		const float s = 127.0f / sqrtf(lengthSq);
+		UINT32 packed = 0;
+		for(UINT i = 0; i < 3; i++)
+			packed |= UINT32(UINT8(INT8(lroundf(n[i] * s)))) << (i * 8);
+		return packed;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename TWord>
+	class Voxelizer {
+	public:
+		static const UINT c_wordBits = BasicVoxelGrid<TWord>::c_wordBits;
+		static const UINT c_wordShift = BasicVoxelGrid<TWord>::c_wordShift;
+
+		Voxelizer(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], BasicVoxelGrid<TWord>& grid)
+			: m_mesh(mesh), m_matModelToVoxel(matModelToVoxel), m_voxels(grid.GetData()), m_strideX(grid.GetStrideX()), m_strideY(grid.GetStrideY())
+		{
+			m_gridSize[0] = grid.GetGridSize()[0];
+			m_gridSize[1] = grid.GetGridSize()[1];
+			m_gridSize[2] = grid.GetGridSize()[2];
+		}
+
+		void VoxelizeSolid(UINT tri) const;
+
+		// propagates within rows [rowBegin, rowEnd) of the section and returns the last row's word, i.e. the XOR of the rows' words;
+		// XORing carry, the XOR of all rows before rowBegin, into the rows then completes the propagation
+		TWord VoxelizeSolid_Propagate(UINT64 section, UINT rowBegin, UINT rowEnd) const;
+		void VoxelizeSolid_PropagateCarry(UINT64 section, UINT rowBegin, UINT rowEnd, TWord carry) const;
+
+		// row containing the triangle's center, clamped to the grid
+		UINT GetCenterRow(UINT tri) const {
+			const float y = (LoadVertex(m_mesh.m_indices[tri * 3]).y + LoadVertex(m_mesh.m_indices[tri * 3 + 1]).y + LoadVertex(m_mesh.m_indices[tri * 3 + 2]).y) / 3.0f;
+			return (y >= 0.0f) ? std::min(UINT(std::min(y, float(m_gridSize[1]))), m_gridSize[1] - 1) : 0;
+		}
+
+		// rows [rowBegin, rowEnd) that the voxels of the triangle may lie in, clamped to the grid
+		void GetRowRange(UINT tri, UINT& rowBegin, UINT& rowEnd) const {
+			const float y0 = LoadVertex(m_mesh.m_indices[tri * 3]).y;
+			const float y1 = LoadVertex(m_mesh.m_indices[tri * 3 + 1]).y;
+			const float y2 = LoadVertex(m_mesh.m_indices[tri * 3 + 2]).y;
+			const float yMin = floorf(min3(y0, y1, y2)) - 1.0f;
+			const float yMax = floorf(max3(y0, y1, y2)) + 2.0f;
+			rowBegin = (yMin > 0.0f) ? UINT(std::min(yMin, float(m_gridSize[1]))) : 0;
+			rowEnd = (yMax > 0.0f) ? UINT(std::min(yMax, float(m_gridSize[1]))) : 0;
+		}
+
+		// call emit(address, voxels) for the voxels of the triangle within rows [rowBegin, rowEnd), as AtomicOr would be called for them
+		template<typename Emit>
+		void VoxelizeSurface(UINT tri, const Emit& emit, UINT rowBegin = 0, UINT rowEnd = UINT_MAX) const;
+		template<typename Emit>
+		void VoxelizeSurfaceConservative(UINT tri, const Emit& emit, UINT rowBegin = 0, UINT rowEnd = UINT_MAX) const;
+
+		// unit normal cross(v1 - v0, v2 - v0) of the untransformed triangle; zero for degenerate triangles
+		float3 GetModelNormal(UINT tri) const {
+			const float* p0 = m_mesh.m_vertices + UINT64(m_mesh.m_indices[tri * 3]) * m_mesh.m_vertexFloatStride;
+			const float* p1 = m_mesh.m_vertices + UINT64(m_mesh.m_indices[tri * 3 + 1]) * m_mesh.m_vertexFloatStride;
+			const float* p2 = m_mesh.m_vertices + UINT64(m_mesh.m_indices[tri * 3 + 2]) * m_mesh.m_vertexFloatStride;
+			const float3 e0 = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float3 e1 = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float3 n = cross(e0, e1);
+			if(!(dot(n, n) > 0.0f)) {
+				const float3 zero = { 0.0f, 0.0f, 0.0f };
+				return zero;
+			}
+			return normalize(n);
+		}
+
+	private:
+		float3 LoadVertex(UINT index) const {
+			const float* p = m_mesh.m_vertices + UINT64(index) * m_mesh.m_vertexFloatStride;
+			const float* m = m_matModelToVoxel;
+			const float w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+			const float3 v = {
+				(m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3]) / w,
+				(m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7]) / w,
+				(m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11]) / w,
+			};
+			return v;
+		}
+
+		UINT64 GetAddress(UINT x, UINT y, UINT z) const {
+			return UINT64(x) * m_strideX + UINT64(y) * m_strideY + (z >> c_wordShift);
+		}
+
+		static TWord GetBit(UINT z) {
+			return TWord(1) << (z & (c_wordBits - 1));
+		}
+
+		const CpuVoxelizationMesh& m_mesh;
+		const float* m_matModelToVoxel;
+		TWord* m_voxels;
+		UINT m_gridSize[3];
+		UINT m_strideX;
+		UINT64 m_strideY;
+	};
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename TWord>
+	void Voxelizer<TWord>::VoxelizeSolid(UINT tri) const {
+		// load triangle's vertices and order them ascending by index
+		const uint3 indices = SortTriangleIndices(uint3(m_mesh.m_indices[tri * 3], m_mesh.m_indices[tri * 3 + 1], m_mesh.m_indices[tri * 3 + 2]));
+
+		// transform vertices to voxel space
+		const float3 v0 = LoadVertex(indices.x);
+		const float3 v1 = LoadVertex(indices.y);
+		const float3 v2 = LoadVertex(indices.z);
+
+		// determine bounding box in xz
+		const float2 vMin = { min3(v0.x, v1.x, v2.x), min3(v0.z, v1.z, v2.z) };
+		const float2 vMax = { max3(v0.x, v1.x, v2.x), max3(v0.z, v1.z, v2.z) };
+
+		// derive bounding box of covered voxel columns and check if any are covered at all
+		const uint3 gridSize(m_gridSize[0], m_gridSize[1], m_gridSize[2]);
+		int2 voxMin, voxMax;
+		if(!DetermineSolidColumns(vMin, vMax, gridSize, voxMin, voxMax))
+			return;
+
+		// triangle setup as in CS_SetupTriangles
+		const float3 e0 = v1 - v0;
+		const float3 e1 = v2 - v1;
+		const float3 e2 = v0 - v2;
+		const float3 n = cross(e2, e0);
+
+		if(n.y == 0.0f)
+			return;
+
+		// triangle's plane
+		const float dTri = -dot(n, v0);
+
+		// edge equations
+		float2 ne0, ne1, ne2;
+		float de0, de1, de2;
+		const float orientation = n.y > 0.0f ? -1.0f : 1.0f;
+		Determine2dEdgeEquation(ne0, de0, orientation, e0.x, e0.z, v0.x, v0.z);
+		Determine2dEdgeEquation(ne1, de1, orientation, e1.x, e1.z, v1.x, v1.z);
+		Determine2dEdgeEquation(ne2, de2, orientation, e2.x, e2.z, v0.x, v0.z);
+
+		// the grid's words hold the same bits at the same byte addresses as the shader's 32-bit words
+		VoxelizeSolidColumns(RWByteAddressBuffer(m_voxels), gridSize, m_strideX * sizeof(TWord), m_strideY * sizeof(TWord), voxMin, voxMax,
+			n, dTri, ne0, de0, ne1, de1, ne2, de2);
+	}
+
+	// propagates the flipped voxels along y; a section is one word of an xz slice, so with 64-bit words there are half as many
+	template<typename TWord>
+	TWord Voxelizer<TWord>::VoxelizeSolid_Propagate(UINT64 section, UINT rowBegin, UINT rowEnd) const {
+		if(rowBegin >= rowEnd)
+			return 0;
+
+		TWord* address = m_voxels + section + rowBegin * m_strideY;
+		TWord lastBlock = *address;
+		for(UINT y = rowBegin + 1; y < rowEnd; y++) {
+			address += m_strideY;
+
+			TWord currBlock = *address;
+			if(lastBlock != 0) {
+				currBlock ^= lastBlock;
+				*address = currBlock;
+			}
+			lastBlock = currBlock;
+		}
+		return lastBlock;
+	}
+
+	template<typename TWord>
+	void Voxelizer<TWord>::VoxelizeSolid_PropagateCarry(UINT64 section, UINT rowBegin, UINT rowEnd, TWord carry) const {
+		if(carry == 0)
+			return;
+
+		TWord* address = m_voxels + section + rowBegin * m_strideY;
+		for(UINT y = rowBegin; y < rowEnd; y++, address += m_strideY)
+			*address ^= carry;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// Rasterizes the triangle along z like VS_Voxelize and PS_VoxelizeSurface: pixel (x, y) of the dummy render target covers voxel
+	// column (x, y), a fragment is generated if the pixel center lies inside of the triangle or on a top or left edge, and it sets the
+	// voxel containing the interpolated position. Fragments outside of [0, gridSizeZ] in z are clipped. The edge functions are evaluated
+	// in floating point at the pixel centers rather than in the rasterizer's fixed point, so results may differ for pixel centers within
+	// a subpixel of an edge. The triangle's bounding box is traversed in 8x8 tiles, which are skipped if an edge function is negative at
+	// all pixel centers and whose edge tests are skipped if all edge functions are positive at all pixel centers; the remaining tests
+	// and depth interpolation process four pixels at a time.
+	template<typename TWord>
+	template<typename Emit>
+	void Voxelizer<TWord>::VoxelizeSurface(UINT tri, const Emit& emit, UINT rowBegin, UINT rowEnd) const {
+		// load triangle's vertices and transform them to voxel space
+		const float3 v0 = LoadVertex(m_mesh.m_indices[tri * 3]);
+		const float3 v1 = LoadVertex(m_mesh.m_indices[tri * 3 + 1]);
+		const float3 v2 = LoadVertex(m_mesh.m_indices[tri * 3 + 2]);
+
+		// determine covered pixel centers' bounding box, clipped to the render target and the rows
+		const int pixMinX = std::max(0, int(ceilf(min3(v0.x, v1.x, v2.x) - 0.5f)));
+		const int pixMinY = std::max(int(std::min(rowBegin, m_gridSize[1])), int(ceilf(min3(v0.y, v1.y, v2.y) - 0.5f)));
+		const int pixMaxX = std::min(int(m_gridSize[0]) - 1, int(floorf(max3(v0.x, v1.x, v2.x) - 0.5f)));
+		const int pixMaxY = std::min(int(std::min(rowEnd, m_gridSize[1])) - 1, int(floorf(max3(v0.y, v1.y, v2.y) - 0.5f)));
+
+		if(pixMinX > pixMaxX || pixMinY > pixMaxY)
+			return;
+
+		// triangle setup; degenerate triangles in xy generate no fragments
+		const float3 e0 = v1 - v0;
+		const float3 e1 = v2 - v1;
+		const float3 e2 = v2 - v0;
+		const float3 n = cross(e0, e2);
+
+		if(n.z == 0.0f)
+			return;
+
+		// edge equations, positive inside of the triangle
+		float2 ne0 = { -e0.y,  e0.x };
+		float2 ne1 = { -e1.y,  e1.x };
+		float2 ne2 = {  e2.y, -e2.x };
+		if(n.z < 0.0f) {
+			ne0.x = -ne0.x; ne0.y = -ne0.y;
+			ne1.x = -ne1.x; ne1.y = -ne1.y;
+			ne2.x = -ne2.x; ne2.y = -ne2.y;
+		}
+
+		const float de0 = -(ne0.x * v0.x + ne0.y * v0.y);
+		const float de1 = -(ne1.x * v1.x + ne1.y * v1.y);
+		const float de2 = -(ne2.x * v0.x + ne2.y * v0.y);
+
+		// determine whether edge is left edge or top edge; the render target's rows run downwards, i.e. along -y
+		const float ce0 = DetermineTopLeftBias(ne0);
+		const float ce1 = DetermineTopLeftBias(ne1);
+		const float ce2 = DetermineTopLeftBias(ne2);
+
+		// interpolation of z: z = zx * x + zy * y + z0
+		const float nzInv = 1.0f / n.z;
+		const float zx = -n.x * nzInv;
+		const float zy = -n.y * nzInv;
+		const float z0 = v0.z + (n.x * v0.x + n.y * v0.y) * nzInv;
+		const float zMax = float(m_gridSize[2]);
+
+		const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 ne0x = _mm_set1_ps(ne0.x), ne0y = _mm_set1_ps(ne0.y), de0v = _mm_set1_ps(de0), ce0v = _mm_set1_ps(ce0);
+		const __m128 ne1x = _mm_set1_ps(ne1.x), ne1y = _mm_set1_ps(ne1.y), de1v = _mm_set1_ps(de1), ce1v = _mm_set1_ps(ce1);
+		const __m128 ne2x = _mm_set1_ps(ne2.x), ne2y = _mm_set1_ps(ne2.y), de2v = _mm_set1_ps(de2), ce2v = _mm_set1_ps(ce2);
+		const __m128 zxv = _mm_set1_ps(zx), zyv = _mm_set1_ps(zy), z0v = _mm_set1_ps(z0);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 zMaxv = _mm_set1_ps(zMax);
+
+		// extremes of an edge function over the pixel centers of a tile; as every operation rounds monotonically, they bound the
+		// values computed per pixel exactly
+		auto edgeRange = [](const float2& ne, float de, float ce, float x0, float y0, float& minValue, float& maxValue) {
+			const float x1 = x0 + float(c_tileSize - 1);
+			const float y1 = y0 + float(c_tileSize - 1);
+			minValue = (ne.x * (ne.x > 0.0f ? x0 : x1) + ne.y * (ne.y > 0.0f ? y0 : y1)) + de + ce;
+			maxValue = (ne.x * (ne.x > 0.0f ? x1 : x0) + ne.y * (ne.y > 0.0f ? y1 : y0)) + de + ce;
+		};
+
+		for(int tileY = pixMinY & ~(c_tileSize - 1); tileY <= pixMaxY; tileY += c_tileSize) {
+			for(int tileX = pixMinX & ~(c_tileSize - 1); tileX <= pixMaxX; tileX += c_tileSize) {
+				// classify tile
+				const float x0 = float(tileX) + 0.5f;
+				const float y0 = float(tileY) + 0.5f;
+				float min0, max0, min1, max1, min2, max2;
+				edgeRange(ne0, de0, ce0, x0, y0, min0, max0);
+				edgeRange(ne1, de1, ce1, x0, y0, min1, max1);
+				edgeRange(ne2, de2, ce2, x0, y0, min2, max2);
+				if(max0 <= 0.0f || max1 <= 0.0f || max2 <= 0.0f)
+					continue;
+				const bool inside = min0 > 0.0f && min1 > 0.0f && min2 > 0.0f;
+
+				const int rowEnd = std::min(tileY + c_tileSize, pixMaxY + 1);
+				for(int y = std::max(tileY, pixMinY); y < rowEnd; y++) {
+					const __m128 py = _mm_set1_ps(float(y) + 0.5f);
+					const __m128 e0y = _mm_mul_ps(ne0y, py);
+					const __m128 e1y = _mm_mul_ps(ne1y, py);
+					const __m128 e2y = _mm_mul_ps(ne2y, py);
+					const __m128 zRow = _mm_mul_ps(zyv, py);
+
+					for(int x = tileX; x < tileX + c_tileSize; x += 4) {
+						const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+
+						// test whether pixel centers are inside triangle
+						int mask = 15;
+						if(!inside) {
+							const __m128 f0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ne0x, px), e0y), de0v), ce0v);
+							const __m128 f1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ne1x, px), e1y), de1v), ce1v);
+							const __m128 f2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ne2x, px), e2y), de2v), ce2v);
+							mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(f0, zero), _mm_and_ps(_mm_cmpgt_ps(f1, zero), _mm_cmpgt_ps(f2, zero))));
+						}
+
+						// interpolate z and clip against near and far plane
+						const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(zxv, px), zRow), z0v);
+						mask &= _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, zMaxv)));
+
+						// exclude pixels outside of the bounding box
+						mask &= (15 << std::max(0, pixMinX - x)) & (15 >> std::max(0, x + 3 - pixMaxX));
+						if(mask == 0)
+							continue;
+
+						// set voxels
+						int voxZ[4];
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(voxZ), _mm_cvttps_epi32(z));
+						for(int i = 0; i < 4; i++) {
+							if((mask & (1 << i)) && voxZ[i] < int(m_gridSize[2]))
+								emit(&m_voxels[GetAddress(x + i, y, voxZ[i])], GetBit(voxZ[i]));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	template<typename TWord>
+	template<typename Emit>
+	void Voxelizer<TWord>::VoxelizeSurfaceConservative(UINT tri, const Emit& emit, UINT rowBegin, UINT rowEnd) const {
+		// load triangle's vertices and transform them to voxel space
+		const float3 v0 = LoadVertex(m_mesh.m_indices[tri * 3]);
+		const float3 v1 = LoadVertex(m_mesh.m_indices[tri * 3 + 1]);
+		const float3 v2 = LoadVertex(m_mesh.m_indices[tri * 3 + 2]);
+
+		// determine bounding box
+		const float3 vMin = { min3(v0.x, v1.x, v2.x), min3(v0.y, v1.y, v2.y), min3(v0.z, v1.z, v2.z) };
+		const float3 vMax = { max3(v0.x, v1.x, v2.x), max3(v0.y, v1.y, v2.y), max3(v0.z, v1.z, v2.z) };
+
+		// determine bounding box clipped to voxel grid and check if any voxels are covered at all
+		float3 voxMin, voxMax;
+		UINT flatDimensions;
+		if(!DetermineConservativeBounds(vMin, vMax, uint3(m_gridSize[0], m_gridSize[1], m_gridSize[2]), voxMin, voxMax, flatDimensions))
+			return;
+
+		// clip the bounding box to the rows; the depth ranges along y are determined from the unclipped one, so that the voxels of
+		// each row are the same as without clipping
+		const float unclippedMinY = voxMin.y;
+		const float unclippedMaxY = voxMax.y;
+		voxMin.y = std::max(voxMin.y, float(rowBegin));
+		voxMax.y = std::min(voxMax.y, float(rowEnd));
+		if(voxMin.y >= voxMax.y)
+			return;
+
+		// The bounds, line ranges, edge equations and depth ranges are those of CS_VoxelizeSurfaceConservative, but the loops differ from the
+		// shader's: they emit words rather than single voxels and gather the voxels of a word along z before emitting it.
+
+		//---- 1D: set all voxels in bounding box ----
+		if((flatDimensions & 3) >= 2) {
+			TWord* address = m_voxels + GetAddress(UINT(voxMin.x), UINT(voxMin.y), UINT(voxMin.z));
+			const uint2 range = DetermineLineRange(voxMin, voxMax, flatDimensions);
+
+			// 1x1xN: set all voxels, up to c_wordBits consecutive ones at a time
+			if((flatDimensions & FLATDIM_Z) == 0) {
+				TWord voxels = (~TWord(0)) << (range.x & (c_wordBits - 1));
+				const UINT lastZ = range.y & ~(c_wordBits - 1);
+
+				for(UINT z = range.x & ~(c_wordBits - 1); z < lastZ; z += c_wordBits) {
+					emit(address, voxels);
+					address++;
+					voxels = ~TWord(0);
+				}
+
+				const UINT restCount = range.y & (c_wordBits - 1);
+				if(restCount > 0) {
+					voxels &= ~((~TWord(0)) << restCount);
+					emit(address, voxels);
+				}
+			}
+
+			// Nx1x1 or 1xNx1: set all voxels, one at a time
+			else {
+				const UINT64 stride = (flatDimensions & FLATDIM_X) == 0 ? m_strideX : m_strideY;
+				const UINT count = range.y - range.x;
+				const TWord voxels = GetBit(UINT(voxMin.z));
+
+				for(UINT i = 0; i < count; i++) {
+					emit(address, voxels);
+					address += stride;
+				}
+			}
+		}
+
+		//---- 2D or 3D ----
+		else {
+			// triangle setup
+			const float3 e0 = v1 - v0;
+			const float3 e1 = v2 - v1;
+			const float3 e2 = v0 - v2;
+			float3 n = cross(e2, e0);
+
+			//---- 2D: test only for 2D triangle/voxel overlap ----
+			if((flatDimensions & 3) == 1) {
+				// NxMx1
+				if(flatDimensions & FLATDIM_Z) {
+					float2 ne0, ne1, ne2;
+					float  de0, de1, de2;
+
+					const float orientation = n.z < 0.0f ? -1.0f : 1.0f;
+					Determine2dEdge(ne0, de0, orientation, e0.x, e0.y, v0.x, v0.y);
+					Determine2dEdge(ne1, de1, orientation, e1.x, e1.y, v1.x, v1.y);
+					Determine2dEdge(ne2, de2, orientation, e2.x, e2.y, v2.x, v2.y);
+
+					const TWord voxels = GetBit(UINT(voxMin.z));
+
+					float2 p;
+					for(p.y = voxMin.y; p.y < voxMax.y; p.y++) {
+						TWord* address = m_voxels + GetAddress(UINT(voxMin.x), UINT(p.y), UINT(voxMin.z));
+						for(p.x = voxMin.x; p.x < voxMax.x; p.x++) {
+							if((dot(ne0, p) + de0 > 0.0f) &&
+							   (dot(ne1, p) + de1 > 0.0f) &&
+							   (dot(ne2, p) + de2 > 0.0f))
+							{
+								emit(address, voxels);
+							}
+							address += m_strideX;
+						}
+					}
+				}
+
+				// 1xNxM or Nx1xM: inner loop along z such that updates to voxels stored in the same word result in only one update
+				else {
+					float2 ne0, ne1, ne2;
+					float  de0, de1, de2;
+
+					UINT64 stride;
+					float2 p;
+					float pxMax;
+
+					if(flatDimensions & FLATDIM_X) {
+						const float orientation = n.x < 0.0f ? -1.0f : 1.0f;
+						Determine2dEdge(ne0, de0, orientation, e0.y, e0.z, v0.y, v0.z);
+						Determine2dEdge(ne1, de1, orientation, e1.y, e1.z, v1.y, v1.z);
+						Determine2dEdge(ne2, de2, orientation, e2.y, e2.z, v2.y, v2.z);
+						stride = m_strideY;
+						p.x = voxMin.y;
+						pxMax = voxMax.y;
+					} else {
+						const float orientation = n.y > 0.0f ? -1.0f : 1.0f;
+						Determine2dEdge(ne0, de0, orientation, e0.x, e0.z, v0.x, v0.z);
+						Determine2dEdge(ne1, de1, orientation, e1.x, e1.z, v1.x, v1.z);
+						Determine2dEdge(ne2, de2, orientation, e2.x, e2.z, v2.x, v2.z);
+						stride = m_strideX;
+						p.x = voxMin.x;
+						pxMax = voxMax.x;
+					}
+
+					TWord* address0 = m_voxels + GetAddress(UINT(voxMin.x), UINT(voxMin.y), UINT(voxMin.z));
+					for(; p.x < pxMax; p.x++) {
+						TWord* address = address0;
+						TWord voxels = 0;
+						for(p.y = voxMin.z; p.y < voxMax.z; p.y++) {
+							const UINT zBit = UINT(p.y) & (c_wordBits - 1);
+
+							if((dot(ne0, p) + de0 > 0.0f) &&
+							   (dot(ne1, p) + de1 > 0.0f) &&
+							   (dot(ne2, p) + de2 > 0.0f))
+							{
+								voxels |= TWord(1) << zBit;
+							}
+
+							if(zBit == c_wordBits - 1) {
+								if(voxels) {
+									emit(address, voxels);
+									voxels = 0;
+								}
+								address++;
+							}
+						}
+
+						if(voxels != 0)
+							emit(address, voxels);
+
+						address0 += stride;
+					}
+				}
+			}
+
+			//---- 3D ----
+			else {
+				n = normalize(n);
+
+				// determine edge equations and offsets
+				float2 ne0_xy, ne1_xy, ne2_xy;
+				float de0_xy, de1_xy, de2_xy;
+				const float orientation_xy = n.z < 0.0f ? -1.0f : 1.0f;
+				Determine2dEdge(ne0_xy, de0_xy, orientation_xy, e0.x, e0.y, v0.x, v0.y);
+				Determine2dEdge(ne1_xy, de1_xy, orientation_xy, e1.x, e1.y, v1.x, v1.y);
+				Determine2dEdge(ne2_xy, de2_xy, orientation_xy, e2.x, e2.y, v2.x, v2.y);
+
+				float2 ne0_xz, ne1_xz, ne2_xz;
+				float de0_xz, de1_xz, de2_xz;
+				const float orientation_xz = n.y > 0.0f ? -1.0f : 1.0f;
+				Determine2dEdge(ne0_xz, de0_xz, orientation_xz, e0.x, e0.z, v0.x, v0.z);
+				Determine2dEdge(ne1_xz, de1_xz, orientation_xz, e1.x, e1.z, v1.x, v1.z);
+				Determine2dEdge(ne2_xz, de2_xz, orientation_xz, e2.x, e2.z, v2.x, v2.z);
+
+				float2 ne0_yz, ne1_yz, ne2_yz;
+				float de0_yz, de1_yz, de2_yz;
+				const float orientation_yz = n.x < 0.0f ? -1.0f : 1.0f;
+				Determine2dEdge(ne0_yz, de0_yz, orientation_yz, e0.y, e0.z, v0.y, v0.z);
+				Determine2dEdge(ne1_yz, de1_yz, orientation_yz, e1.y, e1.z, v1.y, v1.z);
+				Determine2dEdge(ne2_yz, de2_yz, orientation_yz, e2.y, e2.z, v2.y, v2.z);
+
+				auto overlapsXY = [&](float x, float y) {
+					return ne0_xy.x * x + ne0_xy.y * y + de0_xy >= 0.0f && ne1_xy.x * x + ne1_xy.y * y + de1_xy >= 0.0f && ne2_xy.x * x + ne2_xy.y * y + de2_xy >= 0.0f;
+				};
+				auto overlapsXZ = [&](float x, float z) {
+					return ne0_xz.x * x + ne0_xz.y * z + de0_xz >= 0.0f && ne1_xz.x * x + ne1_xz.y * z + de1_xz >= 0.0f && ne2_xz.x * x + ne2_xz.y * z + de2_xz >= 0.0f;
+				};
+				auto overlapsYZ = [&](float y, float z) {
+					return ne0_yz.x * y + ne0_yz.y * z + de0_yz >= 0.0f && ne1_yz.x * y + ne1_yz.y * z + de1_yz >= 0.0f && ne2_yz.x * y + ne2_yz.y * z + de2_yz >= 0.0f;
+				};
+
+				const UINT dominantAxis = DetermineDominantAxis(n);
+
+				// triangle aligns best to yz
+				if(dominantAxis == 0) {
+					// make normal point in +x direction
+					if(n.x < 0.0f) {
+						n.x = -n.x;
+						n.y = -n.y;
+						n.z = -n.z;
+					}
+
+					// determine triangle plane equation and offset
+					const float dTri = -dot(n, v0);
+					const float2 dTriProj = DetermineProjectedPlaneOffsets(dTri, n.y, n.z);
+
+					const float nxInv = 1.0f / n.x;
+
+					float3 p;
+					for(p.y = voxMin.y; p.y < voxMax.y; p.y++) {
+						for(p.z = voxMin.z; p.z < voxMax.z; p.z++) {
+							if(!overlapsYZ(p.y, p.z))
+								continue;
+
+							// determine x range
+							const float2 rangeX = DetermineDepthRange(p.y * n.y + p.z * n.z, dTriProj, nxInv, voxMin.x, voxMax.x);
+							const float minX = rangeX.x;
+							const float maxX = rangeX.y;
+
+							// test voxels in x range
+							TWord* address = m_voxels + GetAddress(UINT(minX), UINT(p.y), UINT(p.z));
+							const TWord voxels = GetBit(UINT(p.z));
+
+							for(p.x = minX; p.x < maxX; p.x++) {
+								if(overlapsXY(p.x, p.y) && overlapsXZ(p.x, p.z))
+									emit(address, voxels);
+								address += m_strideX;
+							}
+						}
+					}
+				}
+
+				// triangle aligns best to xz
+				else if(dominantAxis == 1) {
+					// make normal point in +y direction
+					if(n.y < 0.0f) {
+						n.x = -n.x;
+						n.y = -n.y;
+						n.z = -n.z;
+					}
+
+					// determine triangle plane equation and offset
+					const float dTri = -dot(n, v0);
+					const float2 dTriProj = DetermineProjectedPlaneOffsets(dTri, n.x, n.z);
+
+					const float nyInv = 1.0f / n.y;
+
+					float3 p;
+					for(p.x = voxMin.x; p.x < voxMax.x; p.x++) {
+						for(p.z = voxMin.z; p.z < voxMax.z; p.z++) {
+							if(!overlapsXZ(p.x, p.z))
+								continue;
+
+							// determine y range
+							const float2 rangeY = DetermineDepthRange(p.x * n.x + p.z * n.z, dTriProj, nyInv, unclippedMinY, unclippedMaxY);
+							const float minY = std::max(rangeY.x, voxMin.y);
+							const float maxY = std::min(rangeY.y, voxMax.y);
+
+							// test voxels in y range
+							TWord* address = m_voxels + GetAddress(UINT(p.x), UINT(minY), UINT(p.z));
+							const TWord voxels = GetBit(UINT(p.z));
+
+							for(p.y = minY; p.y < maxY; p.y++) {
+								if(overlapsXY(p.x, p.y) && overlapsYZ(p.y, p.z))
+									emit(address, voxels);
+								address += m_strideY;
+							}
+						}
+					}
+				}
+
+				// triangle aligns best to xy
+				else {
+					// make normal point in +z direction
+					if(n.z < 0.0f) {
+						n.x = -n.x;
+						n.y = -n.y;
+						n.z = -n.z;
+					}
+
+					// determine triangle plane equation and offset
+					const float dTri = -dot(n, v0);
+					const float2 dTriProj = DetermineProjectedPlaneOffsets(dTri, n.x, n.y);
+
+					const float nzInv = 1.0f / n.z;
+
+					float3 p;
+					for(p.y = voxMin.y; p.y < voxMax.y; p.y++) {
+						for(p.x = voxMin.x; p.x < voxMax.x; p.x++) {
+							if(!overlapsXY(p.x, p.y))
+								continue;
+
+							// determine z range
+							const float2 rangeZ = DetermineDepthRange(p.x * n.x + p.y * n.y, dTriProj, nzInv, voxMin.z, voxMax.z);
+							const float minZ = rangeZ.x;
+							const float maxZ = rangeZ.y;
+
+							// test voxels in z range, accumulating the voxels of one word before updating it
+							TWord* address = m_voxels + GetAddress(UINT(p.x), UINT(p.y), UINT(minZ));
+							TWord voxels = 0;
+
+							for(p.z = minZ; p.z < maxZ; p.z++) {
+								const UINT zBit = UINT(p.z) & (c_wordBits - 1);
+
+								if(overlapsXZ(p.x, p.z) && overlapsYZ(p.y, p.z))
+									voxels |= TWord(1) << zBit;
+
+								if(zBit == c_wordBits - 1) {
+									if(voxels) {
+										emit(address, voxels);
+										voxels = 0;
+									}
+									address++;
+								}
+							}
+
+							if(voxels != 0)
+								emit(address, voxels);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// Fills ranks.m_wordRanks for the grid; fails with E_OUTOFMEMORY if the number of set voxels, which numCells receives, exceeds 32 bits.
+	template<typename TWord>
+	HRESULT ComputeVoxelRanks(const BasicVoxelGrid<TWord>& grid, CpuVoxelRanks& ranks, UINT64& numCells) {
+		PROFILE_SCOPE("Rank voxels");
+
+		const UINT sizeY = grid.GetGridSize()[1];
+		const UINT64 rowSize = grid.GetStrideY();
+		const TWord* voxels = grid.GetData();
+
+		// set voxels per row of the grid, whose prefix sums are the ranks of the rows' first words
+		std::vector<UINT64> rowRanks;
+		try {
+			ranks.m_wordRanks.resize(size_t(grid.GetDataSize()));
+			rowRanks.resize(sizeY + 1);
+		} catch(const std::bad_alloc&) {
+			ranks.m_wordRanks.clear();
+			return E_OUTOFMEMORY;
+		}
+
+		ParallelFor(0, sizeY, 16, [&](UINT64 begin, UINT64 end) {
+			for(UINT64 y = begin; y < end; y++) {
+				UINT64 count = 0;
+				for(UINT64 i = y * rowSize; i < (y + 1) * rowSize; i++)
+					count += CountBits(voxels[i]);
+				rowRanks[y + 1] = count;
+			}
+		});
+
+		for(UINT y = 0; y < sizeY; y++)
+			rowRanks[y + 1] += rowRanks[y];
+
+		numCells = rowRanks[sizeY];
+		if(numCells > UINT_MAX) {
+			ranks.m_wordRanks.clear();
+			return E_OUTOFMEMORY;
+		}
+
+		ParallelFor(0, sizeY, 16, [&](UINT64 begin, UINT64 end) {
+			for(UINT64 y = begin; y < end; y++) {
+				UINT32 rank = UINT32(rowRanks[y]);
+				for(UINT64 i = y * rowSize; i < (y + 1) * rowSize; i++) {
+					ranks.m_wordRanks[size_t(i)] = rank;
+					rank += CountBits(voxels[i]);
+				}
+			}
+		});
+
+		return S_OK;
+	}
+
+	// calls func(cell) for each voxel emitted by the voxelizer for a word; all of them have to be set in the grid
+	template<typename TWord, typename Func>
+	void ForEachEmittedCell(const TWord* voxels, const CpuVoxelRanks& ranks, UINT64 word, TWord emitted, const Func& func) {
+		for(; emitted != 0; emitted &= emitted - 1) {
+			const TWord below = (TWord(1) << LowestSetBit(emitted)) - 1;
+			func(ranks.m_wordRanks[size_t(word)] + CountBits(voxels[word] & below));
+		}
+	}
+
+	// voxels of a word emitted by the voxelizer for a triangle
+	template<typename TWord>
+	struct EmittedVoxels {
+		UINT64 m_word;
+		TWord m_voxels;
+		UINT32 m_triangle;
+	};
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// neighbor of the columns at the grid's border in x or y in ExteriorFill
+	const UINT64 c_outside = ~UINT64(0);
+
+	// columns per slab swept along y by ExteriorFill
+	const UINT c_fillSlabColumns = 16;
+
+	// Flood fill of the empty voxels of a surface grid that are connected to the outside, with the outside voxels accumulated in a
+	// second grid of the same size. The sweeps along either direction record the slabs of each row whose columns they add voxels to
+	// for the sweeps along the other direction, in changes, which holds two arrays of a byte per slab for each row: the first one for
+	// the sweeps along x and the second one for those along y. So only the rows to which the sweeps along y have added voxels are
+	// swept along x again, and vice versa; a sweep accesses only the entries of its row or slab. Initially, all entries have to be set.
+	template<typename TWord>
+	class ExteriorFill {
+	public:
+		static const UINT c_wordBits = BasicVoxelGrid<TWord>::c_wordBits;
+
+		ExteriorFill(const BasicVoxelGrid<TWord>& surface, BasicVoxelGrid<TWord>& exterior, UINT8* changes)
+			: m_surface(surface.GetData()), m_exterior(exterior.GetData()), m_strideX(surface.GetStrideX()), m_strideY(surface.GetStrideY())
+		{
+			m_gridSize[0] = surface.GetGridSize()[0];
+			m_gridSize[1] = surface.GetGridSize()[1];
+			m_numSlabs = (m_gridSize[0] + c_fillSlabColumns - 1) / c_fillSlabColumns;
+			m_changesX = changes;
+			m_changesY = changes + UINT64(m_gridSize[1]) * m_numSlabs;
+		}
+
+		UINT GetNumSlabs() const { return m_numSlabs; }
+
+		// fills the columns of row y along z from the outside below and above the grid, before the sweeps
+		void SeedRow(UINT y) const {
+			for(UINT x = 0; x < m_gridSize[0]; x++) {
+				const UINT64 column = UINT64(x) * m_strideX + y * m_strideY;
+				TWord carry = 1;
+				for(UINT w = 0; w < m_strideX && carry != 0; w++) {
+					const TWord empty = ~m_surface[column + w];
+					m_exterior[column + w] = FillRunsUp(carry & empty, empty);
+					carry = m_exterior[column + w] >> (c_wordBits - 1);
+				}
+				FillColumnDown(column);
+			}
+		}
+
+		// sweeps along x through row y, forth and back until they add no more voxels, if voxels have been added to the row since its last
+		// sweep; as the row is a plane in x and z, paths that turn back along x any number of times are followed. Returns whether voxels
+		// were added.
+		bool SweepX(UINT y) const {
+			UINT8* pending = m_changesX + UINT64(y) * m_numSlabs;
+			if(std::count(pending, pending + m_numSlabs, UINT8(0)) == m_numSlabs)
+				return false;
+			std::fill(pending, pending + m_numSlabs, UINT8(0));
+
+			UINT8* changes = m_changesY + UINT64(y) * m_numSlabs;
+			const UINT64 row = y * m_strideY;
+			bool added = false;
+			for(bool changed = true; changed; added |= changed) {
+				changed = false;
+				for(UINT x = 0; x < m_gridSize[0]; x++) {
+					if(UpdateColumn(row + UINT64(x) * m_strideX, x > 0 ? row + UINT64(x - 1) * m_strideX : c_outside)) {
+						changes[x / c_fillSlabColumns] = 1;
+						changed = true;
+					}
+				}
+				for(UINT x = m_gridSize[0]; x-- > 0; ) {
+					if(UpdateColumn(row + UINT64(x) * m_strideX, x + 1 < m_gridSize[0] ? row + UINT64(x + 1) * m_strideX : c_outside)) {
+						changes[x / c_fillSlabColumns] = 1;
+						changed = true;
+					}
+				}
+			}
+			return added;
+		}
+
+		// sweeps along y through the columns of the slab in all rows, forth and back until they add no more voxels, if voxels have been
+		// added to them since the slab's last sweep; returns whether voxels were added
+		bool SweepY(UINT slab) const {
+			bool pending = false;
+			for(UINT y = 0; y < m_gridSize[1]; y++) {
+				pending |= m_changesY[UINT64(y) * m_numSlabs + slab] != 0;
+				m_changesY[UINT64(y) * m_numSlabs + slab] = 0;
+			}
+			if(!pending)
+				return false;
+
+			UINT8* changes = m_changesX + slab;
+			const UINT xBegin = slab * c_fillSlabColumns;
+			const UINT xEnd = std::min(xBegin + c_fillSlabColumns, m_gridSize[0]);
+			bool added = false;
+			for(bool changed = true; changed; added |= changed) {
+				changed = false;
+				for(UINT y = 0; y < m_gridSize[1]; y++) {
+					for(UINT x = xBegin; x < xEnd; x++) {
+						const UINT64 column = UINT64(x) * m_strideX + y * m_strideY;
+						if(UpdateColumn(column, y > 0 ? column - m_strideY : c_outside)) {
+							changes[UINT64(y) * m_numSlabs] = 1;
+							changed = true;
+						}
+					}
+				}
+				for(UINT y = m_gridSize[1]; y-- > 0; ) {
+					for(UINT x = xBegin; x < xEnd; x++) {
+						const UINT64 column = UINT64(x) * m_strideX + y * m_strideY;
+						if(UpdateColumn(column, y + 1 < m_gridSize[1] ? column + m_strideY : c_outside)) {
+							changes[UINT64(y) * m_numSlabs] = 1;
+							changed = true;
+						}
+					}
+				}
+			}
+			return added;
+		}
+
+	private:
+		// Adds the empty voxels of the column starting at word column that are connected to the outside voxels of the column starting at
+		// neighbor, or that lie on the grid's border if it is c_outside, or to the column's outside voxels. Words with new seeds are
+		// filled along z in both directions on the way up, carrying the voxels that reach a word's upper end into the next word, and
+		// words reached by the voxels at the lower end of the word above them are filled downwards on the way back. As SeedRow and
+		// every update leave the columns filled along z, words without new seeds stay as they are, and so does a column whose words all do.
+		bool UpdateColumn(UINT64 column, UINT64 neighbor) const {
+			const TWord* surface = m_surface + column;
+			TWord* exterior = m_exterior + column;
+			bool changed = false;
+
+			TWord carry = 0;
+			for(UINT w = 0; w < m_strideX; w++) {
+				const TWord empty = ~surface[w];
+				const TWord seeds = neighbor == c_outside ? empty : (m_exterior[neighbor + w] | carry) & empty;
+				if((seeds & ~exterior[w]) != 0) {
+					exterior[w] = seeds == empty ? empty : FillRunsDown(FillRunsUp(exterior[w] | seeds, empty), empty);
+					changed = true;
+				}
+				carry = exterior[w] >> (c_wordBits - 1);
+			}
+			if(!changed)
+				return false;
+
+			FillColumnDown(column);
+			return true;
+		}
+
+		// fills the column starting at word column downwards from the voxels at the lower end of each word and from above the grid; the
+		// bits beyond the grid in the last word are outside, and so is the top voxel if the grid ends with a word
+		void FillColumnDown(UINT64 column) const {
+			const TWord* surface = m_surface + column;
+			TWord* exterior = m_exterior + column;
+			TWord carry = TWord(1) << (c_wordBits - 1);
+			for(UINT w = m_strideX; w-- > 0; ) {
+				const TWord seeds = carry & ~surface[w];
+				if((seeds & ~exterior[w]) != 0)
+					exterior[w] = FillRunsDown(exterior[w] | seeds, ~surface[w]);
+				carry = (exterior[w] & 1) << (c_wordBits - 1);
+			}
+		}
+
+		const TWord* m_surface;
+		TWord* m_exterior;
+		UINT8* m_changesX;
+		UINT8* m_changesY;
+		UINT m_gridSize[2];
+		UINT m_numSlabs;
+		UINT m_strideX;
+		UINT64 m_strideY;
+	};
+
+	// ParallelFor over the rows of a grid, whose rows are processed by the workers of their NUMA node if nodeRows is not empty
+	template<typename Func>
+	void ParallelForRows(const std::vector<UINT64>& nodeRows, UINT64 numRows, UINT64 rowsPerChunk, const Func& func) {
+		if(nodeRows.empty())
+			ParallelFor(0, numRows, rowsPerChunk, func);
+		else
+			ParallelForNuma(nodeRows.data(), rowsPerChunk, [&](UINT node, UINT64 begin, UINT64 end) { func(begin, end); });
+	}
+
+}
+
+//==============================================================================================================================================================
+
+template<typename TWord>
+BasicVoxelGrid<TWord>::BasicVoxelGrid()
+	: m_strideX(0), m_strideY(0), m_dataSize(0)
+{
+	m_gridSize[0] = m_gridSize[1] = m_gridSize[2] = 0;
+}
+
+template<typename TWord>
+HRESULT BasicVoxelGrid<TWord>::Init(UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ) {
+	m_gridSize[0] = gridSizeX;
+	m_gridSize[1] = gridSizeY;
+	m_gridSize[2] = gridSizeZ;
+	m_strideX = (gridSizeZ + c_wordBits - 1) / c_wordBits;
+	m_strideY = UINT64(m_strideX) * gridSizeX;
+	m_dataSize = m_strideY * gridSizeY;
+
+	HRESULT hr;
+	if(FAILED(hr = m_memory.Allocate(m_strideY * sizeof(TWord), gridSizeY))) {
+		m_dataSize = 0;
+		return hr;
+	}
+	return S_OK;
+}
+
+template<typename TWord>
+void BasicVoxelGrid<TWord>::Clear() {
+	m_memory.Clear();
+}
+
+template<typename TWord>
+VoxelGridLayout BasicVoxelGrid<TWord>::GetGpuLayout() const {
+	return MakeVoxelGridLayout(m_gridSize[0], m_gridSize[1], m_gridSize[2]);
+}
+
+template<typename TWord>
+HRESULT BasicVoxelGrid<TWord>::CopyFromGpuLayout(const VoxelGridLayout& layout, const UINT32* voxels) {
+	HRESULT hr;
+	if(FAILED(hr = Init(layout.m_gridSize[0], layout.m_gridSize[1], layout.m_gridSize[2])))
+		return hr;
+	if(m_dataSize == 0)
+		return S_OK;
+
+	// the last word of each column may contain bits beyond the grid, e.g. from solid voxelization
+	const UINT wordsPerWord = c_wordBits / 32;
+	const TWord lastMask = ~TWord(0) >> (c_wordBits - 1 - ((m_gridSize[2] - 1) & (c_wordBits - 1)));
+
+	ParallelFor(0, m_gridSize[1], 16, [&](UINT64 begin, UINT64 end) {
+		for(UINT y = UINT(begin); y < UINT(end); y++) {
+			for(UINT x = 0; x < m_gridSize[0]; x++) {
+				const UINT32* src = voxels + GetVoxelWordIndex(layout, x, y, 0);
+				TWord* dst = GetData() + UINT64(x) * m_strideX + y * m_strideY;
+				for(UINT w = 0; w < m_strideX; w++) {
+					TWord word = 0;
+					for(UINT i = 0; i < wordsPerWord; i++) {
+						const UINT srcWord = w * wordsPerWord + i;
+						if(srcWord < layout.m_strideX)
+							word |= TWord(src[srcWord]) << (32 * i);
+					}
+					dst[w] = w + 1 < m_strideX ? word : word & lastMask;
+				}
+			}
+		}
+	});
+
+	return S_OK;
+}
+
+template<typename TWord>
+void BasicVoxelGrid<TWord>::CopyToGpuLayout(UINT32* voxels) const {
+	const VoxelGridLayout layout = GetGpuLayout();
+	const UINT wordsPerWord = c_wordBits / 32;
+
+	ParallelFor(0, m_gridSize[1], 16, [&](UINT64 begin, UINT64 end) {
+		for(UINT y = UINT(begin); y < UINT(end); y++) {
+			for(UINT x = 0; x < m_gridSize[0]; x++) {
+				const TWord* src = GetData() + UINT64(x) * m_strideX + y * m_strideY;
+				UINT32* dst = voxels + GetVoxelWordIndex(layout, x, y, 0);
+				for(UINT w = 0; w < layout.m_strideX; w++)
+					dst[w] = UINT32(src[w / wordsPerWord] >> (32 * (w % wordsPerWord)));
+			}
+		}
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+template<typename TWord>
+HRESULT VoxelizeOnCpu(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, BasicVoxelGrid<TWord>& grid) {
+	if(mesh.m_vertices == nullptr || mesh.m_indices == nullptr || matModelToVoxel == nullptr)
+		return E_INVALIDARG;
+	if(method == CPU_VOXELIZATION_SOLID_FLOOD_FILL) {
+		HRESULT hr;
+		if(FAILED(hr = VoxelizeOnCpu(mesh, matModelToVoxel, CPU_VOXELIZATION_SURFACE_CONSERVATIVE, grid)))
+			return hr;
+		return SolidifyOnCpu(grid);
+	}
+	if(method != CPU_VOXELIZATION_SOLID && method != CPU_VOXELIZATION_SURFACE_CONSERVATIVE && method != CPU_VOXELIZATION_SURFACE)
+		return E_INVALIDARG;
+
+	grid.Clear();
+	if(grid.GetDataSize() == 0)
+		return S_OK;
+
+	const Voxelizer<TWord> voxelizer(mesh, matModelToVoxel, grid);
+	auto voxelizeTriangle = [&](UINT tri) {
+		if(method == CPU_VOXELIZATION_SOLID)
+			voxelizer.VoxelizeSolid(tri);
+		else if(method == CPU_VOXELIZATION_SURFACE)
+			voxelizer.VoxelizeSurface(tri, [](TWord* address, TWord voxels) { AtomicOr(address, voxels); });
+		else
+			voxelizer.VoxelizeSurfaceConservative(tri, [](TWord* address, TWord voxels) { AtomicOr(address, voxels); });
+	};
+
+	const UINT sizeY = grid.GetGridSize()[1];
+	const UINT64 numSections = grid.GetStrideY();
+	const std::vector<UINT64>& nodeRows = grid.GetNodeRows();
+	if(nodeRows.empty()) {
+		ParallelFor(0, mesh.m_numTriangles, c_trianglesPerChunk, [&](UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Triangle pass");
+			for(UINT tri = UINT(begin); tri < UINT(end); tri++)
+				voxelizeTriangle(tri);
+		});
+
+		if(method == CPU_VOXELIZATION_SOLID) {
+			ParallelFor(0, numSections, 256, [&](UINT64 begin, UINT64 end) {
+				PROFILE_SCOPE("Propagate");
+				for(UINT64 section = begin; section < end; section++)
+					voxelizer.VoxelizeSolid_Propagate(section, 0, sizeY);
+			});
+		}
+		return S_OK;
+	}
+
+	// The grid's rows are distributed across NUMA nodes: each triangle is routed to the workers of the node holding the row of its
+	// center, so that most of its atomic updates are node-local. Propagation scans each node's block of rows on the node, followed
+	// by XORing the carry from the preceding blocks into the block.
+	const UINT numNodes = UINT(nodeRows.size() - 1);
+	std::vector<UINT16> triangleNodes;
+	std::vector<UINT32> nodeTriangles;
+	std::vector<UINT64> nodeBegins(numNodes + 1, 0);
+	std::vector<TWord> blockXors;
+	try {
+		triangleNodes.resize(mesh.m_numTriangles);
+		nodeTriangles.resize(mesh.m_numTriangles);
+		if(method == CPU_VOXELIZATION_SOLID)
+			blockXors.resize(size_t(numNodes * numSections));
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	{
+		PROFILE_SCOPE("Route triangles");
+		ParallelFor(0, mesh.m_numTriangles, c_trianglesPerChunk, [&](UINT64 begin, UINT64 end) {
+			for(UINT tri = UINT(begin); tri < UINT(end); tri++)
+				triangleNodes[tri] = UINT16(std::upper_bound(nodeRows.begin(), nodeRows.end(), UINT64(voxelizer.GetCenterRow(tri))) - nodeRows.begin() - 1);
+		});
+
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++)
+			nodeBegins[triangleNodes[tri] + 1]++;
+		for(UINT n = 0; n < numNodes; n++)
+			nodeBegins[n + 1] += nodeBegins[n];
+
+		std::vector<UINT64> cursors(nodeBegins.begin(), nodeBegins.end() - 1);
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++)
+			nodeTriangles[size_t(cursors[triangleNodes[tri]]++)] = tri;
+	}
+
+	ParallelForNuma(nodeBegins.data(), c_trianglesPerChunk, [&](UINT node, UINT64 begin, UINT64 end) {
+		PROFILE_SCOPE("Triangle pass");
+		for(UINT64 i = begin; i < end; i++)
+			voxelizeTriangle(nodeTriangles[size_t(i)]);
+	});
+
+	if(method == CPU_VOXELIZATION_SOLID) {
+		std::vector<UINT64> nodeSections(numNodes + 1);
+		for(UINT n = 0; n <= numNodes; n++)
+			nodeSections[n] = n * numSections;
+
+		ParallelForNuma(nodeSections.data(), 256, [&](UINT node, UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Propagate");
+			for(UINT64 i = begin; i < end; i++)
+				blockXors[size_t(i)] = voxelizer.VoxelizeSolid_Propagate(i - node * numSections, UINT(nodeRows[node]), UINT(nodeRows[node + 1]));
+		});
+
+		ParallelForNuma(nodeSections.data(), 256, [&](UINT node, UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Propagate carry");
+			for(UINT64 i = begin; i < end; i++) {
+				const UINT64 section = i - node * numSections;
+				TWord carry = 0;
+				for(UINT k = 0; k < node; k++)
+					carry ^= blockXors[size_t(k * numSections + section)];
+				voxelizer.VoxelizeSolid_PropagateCarry(section, UINT(nodeRows[node]), UINT(nodeRows[node + 1]), carry);
+			}
+		});
+	}
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+template<typename TWord>
+HRESULT SolidifyOnCpu(BasicVoxelGrid<TWord>& grid) {
+	if(grid.GetDataSize() == 0)
+		return S_OK;
+
+	const UINT* gridSize = grid.GetGridSize();
+	BasicVoxelGrid<TWord> exterior;
+	HRESULT hr;
+	if(FAILED(hr = exterior.Init(gridSize[0], gridSize[1], gridSize[2])))
+		return hr;
+
+	// rows are swept along x by the workers of their NUMA node, as are the words of the rows finally inverted
+	const std::vector<UINT64>& nodeRows = grid.GetNodeRows();
+
+	std::vector<UINT8> changes;
+	try {
+		changes.assign(size_t(2 * UINT64(gridSize[1]) * ((gridSize[0] + c_fillSlabColumns - 1) / c_fillSlabColumns)), 1);
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	const ExteriorFill<TWord> fill(grid, exterior, changes.data());
+	ParallelForRows(nodeRows, gridSize[1], 1, [&](UINT64 begin, UINT64 end) {
+		PROFILE_SCOPE("Seed columns");
+		for(UINT64 y = begin; y < end; y++)
+			fill.SeedRow(UINT(y));
+	});
+
+	for(bool changed = true; changed; ) {
+		std::atomic<bool> sweepChanged(false);
+		ParallelForRows(nodeRows, gridSize[1], 1, [&](UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Flood fill along x");
+			for(UINT64 y = begin; y < end; y++) {
+				if(fill.SweepX(UINT(y)))
+					sweepChanged = true;
+			}
+		});
+
+		ParallelFor(0, fill.GetNumSlabs(), 1, [&](UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Flood fill along y");
+			for(UINT64 slab = begin; slab < end; slab++) {
+				if(fill.SweepY(UINT(slab)))
+					sweepChanged = true;
+			}
+		});
+
+		changed = sweepChanged;
+	}
+
+	// the voxels not reached are inside of the surface or part of it; the bits beyond the grid have been reached
+	TWord* voxels = grid.GetData();
+	const TWord* outside = exterior.GetData();
+	const UINT64 rowSize = grid.GetStrideY();
+	ParallelForRows(nodeRows, gridSize[1], 16, [&](UINT64 begin, UINT64 end) {
+		PROFILE_SCOPE("Invert exterior");
+		for(UINT64 i = begin * rowSize; i < end * rowSize; i++)
+			voxels[i] = ~outside[i];
+	});
+
+	return S_OK;
+}
+
+template<typename TWord>
+UINT32 CpuVoxelRanks::GetCell(const BasicVoxelGrid<TWord>& grid, UINT x, UINT y, UINT z) const {
+	const UINT64 word = UINT64(x) * grid.GetStrideX() + y * grid.GetStrideY() + (z >> BasicVoxelGrid<TWord>::c_wordShift);
+	const TWord below = (TWord(1) << (z & (BasicVoxelGrid<TWord>::c_wordBits - 1))) - 1;
+	return m_wordRanks[word] + CountBits(grid.GetData()[word] & below);
+}
+
+template<typename TWord>
+HRESULT VoxelizeSurfaceConservativeOnCpu(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], BasicVoxelGrid<TWord>& grid, CpuVoxelTriangleLists& lists) {
+	lists.m_wordRanks.clear();
+	lists.m_cellOffsets.clear();
+	lists.m_cellTriangles.clear();
+
+	HRESULT hr;
+	if(FAILED(hr = VoxelizeOnCpu(mesh, matModelToVoxel, CPU_VOXELIZATION_SURFACE_CONSERVATIVE, grid)))
+		return hr;
+
+	UINT64 numCells;
+	if(FAILED(hr = ComputeVoxelRanks(grid, lists, numCells)))
+		return hr;
+
+	try {
+		lists.m_cellOffsets.assign(size_t(numCells + 1), 0u);
+	} catch(const std::bad_alloc&) {
+		lists.m_wordRanks.clear();
+		return E_OUTOFMEMORY;
+	}
+
+	// all voxels emitted by the voxelizer are set in the grid by now
+	const TWord* voxels = grid.GetData();
+	const Voxelizer<TWord> voxelizer(mesh, matModelToVoxel, grid);
+	auto forEachCell = [&](const TWord* address, TWord emitted, auto func) {
+		ForEachEmittedCell(voxels, lists, UINT64(address - voxels), emitted, func);
+	};
+
+	// count pairs of each cell in m_cellOffsets[cell + 1], followed by prefix sums
+	UINT32* offsets = lists.m_cellOffsets.data();
+	ParallelFor(0, mesh.m_numTriangles, c_trianglesPerChunk, [&](UINT64 begin, UINT64 end) {
+		PROFILE_SCOPE("Count triangle pairs");
+		for(UINT tri = UINT(begin); tri < UINT(end); tri++) {
+			voxelizer.VoxelizeSurfaceConservative(tri, [&](TWord* address, TWord emitted) {
+				forEachCell(address, emitted, [&](UINT32 cell) { AtomicIncrement(&offsets[cell + 1]); });
+			});
+		}
+	});
+
+	UINT64 numPairs = 0;
+	for(UINT64 cell = 1; cell <= numCells; cell++) {
+		numPairs += offsets[cell];
+		if(numPairs > UINT_MAX) {
+			lists.m_wordRanks.clear();
+			lists.m_cellOffsets.clear();
+			return E_OUTOFMEMORY;
+		}
+		offsets[cell] = UINT32(numPairs);
+	}
+
+	try {
+		lists.m_cellTriangles.resize(size_t(numPairs));
+	} catch(const std::bad_alloc&) {
+		lists.m_wordRanks.clear();
+		lists.m_cellOffsets.clear();
+		return E_OUTOFMEMORY;
+	}
+
+	// scatter, using m_cellOffsets[cell] as the cell's cursor; afterwards, it has advanced to the offset of the next cell
+	UINT32* triangles = lists.m_cellTriangles.data();
+	ParallelFor(0, mesh.m_numTriangles, c_trianglesPerChunk, [&](UINT64 begin, UINT64 end) {
+		PROFILE_SCOPE("Scatter triangle pairs");
+		for(UINT tri = UINT(begin); tri < UINT(end); tri++) {
+			voxelizer.VoxelizeSurfaceConservative(tri, [&](TWord* address, TWord emitted) {
+				forEachCell(address, emitted, [&](UINT32 cell) { triangles[AtomicIncrement(&offsets[cell])] = tri; });
+			});
+		}
+	});
+
+	std::copy_backward(offsets, offsets + numCells, offsets + numCells + 1);
+	offsets[0] = 0;
+
+	// the order of the triangles within a cell depends on the scheduling of the worker threads
+	ParallelFor(0, numCells, 4096, [&](UINT64 begin, UINT64 end) {
+		for(UINT64 cell = begin; cell < end; cell++)
+			std::sort(triangles + offsets[cell], triangles + offsets[cell + 1]);
+	});
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+template<typename TWord>
+HRESULT VoxelizeOnCpu(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, BasicVoxelGrid<TWord>& grid, const UINT32* triangleMaterials, CpuVoxelAttributes& attributes) {
+	attributes.m_wordRanks.clear();
+	attributes.m_normals.clear();
+	attributes.m_materials.clear();
+
+	if(mesh.m_vertices == nullptr || mesh.m_indices == nullptr || matModelToVoxel == nullptr)
+		return E_INVALIDARG;
+	if(method != CPU_VOXELIZATION_SURFACE_CONSERVATIVE && method != CPU_VOXELIZATION_SURFACE)
+		return E_INVALIDARG;
+
+	grid.Clear();
+	if(grid.GetDataSize() == 0)
+		return S_OK;
+
+	TWord* voxels = grid.GetData();
+	const Voxelizer<TWord> voxelizer(mesh, matModelToVoxel, grid);
+	const UINT sizeY = grid.GetGridSize()[1];
+	const UINT numBands = (sizeY + c_attributeBandRows - 1) / c_attributeBandRows;
+	const UINT64 rowSize = grid.GetStrideY();
+
+	// triangles of each band, in compressed sparse row form; the cells of each band are numbered from 0 until all bands are done
+	std::vector<UINT32> triangleBands;
+	std::vector<UINT64> bandOffsets;
+	std::vector<UINT32> bandTriangles;
+	std::vector<UINT64> bandCells;
+	std::vector<std::vector<UINT32>> bandNormals;
+	std::vector<std::vector<UINT32>> bandMaterials;
+	try {
+		attributes.m_wordRanks.resize(size_t(grid.GetDataSize()));
+		triangleBands.resize(size_t(UINT64(mesh.m_numTriangles) * 2));
+		bandOffsets.assign(numBands + 1, 0);
+		bandCells.assign(numBands + 1, 0);
+		bandNormals.resize(numBands);
+		bandMaterials.resize(numBands);
+	} catch(const std::bad_alloc&) {
+		attributes.m_wordRanks.clear();
+		return E_OUTOFMEMORY;
+	}
+
+	{
+		PROFILE_SCOPE("Route triangles");
+		ParallelFor(0, mesh.m_numTriangles, c_trianglesPerChunk, [&](UINT64 begin, UINT64 end) {
+			for(UINT tri = UINT(begin); tri < UINT(end); tri++) {
+				UINT rowBegin, rowEnd;
+				voxelizer.GetRowRange(tri, rowBegin, rowEnd);
+				triangleBands[tri * 2] = rowBegin / c_attributeBandRows;
+				triangleBands[tri * 2 + 1] = (rowBegin < rowEnd) ? (rowEnd - 1) / c_attributeBandRows + 1 : 0;
+			}
+		});
+
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++) {
+			for(UINT band = triangleBands[tri * 2]; band < triangleBands[tri * 2 + 1]; band++)
+				bandOffsets[band + 1]++;
+		}
+		for(UINT band = 0; band < numBands; band++)
+			bandOffsets[band + 1] += bandOffsets[band];
+
+		try {
+			bandTriangles.resize(size_t(bandOffsets[numBands]));
+		} catch(const std::bad_alloc&) {
+			attributes.m_wordRanks.clear();
+			return E_OUTOFMEMORY;
+		}
+
+		std::vector<UINT64> cursors(bandOffsets.begin(), bandOffsets.end() - 1);
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++) {
+			for(UINT band = triangleBands[tri * 2]; band < triangleBands[tri * 2 + 1]; band++)
+				bandTriangles[size_t(cursors[band]++)] = tri;
+		}
+	}
+
+	// Each band is voxelized by one worker, which clips its triangles to the band's rows, so that the band's words are complete
+	// and owned by the worker once its triangles are done. The words emitted in the band are recorded along with the triangle and
+	// replayed into the band's cells right away, which bounds the records to those of the bands in flight.
+	std::atomic<bool> outOfMemory(false);
+	ParallelFor(0, numBands, 1, [&](UINT64 bandBegin, UINT64 bandEnd) {
+		std::vector<EmittedVoxels<TWord>> records;
+		std::vector<INT64> normalSums;
+		std::vector<UINT32> firstTriangles;
+
+		for(UINT band = UINT(bandBegin); band < UINT(bandEnd) && !outOfMemory; band++) {
+			PROFILE_SCOPE("Attribute band");
+			const UINT rowBegin = band * c_attributeBandRows;
+			const UINT rowEnd = std::min(rowBegin + c_attributeBandRows, sizeY);
+			try {
+				records.clear();
+				for(UINT64 i = bandOffsets[band]; i < bandOffsets[band + 1]; i++) {
+					const UINT tri = bandTriangles[size_t(i)];
+					auto emit = [&](TWord* address, TWord emitted) {
+						*address |= emitted;
+						const EmittedVoxels<TWord> record = { UINT64(address - voxels), emitted, tri };
+						records.push_back(record);
+					};
+					if(method == CPU_VOXELIZATION_SURFACE)
+						voxelizer.VoxelizeSurface(tri, emit, rowBegin, rowEnd);
+					else
+						voxelizer.VoxelizeSurfaceConservative(tri, emit, rowBegin, rowEnd);
+				}
+
+				// rank the band's words
+				UINT64 numCells = 0;
+				for(UINT64 word = rowBegin * rowSize; word < rowEnd * rowSize; word++) {
+					attributes.m_wordRanks[size_t(word)] = UINT32(numCells);
+					numCells += CountBits(voxels[word]);
+				}
+				if(numCells > UINT_MAX) {
+					outOfMemory = true;
+					break;
+				}
+				bandCells[band + 1] = numCells;
+
+				normalSums.assign(size_t(numCells), 0);
+				if(triangleMaterials != nullptr)
+					firstTriangles.assign(size_t(numCells), UINT_MAX);
+
+				// the records of a triangle are consecutive
+				UINT32 tri = UINT_MAX;
+				INT64 normal = 0;
+				for(const EmittedVoxels<TWord>& record : records) {
+					if(record.m_triangle != tri) {
+						tri = record.m_triangle;
+						normal = PackNormal(voxelizer.GetModelNormal(tri));
+					}
+					ForEachEmittedCell<TWord>(voxels, attributes, record.m_word, record.m_voxels, [&](UINT32 cell) {
+						normalSums[cell] += normal;
+						if(triangleMaterials != nullptr)
+							firstTriangles[cell] = std::min(firstTriangles[cell], tri);
+					});
+				}
+
+				bandNormals[band].resize(size_t(numCells));
+				for(UINT64 cell = 0; cell < numCells; cell++)
+					bandNormals[band][size_t(cell)] = UnpackNormalSum(normalSums[size_t(cell)]);
+				if(triangleMaterials != nullptr) {
+					bandMaterials[band].resize(size_t(numCells));
+					for(UINT64 cell = 0; cell < numCells; cell++)
+						bandMaterials[band][size_t(cell)] = triangleMaterials[firstTriangles[size_t(cell)]];
+				}
+			} catch(const std::bad_alloc&) {
+				outOfMemory = true;
+			}
+		}
+	});
+	if(outOfMemory) {
+		attributes.m_wordRanks.clear();
+		return E_OUTOFMEMORY;
+	}
+
+	for(UINT band = 0; band < numBands; band++)
+		bandCells[band + 1] += bandCells[band];
+
+	const UINT64 numCells = bandCells[numBands];
+	if(numCells > UINT_MAX) {
+		attributes.m_wordRanks.clear();
+		return E_OUTOFMEMORY;
+	}
+
+	try {
+		attributes.m_normals.resize(size_t(numCells));
+		if(triangleMaterials != nullptr)
+			attributes.m_materials.resize(size_t(numCells));
+	} catch(const std::bad_alloc&) {
+		attributes.m_wordRanks.clear();
+		attributes.m_normals.clear();
+		return E_OUTOFMEMORY;
+	}
+
+	// offset the bands' ranks by the cells of the bands before them, and gather their attributes
+	ParallelFor(0, numBands, 1, [&](UINT64 bandBegin, UINT64 bandEnd) {
+		for(UINT band = UINT(bandBegin); band < UINT(bandEnd); band++) {
+			const UINT32 offset = UINT32(bandCells[band]);
+			const UINT rowBegin = band * c_attributeBandRows;
+			const UINT rowEnd = std::min(rowBegin + c_attributeBandRows, sizeY);
+			for(UINT64 word = rowBegin * rowSize; word < rowEnd * rowSize; word++)
+				attributes.m_wordRanks[size_t(word)] += offset;
+
+			std::copy(bandNormals[band].begin(), bandNormals[band].end(), attributes.m_normals.begin() + offset);
+			std::vector<UINT32>().swap(bandNormals[band]);
+			if(triangleMaterials != nullptr) {
+				std::copy(bandMaterials[band].begin(), bandMaterials[band].end(), attributes.m_materials.begin() + offset);
+				std::vector<UINT32>().swap(bandMaterials[band]);
+			}
+		}
+	});
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+template class BasicVoxelGrid<UINT32>;
+template class BasicVoxelGrid<UINT64>;
+
+template HRESULT VoxelizeOnCpu<UINT32>(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, VoxelGrid32& grid);
+template HRESULT VoxelizeOnCpu<UINT64>(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, VoxelGrid64& grid);
+
+template HRESULT SolidifyOnCpu<UINT32>(VoxelGrid32& grid);
+template HRESULT SolidifyOnCpu<UINT64>(VoxelGrid64& grid);
+
+template UINT32 CpuVoxelRanks::GetCell<UINT32>(const VoxelGrid32& grid, UINT x, UINT y, UINT z) const;
+template UINT32 CpuVoxelRanks::GetCell<UINT64>(const VoxelGrid64& grid, UINT x, UINT y, UINT z) const;
+
+template HRESULT VoxelizeSurfaceConservativeOnCpu<UINT32>(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], VoxelGrid32& grid, CpuVoxelTriangleLists& lists);
+template HRESULT VoxelizeSurfaceConservativeOnCpu<UINT64>(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], VoxelGrid64& grid, CpuVoxelTriangleLists& lists);
+
+template HRESULT VoxelizeOnCpu<UINT32>(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, VoxelGrid32& grid, const UINT32* triangleMaterials, CpuVoxelAttributes& attributes);
+template HRESULT VoxelizeOnCpu<UINT64>(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, VoxelGrid64& grid, const UINT32* triangleMaterials, CpuVoxelAttributes& attributes);
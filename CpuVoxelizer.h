@@ -0,0 +1,145 @@
+//==============================================================================================================================================================
+// CPU implementation of the compute-shader voxelization methods, with configurable voxel word width
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+#include "VoxelMemory.h"
+#include <vector>
+
+//==============================================================================================================================================================
+
+template<typename TWord> struct VoxelWordTraits;
+
+template<> struct VoxelWordTraits<UINT32> {
+	static const UINT c_bits = 32;
+	static const UINT c_shift = 5;
+};
+
+template<> struct VoxelWordTraits<UINT64> {
+	static const UINT c_bits = 64;
+	static const UINT c_shift = 6;
+};
+
+// Voxel grid in CPU memory, laid out like the voxelization buffer (see VoxelGridLayout) except that each word packs c_wordBits
+// consecutive voxels along z. 64-bit words halve the number of atomic updates made by the conservative surface voxelization, whose
+// loops gather voxels along z into a word before updating it, and the iterations of word-wise passes such as the solid method's
+// propagation scan. The solid method's crossings and the rasterized surface update single voxels, one at a time for either word
+// size. 32-bit words make the grid identical to the voxelization buffer. The data is held in VoxelMemory, i.e. large grids are
+// distributed across NUMA nodes by y.
+template<typename TWord>
+class BasicVoxelGrid {
+public:
+	static const UINT c_wordBits = VoxelWordTraits<TWord>::c_bits;
+	static const UINT c_wordShift = VoxelWordTraits<TWord>::c_shift;
+
+	BasicVoxelGrid();
+
+	HRESULT Init(UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ);
+	void Clear();
+
+	const UINT* GetGridSize() const { return m_gridSize; }
+	UINT GetStrideX() const { return m_strideX; }			// in words
+	UINT64 GetStrideY() const { return m_strideY; }			// in words
+	UINT64 GetDataSize() const { return m_dataSize; }		// in words
+	TWord* GetData() { return static_cast<TWord*>(m_memory.GetData()); }
+	const TWord* GetData() const { return static_cast<const TWord*>(m_memory.GetData()); }
+
+	// rows y in [nodeRows[node], nodeRows[node + 1]) are placed on NUMA node node; empty if the grid is not split across nodes
+	const std::vector<UINT64>& GetNodeRows() const { return m_memory.GetNodeRows(); }
+	bool UsesLargePages() const { return m_memory.UsesLargePages(); }
+
+	bool IsSet(UINT x, UINT y, UINT z) const {
+		return ((GetData()[UINT64(x) * m_strideX + y * m_strideY + (z >> c_wordShift)] >> (z & (c_wordBits - 1))) & 1u) != 0u;
+	}
+
+	// conversion from and to the 32-bit layout of the voxelization buffer; CopyFromGpuLayout also sets the grid size
+	VoxelGridLayout GetGpuLayout() const;
+	HRESULT CopyFromGpuLayout(const VoxelGridLayout& layout, const UINT32* voxels);
+	void CopyToGpuLayout(UINT32* voxels) const;
+
+private:
+	UINT m_gridSize[3];
+	UINT m_strideX;
+	UINT64 m_strideY;
+	UINT64 m_dataSize;
+	VoxelMemory m_memory;
+};
+
+typedef BasicVoxelGrid<UINT32> VoxelGrid32;
+typedef BasicVoxelGrid<UINT64> VoxelGrid64;
+
+//==============================================================================================================================================================
+
+// triangle mesh as bound to the voxelization compute shaders (g_bufVertices, g_bufIndices, cbModelInput)
+struct CpuVoxelizationMesh {
+	const float* m_vertices;			// position in the first three floats of each vertex
+	UINT m_vertexFloatStride;
+	const UINT32* m_indices;
+	UINT m_numTriangles;
+};
+
+enum CpuVoxelizationMethod {
+	CPU_VOXELIZATION_SOLID,						// CS_VoxelizeSolid followed by CS_VoxelizeSolid_Propagate
+	CPU_VOXELIZATION_SURFACE_CONSERVATIVE,		// CS_VoxelizeSurfaceConservative
+	CPU_VOXELIZATION_SURFACE,					// VS_Voxelize and PS_VoxelizeSurface, rasterizing along z
+	CPU_VOXELIZATION_SOLID_FLOOD_FILL,			// CPU_VOXELIZATION_SURFACE_CONSERVATIVE followed by SolidifyOnCpu
+};
+
+// Voxelizes the mesh into the grid, which is cleared first and has to be initialized to the desired size. The results match the
+// compute shaders, and those of the pixel shader up to the rasterizer's subpixel precision; matModelToVoxel is g_matModelToVoxel,
+// i.e. row-major and applied to column vectors. Triangles are distributed across worker threads, which update the grid with atomic
+// operations.
+template<typename TWord>
+HRESULT VoxelizeOnCpu(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, BasicVoxelGrid<TWord>& grid);
+
+// Turns a surface voxelization into a solid one by flood filling the empty voxels connected to the outside of the grid and setting all
+// others. Unlike CPU_VOXELIZATION_SOLID, which flips columns at each crossing of the surface and smears a hole or self-intersection
+// along its whole column, this stays robust for surfaces that are not closed: gaps narrower than the surface's voxels are sealed by
+// them, and regions leaking through wider ones come out hollow. The outside is connected through the border that SetupVoxelization
+// leaves around the model, which is cut off by voxel windows, leaving solids touching a window's border hollow. The empty voxels are
+// filled along z a word at a time, first from below and above the grid, then seeded by their neighbors in x and y in sweeps along x
+// and y in both directions, each repeated until it adds no voxel to its row or slab of columns, which one worker thread sweeps. The
+// directions alternate until neither adds a voxel, so shapes that the outside reaches only around many corners take more sweeps. A
+// temporary grid of the same size holds the outside voxels.
+template<typename TWord>
+HRESULT SolidifyOnCpu(BasicVoxelGrid<TWord>& grid);
+
+// Numbering of the set voxels of a grid, for storing per-voxel data compactly: cell i is the i-th set voxel in the order of the grid's
+// words and bits, i.e. the cell of a set voxel is m_wordRanks[word] plus the number of set voxels below it in its word.
+struct CpuVoxelRanks {
+	std::vector<UINT32> m_wordRanks;		// number of set voxels in the words before each word of the grid
+
+	template<typename TWord>
+	UINT32 GetCell(const BasicVoxelGrid<TWord>& grid, UINT x, UINT y, UINT z) const;
+};
+
+// Triangles overlapping each voxel set by the conservative surface voxelization, in compressed sparse row form.
+struct CpuVoxelTriangleLists : CpuVoxelRanks {
+	std::vector<UINT32> m_cellOffsets;		// triangles of cell i are m_cellTriangles[m_cellOffsets[i], m_cellOffsets[i + 1])
+	std::vector<UINT32> m_cellTriangles;	// ascending within each cell
+};
+
+// CPU_VOXELIZATION_SURFACE_CONSERVATIVE that additionally records which triangles set each voxel, so that the grid becomes a uniform
+// grid acceleration structure over the mesh. The triangles are voxelized into the grid first; two more passes over the triangles
+// then emit their (voxel, triangle) pairs, the first counting the pairs per cell (whose prefix sum are the cell offsets) and the
+// second scattering the triangle indices to their cells. Fails with E_OUTOFMEMORY if the number of pairs exceeds 32 bits.
+template<typename TWord>
+HRESULT VoxelizeSurfaceConservativeOnCpu(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], BasicVoxelGrid<TWord>& grid, CpuVoxelTriangleLists& lists);
+
+// Attributes of the voxels set by a surface voxelization, one per cell. Voxels set by more than 4112 triangles may get wrong normals.
+struct CpuVoxelAttributes : CpuVoxelRanks {
+	std::vector<UINT32> m_normals;			// DXGI_FORMAT_R8G8B8A8_SNORM: average of the model-space normals of the triangles setting the voxel, normalized; w = 0
+	std::vector<UINT32> m_materials;		// material of the triangle with the smallest index setting the voxel; empty if no materials are given
+};
+
+// CPU_VOXELIZATION_SURFACE_CONSERVATIVE or CPU_VOXELIZATION_SURFACE that also fills the attribute channels, with triangleMaterials
+// holding a material id per triangle or being nullptr. The attributes are filled in the pass that sets the voxels: the grid is split
+// into bands of 8 rows, each voxelized by one worker thread from the triangles touching it, clipped to its rows. The worker records
+// the words it sets along with the triangle and, once the band is complete, ranks its words and replays the records into its cells,
+// so only the records of the bands in flight are held. Normals are summed in fixed point, the three components packed into one
+// 64-bit integer, and materials are those of the triangle with the smallest index, making the results independent of the
+// scheduling of the worker threads.
+template<typename TWord>
+HRESULT VoxelizeOnCpu(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], CpuVoxelizationMethod method, BasicVoxelGrid<TWord>& grid, const UINT32* triangleMaterials, CpuVoxelAttributes& attributes);
@@ -12,6 +12,22 @@
 #include "DXUTcamera.h"
 #include "DXUTsettingsdlg.h"
 #include "SDKmisc.h"
+#include "CpuVoxelizer.h"
+#include "DistanceField.h"
+#include "MeshRaycaster.h"
+#include "Parallel.h"
+#include "PointCloudVoxelizer.h"
+#include "Profiler.h"
+#include "SparseVoxelizer.h"
+#include "TriangleBvh.h"
+#include "VoxelAnalytics.h"
+#include "VoxelCache.h"
+#include "VoxelCsg.h"
+#include "VoxelMesher.h"
+#include "VoxelMorphology.h"
+#include "VoxelSlicer.h"
+#include <cfloat>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -30,6 +46,7 @@ CDXUTTextHelper* g_textHelper = nullptr;
 // states
 ID3D11RasterizerState* g_rastDefault = nullptr;
 ID3D11RasterizerState* g_rastNoCull = nullptr;
+ID3D11RasterizerState* g_rastNoCullNoDepthClip = nullptr;	// for the solid voxelization via rendering, which counts crossings in front of the grid
 
 ID3D11Query* g_qryTimestamp1 = nullptr;
 ID3D11Query* g_qryTimestamp2 = nullptr;
@@ -40,10 +57,19 @@ ID3D11Buffer* g_vbMesh = nullptr;
 ID3D11Buffer* g_ibMesh = nullptr;
 ID3D11ShaderResourceView* g_srvVbMesh = nullptr;
 ID3D11ShaderResourceView* g_srvIbMesh = nullptr;
+ID3D11Buffer* g_ibWindow = nullptr;				// indices of the triangles touching the voxel window
+ID3D11ShaderResourceView* g_srvIbWindow = nullptr;
+ID3D11Buffer* g_bufTriangleSetup = nullptr;			// triangle setup stream (see CS_SetupTriangles)
+ID3D11UnorderedAccessView* g_uavTriangleSetup = nullptr;
+ID3D11ShaderResourceView* g_srvTriangleSetup = nullptr;
 ID3D11InputLayout* g_ilytMesh = nullptr;
 UINT g_bytesPerMeshVertex;
 UINT g_numMeshVertices;
 UINT g_numMeshIndices;
+VoxelCacheKey g_meshDigest;			// hash of vertex and index data
+std::vector<float> g_cpuMeshVertices;		// copies of vertex and index data for voxelization on the CPU
+std::vector<UINT32> g_cpuMeshIndices;
+TriangleBvh g_meshBvh;					// for culling the mesh to the voxel window
 
 // full-screen quad
 ID3D11Buffer* g_vbQuad = nullptr;
@@ -54,6 +80,9 @@ UINT g_bytesPerQuadVertex;
 ID3D11Buffer* g_bufVoxelization = nullptr;
 ID3D11UnorderedAccessView* g_uavVoxelization = nullptr;
 ID3D11ShaderResourceView* g_srvVoxelization = nullptr;
+ID3D11Buffer* g_bufVoxelizationReadback = nullptr;
+ID3D11Buffer* g_bufVoxelizationTemp = nullptr;
+ID3D11UnorderedAccessView* g_uavVoxelizationTemp = nullptr;
 
 // dummy render target for rasterization-based voxelization
 ID3D11Texture2D* g_texVoxelizationDummy = nullptr;
@@ -73,6 +102,10 @@ ID3D11PixelShader* g_psRenderVoxelizationRaycasting = nullptr;
 ID3D11ComputeShader* g_csVoxelizeSolid = nullptr;
 ID3D11ComputeShader* g_csVoxelizeSolid_Propagate = nullptr;
 ID3D11ComputeShader* g_csVoxelizeSurfaceConservative = nullptr;
+ID3D11ComputeShader* g_csSetupTriangles = nullptr;
+ID3D11ComputeShader* g_csVoxelizeSolidFromSetup = nullptr;
+ID3D11ComputeShader* g_csVoxelizeSurfaceConservativeFromSetup = nullptr;
+ID3D11ComputeShader* g_csMorphology[2][3] = {};			// dilate/erode with 6/18/26-neighborhood
 
 // configuration
 bool g_displayVoxelization = false;
@@ -83,6 +116,12 @@ enum VoxelizationMethod {
 	VOXELIZATION_SOLID_COMPUTE,
 	VOXELIZATION_SURFACE_PS,
 	VOXELIZATION_SURFACE_CONSERVATIVE_COMPUTE,
+	VOXELIZATION_SOLID_CPU,
+	VOXELIZATION_SURFACE_CONSERVATIVE_CPU,
+	VOXELIZATION_SURFACE_CONSERVATIVE_SPARSE_CPU,
+	VOXELIZATION_SURFACE_CPU,
+	VOXELIZATION_POINT_CLOUD_CPU,
+	VOXELIZATION_SOLID_FLOOD_FILL_CPU,
 };
 bool g_voxelize = false;
 UINT g_voxelizationMethod = VOXELIZATION_SURFACE_PS;
@@ -90,14 +129,124 @@ UINT g_voxelizationMethod = VOXELIZATION_SURFACE_PS;
 bool g_validVoxelization = false;
 double g_secsVoxelization = 0.0;
 
+// cache of voxelization results
+VoxelCache g_voxelCache;
+bool g_useVoxelCache = false;
+bool g_voxelizationFromCache = false;
+
+// clearance margin added to the voxelization by dilation
+UINT g_clearanceMargin = 0;
+const UINT c_maxClearanceMargin = 3;
+
+// export of the voxelization as mesh
+bool g_exportVoxelizationMesh = false;
+HRESULT g_hrVoxelizationMeshExport = S_FALSE;			// S_FALSE if no export has happened yet
+
+// volumetric measures of the voxelization, computed after each voxelization while shown
+bool g_showVoxelAnalytics = false;
+VoxelAnalytics g_voxelAnalytics;
+HRESULT g_hrVoxelAnalytics = S_FALSE;					// S_FALSE if no voxelization has been analyzed yet
+
+// voxelization stored for testing the following ones for overlap with it, such as the model at another grid size or a window of it
+bool g_toggleOverlapReference = false;
+std::vector<UINT32> g_overlapReference;				// empty if none is stored
+VoxelGridLayout g_overlapReferenceLayout;
+XMFLOAT3A g_overlapReferenceSpace[2];					// g_voxelSpace of the stored voxelization
+bool g_voxelizationOverlaps = false;
+HRESULT g_hrOverlapTest = E_PENDING;					// S_FALSE if the voxels are not aligned, E_PENDING if no voxelization was tested yet
+
+// boolean operation combining each following voxelization with the stored one after the overlap test; U cycles through them
+const VoxelCsgOp c_voxelCsgOps[] = { VOXEL_CSG_UNION, VOXEL_CSG_INTERSECTION, VOXEL_CSG_DIFFERENCE, VOXEL_CSG_XOR };
+const WCHAR* c_voxelCsgOpNames[] = { L"union", L"intersection", L"difference", L"xor" };
+UINT g_voxelCsgMode = 0;								// 0 for none, otherwise index into c_voxelCsgOps + 1
+HRESULT g_hrVoxelCsg = E_PENDING;						// S_FALSE if the voxels are not aligned, E_PENDING if nothing was combined yet
+
+// export of the voxelization as stack of z-slices, each a bitmap in the layout of MakeVoxelSliceLayout
+bool g_exportVoxelizationSlices = false;
+HRESULT g_hrVoxelizationSliceExport = S_FALSE;			// S_FALSE if no export has happened yet
+
+// export of the voxelization's distance field, signed for the solid methods, as 16-bit integers in 1/c_distanceFieldScale voxels
+bool g_exportDistanceField = false;
+HRESULT g_hrDistanceFieldExport = S_FALSE;				// S_FALSE if no export has happened yet
+const float c_distanceFieldScale = 16.0f;
+float g_distanceFieldRange[2] = { 0.0f, 0.0f };			// min, max in voxels
+
+// exact intersection of the ray under the cursor with the part of the model inside of the voxel grid, accelerated by the conservative
+// surface voxelization of the MeshRaycaster
+bool g_showCursorHit = false;
+MeshRaycaster g_meshRaycaster;
+bool g_validMeshRaycaster = false;						// reset by SetupVoxelization
+HRESULT g_hrCursorHit = S_FALSE;						// S_OK on a hit, S_FALSE on a miss
+UINT32 g_cursorHitTriangle = 0;
+XMFLOAT3 g_cursorHitPos;								// world space
+
+// profiling of the CPU pipeline, running from startup so that model loading is captured
+HRESULT g_hrProfileTrace = S_FALSE;						// S_FALSE if no trace has been written yet
+
+// voxelization on the CPU, using 64-bit voxel words; the result is converted to the 32-bit layout and uploaded
+typedef VoxelGrid64 CpuVoxelGrid;
+CpuVoxelGrid g_cpuVoxelGrid;
+SparseVoxelGrid g_sparseVoxelGrid;
+std::vector<UINT32> g_cpuVoxelUpload;
+double g_secsCpuVoxelization = 0.0;
+
+// per-voxel normals computed along with the CPU surface voxelizations
+bool g_computeVoxelAttributes = false;
+CpuVoxelAttributes g_cpuVoxelAttributes;
+
+// point cloud voxelized instead of the model, streamed from a file of bare world-space positions (three floats per point)
+const WCHAR* c_pointCloudFileName = L"pointcloud.bin";
+UINT64 g_numCloudPoints = 0;
+
 UINT g_gridSizeX = 128;
 UINT g_gridSizeY = 128;
 UINT g_gridSizeZ = 128;
 bool g_useCubeVoxels = false;
 
+// region of interest: the voxel grid covers the world-space box g_voxelWindow, and only the triangles touching this window are
+// voxelized; W cycles through the presets, given as fractions of the model's bounding box
+struct VoxelWindowPreset {
+	float m_min[3];
+	float m_max[3];
+	const WCHAR* m_name;
+};
+
+const VoxelWindowPreset c_voxelWindowPresets[] = {
+	{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, L"model" },
+	{ { 0.25f, 0.25f, 0.25f }, { 0.75f, 0.75f, 0.75f }, L"1/2 around center" },
+	{ { 0.375f, 0.375f, 0.375f }, { 0.625f, 0.625f, 0.625f }, L"1/4 around center" },
+	{ { 0.4375f, 0.4375f, 0.4375f }, { 0.5625f, 0.5625f, 0.5625f }, L"1/8 around center" },
+	{ { 0.0f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f }, L"upper half" },
+	{ { 0.5f, 0.5f, 0.5f }, { 1.0f, 1.0f, 1.0f }, L"upper octant" },
+	{ { 0.0f, 0.0f, 0.375f }, { 1.0f, 1.0f, 0.625f }, L"z-slab" },
+};
+
+UINT g_voxelWindowPreset = 0;
+XMFLOAT3A g_voxelWindow[2];					// min, max
+std::vector<UINT32> g_windowIndices;
+UINT g_numWindowTriangles = 0;
+bool g_validWindowTriangles = false;			// reset by SetupVoxelization
+int g_windowTrianglesExtendedAxis = -1;			// axis along which the triangles before the window are included, -1 if none
+
+// triangle setup stream for the compute shader voxelizations; it is rebuilt only when the triangles or g_matWorldToVoxel change, so
+// it is shared by both methods, by grid sizes with the same transformation and by repeated voxelizations
+const UINT c_numTriangleSetupArrays = 13;
+bool g_useTriangleSetup = false;
+bool g_validTriangleSetup = false;
+bool g_triangleSetupRebuilt = false;
+XMFLOAT4X4A g_matTriangleSetup;				// g_matWorldToVoxel the stream was built for
+
 UINT g_strideX;
-UINT g_strideY;
-UINT g_dataSize;
+UINT64 g_strideY;
+UINT64 g_dataSize;
+
+// Direct3D 11 limits a single resource to 2 GiB, which bounds the grids that can be voxelized or displayed on the GPU; larger grids
+// (up to the 64-bit sizes of VoxelGridLayout) are left to the CPU voxelization methods
+const UINT64 c_maxVoxelizationBufferBytes = UINT64(D3D11_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM) << 20;
+
+// uploads to the voxelization buffer are split into chunks of whole y slices of at most this size, which bounds the runtime's
+// intermediate copies
+const UINT64 c_maxVoxelizationUploadBytes = UINT64(64) << 20;
 
 XMFLOAT3A g_voxelSpace[2];			// min/max corners of axis-aligned box encompassing the voxel grid
 XMFLOAT4X4A g_matWorldToVoxel;
@@ -129,6 +278,7 @@ __declspec(align(16)) struct CB_VoxelGrid {
 __declspec(align(16)) struct CB_ModelInput {
 	UINT m_numModelTriangles;
 	UINT m_vertexFloatStride;
+	UINT m_triangleSetupStride;
 };
 
 __declspec(align(16)) struct CB_Raycasting {
@@ -168,8 +318,14 @@ void InitApp();
 
 HRESULT CreateVoxelizationResources(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext);
 void ReleaseVoxelizationResources();
+void SetVoxelWindowPreset(UINT preset);
 void SetupVoxelization();
 void VoxelizeViaRendering(ID3D11DeviceContext* pd3dImmediateContext);
+bool VoxelizeViaCache(ID3D11DeviceContext* pd3dImmediateContext);
+HRESULT StoreVoxelizationInCache(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext);
+HRESULT VoxelizeViaCpu(ID3D11DeviceContext* pd3dImmediateContext);
+VoxelGridLayout GetVoxelGridLayout();
+void UploadVoxelization(ID3D11DeviceContext* pd3dImmediateContext, const UINT32* voxels);
 
 void RenderModel(ID3D11DeviceContext* pd3dImmediateContext);
 void RenderText();
@@ -210,6 +366,13 @@ void InitApp() {
 	g_settingsDlg.Init(&g_dialogResourceManager);
 	g_dlg.Init(&g_dialogResourceManager);
 	g_dlg.SetCallback(OnGUIEvent);
+
+	StartProfiling();
+
+	// results are kept on disk across runs; without a writable cache directory, only the in-memory tier is used
+	const UINT64 MiB = 1024 * 1024;
+	if(FAILED(g_voxelCache.Init(L"VoxelCache", 256 * MiB, 4096 * MiB)))
+		g_voxelCache.Init(nullptr, 256 * MiB, 0);
 }
 
 //--------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -236,7 +399,7 @@ HRESULT CompileShaderFromFile(WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szS
 
 	// compile the shader
 	ID3DBlob* pErrorBlob = nullptr;
-	HRESULT hr = D3DCompileFromFile(szFileName, pDefines, nullptr, szEntryPoint, szShaderModel, dwShaderFlags, 0, ppBlobOut, &pErrorBlob);
+	HRESULT hr = D3DCompileFromFile(szFileName, pDefines, D3D_COMPILE_STANDARD_FILE_INCLUDE, szEntryPoint, szShaderModel, dwShaderFlags, 0, ppBlobOut, &pErrorBlob);
 
 	if(FAILED(hr) && pErrorBlob != nullptr)
 		OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
@@ -274,10 +437,10 @@ HRESULT CreatePixelShader(ID3D11Device* pd3dDevice, WCHAR* szFileName, LPCSTR sz
 	return hr;
 }
 
-HRESULT CreateComputeShader(ID3D11Device* pd3dDevice, WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3D11ComputeShader** ppComputeShader) {
+HRESULT CreateComputeShader(ID3D11Device* pd3dDevice, WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3D11ComputeShader** ppComputeShader, const D3D_SHADER_MACRO* pDefines = nullptr) {
 	ID3DBlob* pBlob = nullptr;
 	HRESULT hr;
-	if(!FAILED(hr = CompileShaderFromFile(szFileName, szEntryPoint, szShaderModel, &pBlob)) &&
+	if(!FAILED(hr = CompileShaderFromFile(szFileName, szEntryPoint, szShaderModel, &pBlob, pDefines)) &&
 		!FAILED(hr = pd3dDevice->CreateComputeShader(pBlob->GetBufferPointer(), pBlob->GetBufferSize(), nullptr, ppComputeShader)))
 	{
 		DXUT_SetDebugName(*ppComputeShader, szEntryPoint);
@@ -289,6 +452,8 @@ HRESULT CreateComputeShader(ID3D11Device* pd3dDevice, WCHAR* szFileName, LPCSTR
 //--------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 HRESULT LoadModel(ID3D11Device* pd3dDevice, char* filename) {
+	PROFILE_SCOPE("Load model");
+
 	// extremely basic OBJ loader
 	std::ifstream objFile(filename);
 	if(objFile.fail())
@@ -303,6 +468,7 @@ HRESULT LoadModel(ID3D11Device* pd3dDevice, char* filename) {
 	std::vector<XMFLOAT3> normals;
 	std::vector<Vertex> vertices;
 	std::vector<UINT32> indices;
+	std::vector<UINT64> cornerKeys;		// position and normal index of each face corner
 	typedef std::unordered_map<UINT64, UINT32> map_t;
 	map_t existingVertices;
 
@@ -341,19 +507,28 @@ HRESULT LoadModel(ID3D11Device* pd3dDevice, char* filename) {
 
 				UINT64 key = UINT32(indexP);
 				key |= UINT64(indexN) << 32;
+				cornerKeys.push_back(key);
+			}
+		}
+	}
 
-				map_t::iterator it = existingVertices.find(key);
-				if(it != existingVertices.end()) {
-					indices.push_back(it->second);
-				} else {
-					Vertex v;
-					v.m_position = positions[indexP - 1];
-					v.m_normal = (indexN > 0) ? normals[indexN - 1] : XMFLOAT3(0.0f, 0.0f, 0.0f);
-					UINT32 index = UINT32(vertices.size());
-					vertices.push_back(v);
-					indices.push_back(index);
-					existingVertices[key] = index;
-				}
+	// merge corners with the same position and normal into one vertex
+	{
+		PROFILE_SCOPE("Deduplicate vertices");
+		for(UINT64 key : cornerKeys) {
+			map_t::iterator it = existingVertices.find(key);
+			if(it != existingVertices.end()) {
+				indices.push_back(it->second);
+			} else {
+				const UINT32 indexP = UINT32(key);
+				const UINT32 indexN = UINT32(key >> 32);
+				Vertex v;
+				v.m_position = positions[indexP - 1];
+				v.m_normal = (indexN > 0) ? normals[indexN - 1] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+				UINT32 index = UINT32(vertices.size());
+				vertices.push_back(v);
+				indices.push_back(index);
+				existingVertices[key] = index;
 			}
 		}
 	}
@@ -371,10 +546,30 @@ HRESULT LoadModel(ID3D11Device* pd3dDevice, char* filename) {
 	}
 	XMStoreFloat3A(&g_aabbModel[0], aabbModelMin);
 	XMStoreFloat3A(&g_aabbModel[1], aabbModelMax);
+	SetVoxelWindowPreset(g_voxelWindowPreset);
+
+	// identify mesh for the voxelization cache
+	VoxelCacheKeyBuilder meshDigest;
+	meshDigest.Add(&vertices[0], sizeof(Vertex) * vertices.size());
+	meshDigest.Add(&indices[0], sizeof(UINT32) * indices.size());
+	g_meshDigest = meshDigest.Finalize();
+
+	// keep positions and indices for voxelization on the CPU
+	g_cpuMeshVertices.assign(&vertices[0].m_position.x, &vertices[0].m_position.x + vertices.size() * sizeof(Vertex) / sizeof(float));
+	g_cpuMeshIndices = indices;
 
-	// create buffers
 	HRESULT hr;
 
+	// build hierarchy for culling the mesh to the voxel window
+	CpuVoxelizationMesh mesh;
+	mesh.m_vertices = &g_cpuMeshVertices[0];
+	mesh.m_vertexFloatStride = sizeof(Vertex) / sizeof(float);
+	mesh.m_indices = &g_cpuMeshIndices[0];
+	mesh.m_numTriangles = UINT(indices.size() / 3);
+	V_RETURN(g_meshBvh.Build(mesh));
+
+	// create buffers
+
 	g_bytesPerMeshVertex = sizeof(Vertex);
 	g_numMeshVertices = UINT(vertices.size());
 	g_numMeshIndices = UINT(indices.size());
@@ -422,6 +617,34 @@ HRESULT LoadModel(ID3D11Device* pd3dDevice, char* filename) {
 	srvDesc.Buffer.ElementWidth = bufferDesc.ByteWidth / 4;
 	V_RETURN(pd3dDevice->CreateShaderResourceView(g_ibMesh, &srvDesc, &g_srvIbMesh));
 
+	// create index buffer for the triangles touching the voxel window, filled before each voxelization
+	V_RETURN(pd3dDevice->CreateBuffer(&bufferDesc, &initialData, &g_ibWindow));
+	V_RETURN(pd3dDevice->CreateShaderResourceView(g_ibWindow, &srvDesc, &g_srvIbWindow));
+
+	// create buffer for triangle setup stream: header and c_numTriangleSetupArrays arrays of one float4 per triangle
+	bufferDesc.ByteWidth = UINT(16 + c_numTriangleSetupArrays * 16 * (g_numMeshIndices / 3));
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	bufferDesc.StructureByteStride = 0;
+	V_RETURN(pd3dDevice->CreateBuffer(&bufferDesc, nullptr, &g_bufTriangleSetup));
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+	uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.FirstElement = 0;
+	uavDesc.Buffer.NumElements = bufferDesc.ByteWidth / 4;
+	uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	V_RETURN(pd3dDevice->CreateUnorderedAccessView(g_bufTriangleSetup, &uavDesc, &g_uavTriangleSetup));
+
+	srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+	srvDesc.BufferEx.FirstElement = 0;
+	srvDesc.BufferEx.NumElements = bufferDesc.ByteWidth / 4;
+	srvDesc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+	V_RETURN(pd3dDevice->CreateShaderResourceView(g_bufTriangleSetup, &srvDesc, &g_srvTriangleSetup));
+	g_validTriangleSetup = false;
+
 	return S_OK;
 }
 
@@ -492,6 +715,26 @@ HRESULT CALLBACK OnCreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFACE_DES
 	V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_VoxelizeSolid", "cs_5_0", &g_csVoxelizeSolid));
 	V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_VoxelizeSolid_Propagate", "cs_5_0", &g_csVoxelizeSolid_Propagate));
 	V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_VoxelizeSurfaceConservative", "cs_5_0", &g_csVoxelizeSurfaceConservative));
+	{
+		const D3D_SHADER_MACRO defines[] = {
+			{ "TRIANGLE_SETUP", "1" },
+			{ nullptr, nullptr },
+		};
+		V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_SetupTriangles", "cs_5_0", &g_csSetupTriangles));
+		V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_VoxelizeSolid", "cs_5_0", &g_csVoxelizeSolidFromSetup, defines));
+		V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_VoxelizeSurfaceConservative", "cs_5_0", &g_csVoxelizeSurfaceConservativeFromSetup, defines));
+	}
+	for(UINT op = 0; op < 2; op++) {
+		const char* neighborhoods[3] = { "6", "18", "26" };
+		for(UINT i = 0; i < 3; i++) {
+			const D3D_SHADER_MACRO defines[] = {
+				{ "MORPHOLOGY_ERODE", op == 0 ? "0" : "1" },
+				{ "MORPHOLOGY_NEIGHBORHOOD", neighborhoods[i] },
+				{ nullptr, nullptr },
+			};
+			V_RETURN(CreateComputeShader(pd3dDevice, L"Voxelization.hlsl", "CS_Morphology", "cs_5_0", &g_csMorphology[op][i], defines));
+		}
+	}
 
 	V_RETURN(CreateVertexShader(pd3dDevice, L"Raycasting.hlsl", "VS_RenderVoxelizationRaycasting", "vs_5_0", &g_vsRenderVoxelizationRaycasting, &pBlob));
 	V_RETURN(pd3dDevice->CreateInputLayout(inputElementDescsQuad, ARRAYSIZE(inputElementDescsMesh), pBlob->GetBufferPointer(), pBlob->GetBufferSize(), &g_ilytQuad));
@@ -538,6 +781,10 @@ HRESULT CALLBACK OnCreateDevice(ID3D11Device* pd3dDevice, const DXGI_SURFACE_DES
 	V_RETURN(pd3dDevice->CreateRasterizerState(&rastDesc, &g_rastNoCull));
 	DXUT_SetDebugName(g_rastNoCull, "rastNoCull");
 
+	rastDesc.DepthClipEnable = FALSE;
+	V_RETURN(pd3dDevice->CreateRasterizerState(&rastDesc, &g_rastNoCullNoDepthClip));
+	DXUT_SetDebugName(g_rastNoCullNoDepthClip, "rastNoCullNoDepthClip");
+
 	// query states
 	D3D11_QUERY_DESC qryDesc;
 
@@ -574,6 +821,7 @@ void CALLBACK OnDestroyDevice(void* pUserContext) {
 
 	SAFE_RELEASE(g_rastDefault);
 	SAFE_RELEASE(g_rastNoCull);
+	SAFE_RELEASE(g_rastNoCullNoDepthClip);
 
 	SAFE_RELEASE(g_qryTimestamp1);
 	SAFE_RELEASE(g_qryTimestamp2);
@@ -589,6 +837,13 @@ void CALLBACK OnDestroyDevice(void* pUserContext) {
 	SAFE_RELEASE(g_csVoxelizeSolid);
 	SAFE_RELEASE(g_csVoxelizeSolid_Propagate);
 	SAFE_RELEASE(g_csVoxelizeSurfaceConservative);
+	SAFE_RELEASE(g_csSetupTriangles);
+	SAFE_RELEASE(g_csVoxelizeSolidFromSetup);
+	SAFE_RELEASE(g_csVoxelizeSurfaceConservativeFromSetup);
+	for(UINT op = 0; op < 2; op++) {
+		for(UINT i = 0; i < 3; i++)
+			SAFE_RELEASE(g_csMorphology[op][i]);
+	}
 
 	SAFE_RELEASE(g_ilytMesh);
 	SAFE_RELEASE(g_ilytQuad);
@@ -603,6 +858,11 @@ void CALLBACK OnDestroyDevice(void* pUserContext) {
 	SAFE_RELEASE(g_ibMesh);
 	SAFE_RELEASE(g_srvVbMesh);
 	SAFE_RELEASE(g_srvIbMesh);
+	SAFE_RELEASE(g_ibWindow);
+	SAFE_RELEASE(g_srvIbWindow);
+	SAFE_RELEASE(g_bufTriangleSetup);
+	SAFE_RELEASE(g_uavTriangleSetup);
+	SAFE_RELEASE(g_srvTriangleSetup);
 
 	SAFE_RELEASE(g_vbQuad);
 
@@ -668,9 +928,12 @@ void CALLBACK OnFrameMove(double fTime, float fElapsedTime, void* pUserContext)
 HRESULT CreateVoxelizationResources(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext) {
 	HRESULT hr;
 
+	if(g_dataSize * 4 > c_maxVoxelizationBufferBytes)
+		return E_OUTOFMEMORY;
+
 	// create voxelization buffer (one bit per voxel)
 	D3D11_BUFFER_DESC bufDesc;
-	bufDesc.ByteWidth = g_dataSize * 4;
+	bufDesc.ByteWidth = UINT(g_dataSize * 4);
 	bufDesc.Usage = D3D11_USAGE_DEFAULT;
 	bufDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
 	bufDesc.CPUAccessFlags = 0;
@@ -729,23 +992,45 @@ void ReleaseVoxelizationResources() {
 	SAFE_RELEASE(g_bufVoxelization);
 	SAFE_RELEASE(g_uavVoxelization);
 	SAFE_RELEASE(g_srvVoxelization);
+	SAFE_RELEASE(g_bufVoxelizationReadback);
+	SAFE_RELEASE(g_bufVoxelizationTemp);
+	SAFE_RELEASE(g_uavVoxelizationTemp);
 
 	SAFE_RELEASE(g_texVoxelizationDummy);
 	SAFE_RELEASE(g_rtvVoxelizationDummy);
 }
 
+// sets g_voxelWindow to the preset's part of the model's bounding box
+void SetVoxelWindowPreset(UINT preset) {
+	g_voxelWindowPreset = preset;
+
+	const VoxelWindowPreset& p = c_voxelWindowPresets[preset];
+	const XMVECTOR aabbMin = XMLoadFloat3A(&g_aabbModel[0]);
+	const XMVECTOR aabbExtent = XMLoadFloat3A(&g_aabbModel[1]) - aabbMin;
+	XMStoreFloat3A(&g_voxelWindow[0], aabbMin + XMVectorSet(p.m_min[0], p.m_min[1], p.m_min[2], 0.0f) * aabbExtent);
+	XMStoreFloat3A(&g_voxelWindow[1], aabbMin + XMVectorSet(p.m_max[0], p.m_max[1], p.m_max[2], 0.0f) * aabbExtent);
+}
+
+// whether the voxel window leaves out parts of the model, whose triangles are then culled
+bool IsModelCroppedByVoxelWindow() {
+	return g_voxelWindow[0].x > g_aabbModel[0].x || g_voxelWindow[0].y > g_aabbModel[0].y || g_voxelWindow[0].z > g_aabbModel[0].z ||
+	       g_voxelWindow[1].x < g_aabbModel[1].x || g_voxelWindow[1].y < g_aabbModel[1].y || g_voxelWindow[1].z < g_aabbModel[1].z;
+}
+
 void SetupVoxelization() {
+	PROFILE_SCOPE("Setup voxelization");
+
 	g_strideX = (g_gridSizeZ + 31) / 32;
-	g_strideY = g_strideX * g_gridSizeX;
+	g_strideY = UINT64(g_strideX) * g_gridSizeX;
 	g_dataSize = g_strideY * g_gridSizeY;
 
-	XMVECTOR extent = XMLoadFloat3A(&g_aabbModel[1]) - XMLoadFloat3A(&g_aabbModel[0]);
+	XMVECTOR extent = XMLoadFloat3A(&g_voxelWindow[1]) - XMLoadFloat3A(&g_voxelWindow[0]);
 	XMVECTORF32 gridSize = { float(g_gridSizeX), float(g_gridSizeY), float(g_gridSizeZ) };
 	extent *= (gridSize + XMVectorReplicate(2.0f)) / gridSize;
 	if(g_useCubeVoxels)
 		extent = XMVectorReplicate(std::max(XMVectorGetX(extent), std::max(XMVectorGetY(extent), XMVectorGetZ(extent))));
 
-	XMVECTOR center = 0.5f * (XMLoadFloat3A(&g_aabbModel[0]) + XMLoadFloat3A(&g_aabbModel[1]));
+	XMVECTOR center = 0.5f * (XMLoadFloat3A(&g_voxelWindow[0]) + XMLoadFloat3A(&g_voxelWindow[1]));
 	XMVECTOR voxelSpaceMin = center - 0.5f * extent;
 	XMStoreFloat3A(&g_voxelSpace[0], voxelSpaceMin);
 	XMStoreFloat3A(&g_voxelSpace[1], voxelSpaceMin + extent);
@@ -756,6 +1041,77 @@ void SetupVoxelization() {
 	XMStoreFloat4x4A(&g_matWorldToVoxelProj, XMMatrixMultiplyTranspose(
 		XMMatrixTranslation(-XMVectorGetX(center), -XMVectorGetY(center), -XMVectorGetZ(voxelSpaceMin)),
 		XMMatrixScalingFromVector(XMVectorSet(2.0f, 2.0f, 1.0f, 0.0f) / extent)));
+
+	g_validWindowTriangles = false;
+	g_validMeshRaycaster = false;
+}
+
+// determines the triangles that may touch the voxel window via the BVH and uploads their indices to g_ibWindow; the parity-based solid
+// methods also need the triangles before the window along the axis of their columns, since their crossings flip whole columns: y for
+// the compute and CPU methods and z for rasterization, which renders them without depth clipping. The flood fill solidifies only what
+// the window's border encloses, so it needs no more than the surface methods.
+void CullTrianglesToVoxelWindow(ID3D11DeviceContext* pd3dImmediateContext) {
+	int extendedAxis = -1;
+	if(g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE || g_voxelizationMethod == VOXELIZATION_SOLID_CPU)
+		extendedAxis = 1;
+	else if(g_voxelizationMethod == VOXELIZATION_SOLID_PS)
+		extendedAxis = 2;
+	if(g_validWindowTriangles && g_windowTrianglesExtendedAxis == extendedAxis)
+		return;
+
+	PROFILE_SCOPE("Cull triangles to window");
+	g_validWindowTriangles = true;
+	g_windowTrianglesExtendedAxis = extendedAxis;
+
+	g_windowIndices.clear();
+	if(!IsModelCroppedByVoxelWindow()) {
+		g_numWindowTriangles = g_numMeshIndices / 3;
+		return;
+	}
+
+	g_validTriangleSetup = false;
+
+	// enlarge the window by a voxel, as the conservative methods also set voxels whose neighbors are touched
+	const float voxelSize[3] = {
+		(g_voxelSpace[1].x - g_voxelSpace[0].x) / float(g_gridSizeX),
+		(g_voxelSpace[1].y - g_voxelSpace[0].y) / float(g_gridSizeY),
+		(g_voxelSpace[1].z - g_voxelSpace[0].z) / float(g_gridSizeZ),
+	};
+	float boxMin[3] = { g_voxelSpace[0].x - voxelSize[0], g_voxelSpace[0].y - voxelSize[1], g_voxelSpace[0].z - voxelSize[2] };
+	const float boxMax[3] = { g_voxelSpace[1].x + voxelSize[0], g_voxelSpace[1].y + voxelSize[1], g_voxelSpace[1].z + voxelSize[2] };
+	if(extendedAxis >= 0)
+		boxMin[extendedAxis] = -FLT_MAX;
+
+	std::vector<UINT32> triangles;
+	g_meshBvh.FindTriangles(boxMin, boxMax, triangles);
+
+	g_numWindowTriangles = UINT(triangles.size());
+	g_windowIndices.resize(triangles.size() * 3);
+	for(size_t i = 0; i < triangles.size(); i++) {
+		g_windowIndices[i * 3] = g_cpuMeshIndices[triangles[i] * 3];
+		g_windowIndices[i * 3 + 1] = g_cpuMeshIndices[triangles[i] * 3 + 1];
+		g_windowIndices[i * 3 + 2] = g_cpuMeshIndices[triangles[i] * 3 + 2];
+	}
+
+	if(g_numWindowTriangles > 0) {
+		D3D11_BOX box;
+		box.left = 0;
+		box.right = UINT(sizeof(UINT32) * g_windowIndices.size());
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		pd3dImmediateContext->UpdateSubresource(g_ibWindow, 0, &box, &g_windowIndices[0], 0, 0);
+	}
+}
+
+// index buffer and its view holding the g_numWindowTriangles triangles to be voxelized
+ID3D11Buffer* GetWindowIndexBuffer() {
+	return IsModelCroppedByVoxelWindow() ? g_ibWindow : g_ibMesh;
+}
+
+ID3D11ShaderResourceView* GetWindowIndexBufferView() {
+	return IsModelCroppedByVoxelWindow() ? g_srvIbWindow : g_srvIbMesh;
 }
 
 void VoxelizeViaRendering(ID3D11DeviceContext* pd3dImmediateContext) {
@@ -774,11 +1130,11 @@ void VoxelizeViaRendering(ID3D11DeviceContext* pd3dImmediateContext) {
 	viewport.MaxDepth = D3D11_MAX_DEPTH;
 	pd3dImmediateContext->RSSetViewports(1, &viewport);
 
-	pd3dImmediateContext->RSSetState(g_rastNoCull);
+	pd3dImmediateContext->RSSetState(g_voxelizationMethod == VOXELIZATION_SURFACE_PS ? g_rastNoCull : g_rastNoCullNoDepthClip);
 
 	pd3dImmediateContext->IASetInputLayout(g_ilytMesh);
 	pd3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	pd3dImmediateContext->IASetIndexBuffer(g_ibMesh, DXGI_FORMAT_R32_UINT, 0);
+	pd3dImmediateContext->IASetIndexBuffer(GetWindowIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
 	UINT strides[1] = { g_bytesPerMeshVertex };
 	UINT offsets[1] = { 0 };
 	pd3dImmediateContext->IASetVertexBuffers(0, 1, &g_vbMesh, strides, offsets);
@@ -791,7 +1147,7 @@ void VoxelizeViaRendering(ID3D11DeviceContext* pd3dImmediateContext) {
 	XMStoreFloat4x4(&cbVoxelGrid->m_matModelToProj, XMLoadFloat4x4A(&g_matWorldToVoxelProj) * matModelToWorld);
 	XMStoreFloat4x4(&cbVoxelGrid->m_matModelToVoxel, XMLoadFloat4x4A(&g_matWorldToVoxel) * matModelToWorld);
 	cbVoxelGrid->m_stride[0] = g_strideX * 4;
-	cbVoxelGrid->m_stride[1] = g_strideY * 4;
+	cbVoxelGrid->m_stride[1] = UINT(g_strideY * 4);
 	cbVoxelGrid->m_gridSize[0] = g_gridSizeX;
 	cbVoxelGrid->m_gridSize[1] = g_gridSizeY;
 	cbVoxelGrid->m_gridSize[2] = g_gridSizeZ;
@@ -807,7 +1163,7 @@ void VoxelizeViaRendering(ID3D11DeviceContext* pd3dImmediateContext) {
 	pd3dImmediateContext->VSSetShader(g_vsVoxelize, nullptr, 0);
 	pd3dImmediateContext->PSSetShader(g_voxelizationMethod == VOXELIZATION_SURFACE_PS ? g_psVoxelizeSurface : g_psVoxelizeSolid, nullptr, 0);
 
-	pd3dImmediateContext->DrawIndexed(g_numMeshIndices, 0, 0);
+	pd3dImmediateContext->DrawIndexed(g_numWindowTriangles * 3, 0, 0);
 
 	viewport.Width = float(DXUTGetDXGIBackBufferSurfaceDesc()->Width);
 	viewport.Height = float(DXUTGetDXGIBackBufferSurfaceDesc()->Height);
@@ -827,18 +1183,19 @@ void VoxelizeViaCompute(ID3D11DeviceContext* pd3dImmediateContext) {
 	CB_VoxelGrid* cbVoxelGrid = reinterpret_cast<CB_VoxelGrid*>(mappedBuf.pData);
 	XMStoreFloat4x4(&cbVoxelGrid->m_matModelToVoxel, XMLoadFloat4x4A(&g_matWorldToVoxel) * matModelToWorld);
 	cbVoxelGrid->m_stride[0] = g_strideX * 4;
-	cbVoxelGrid->m_stride[1] = g_strideY * 4;
+	cbVoxelGrid->m_stride[1] = UINT(g_strideY * 4);
 	cbVoxelGrid->m_gridSize[0] = g_gridSizeX;
 	cbVoxelGrid->m_gridSize[1] = g_gridSizeY;
 	cbVoxelGrid->m_gridSize[2] = g_gridSizeZ;
 	pd3dImmediateContext->Unmap(g_cbVoxelGrid, 0);
 
-	const UINT numTriangles = g_numMeshIndices / 3;
+	const UINT numTriangles = g_numWindowTriangles;
 
 	pd3dImmediateContext->Map(g_cbModelInput, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedBuf);
 	CB_ModelInput* cbModelInput = reinterpret_cast<CB_ModelInput*>(mappedBuf.pData);
 	cbModelInput->m_numModelTriangles = numTriangles;
 	cbModelInput->m_vertexFloatStride = g_bytesPerMeshVertex / sizeof(float);
+	cbModelInput->m_triangleSetupStride = 16 * (g_numMeshIndices / 3);
 	pd3dImmediateContext->Unmap(g_cbModelInput, 0);
 
 	ID3D11Buffer* constantBuffers[2] = {
@@ -850,16 +1207,55 @@ void VoxelizeViaCompute(ID3D11DeviceContext* pd3dImmediateContext) {
 
 	ID3D11ShaderResourceView* shaderResources[2] = {
 		g_srvVbMesh,
-		g_srvIbMesh,
+		GetWindowIndexBufferView(),
 	};
 
 	pd3dImmediateContext->CSSetShaderResources(0, 2, shaderResources);
 
 	pd3dImmediateContext->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 0, nullptr, nullptr);
+
+	// build triangle setup stream unless it is up to date
+	g_triangleSetupRebuilt = false;
+	if(g_useTriangleSetup && !(g_validTriangleSetup && memcmp(&g_matTriangleSetup, &g_matWorldToVoxel, sizeof(g_matWorldToVoxel)) == 0)) {
+		// reset triangle count
+		const UINT32 zero = 0;
+		D3D11_BOX box;
+		box.left = 0;
+		box.right = sizeof(zero);
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		pd3dImmediateContext->UpdateSubresource(g_bufTriangleSetup, 0, &box, &zero, 0, 0);
+
+		ID3D11UnorderedAccessView* uavsSetup[3] = { nullptr, nullptr, g_uavTriangleSetup };
+		pd3dImmediateContext->CSSetUnorderedAccessViews(0, 3, uavsSetup, nullptr);
+
+		pd3dImmediateContext->CSSetShader(g_csSetupTriangles, nullptr, 0);
+
+		const UINT numThreads = numTriangles;
+		const UINT threadsPerBlock = 256;
+
+		pd3dImmediateContext->Dispatch(256, (numThreads + (threadsPerBlock * 256 - 1)) / (threadsPerBlock * 256), 1);
+
+		ID3D11UnorderedAccessView* uavsSetupReset[3] = { nullptr, nullptr, nullptr };
+		pd3dImmediateContext->CSSetUnorderedAccessViews(0, 3, uavsSetupReset, nullptr);
+
+		g_matTriangleSetup = g_matWorldToVoxel;
+		g_validTriangleSetup = true;
+		g_triangleSetupRebuilt = true;
+	}
+
+	if(g_useTriangleSetup)
+		pd3dImmediateContext->CSSetShaderResources(3, 1, &g_srvTriangleSetup);
+
 	ID3D11UnorderedAccessView* uavs[2] = { nullptr, g_uavVoxelization };
 	pd3dImmediateContext->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
 
-	pd3dImmediateContext->CSSetShader(g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE ? g_csVoxelizeSolid : g_csVoxelizeSurfaceConservative, nullptr, 0);
+	if(g_useTriangleSetup)
+		pd3dImmediateContext->CSSetShader(g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE ? g_csVoxelizeSolidFromSetup : g_csVoxelizeSurfaceConservativeFromSetup, nullptr, 0);
+	else
+		pd3dImmediateContext->CSSetShader(g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE ? g_csVoxelizeSolid : g_csVoxelizeSurfaceConservative, nullptr, 0);
 
 	{
 		const UINT numThreads = numTriangles;
@@ -871,7 +1267,7 @@ void VoxelizeViaCompute(ID3D11DeviceContext* pd3dImmediateContext) {
 	if(g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE) {
 		pd3dImmediateContext->CSSetShader(g_csVoxelizeSolid_Propagate, nullptr, 0);
 
-		const UINT numThreads = g_strideY;
+		const UINT numThreads = UINT(g_strideY);
 		const UINT threadsPerBlock = 256;
 
 		pd3dImmediateContext->Dispatch(256, (numThreads + (threadsPerBlock * 256 - 1)) / (threadsPerBlock * 256), 1);
@@ -880,9 +1276,457 @@ void VoxelizeViaCompute(ID3D11DeviceContext* pd3dImmediateContext) {
 	ID3D11UnorderedAccessView* uavsReset[2] = { nullptr, nullptr };
 	pd3dImmediateContext->CSSetUnorderedAccessViews(0, 2, uavsReset, nullptr);
 
+	ID3D11ShaderResourceView* srvReset[1] = { nullptr };
+	pd3dImmediateContext->CSSetShaderResources(3, 1, srvReset);
+
 	g_validVoxelization = true;
 }
 
+// copies a grid in the layout of the voxelization buffer to the buffer, in chunks of whole y slices
+void UploadVoxelization(ID3D11DeviceContext* pd3dImmediateContext, const UINT32* voxels) {
+	PROFILE_SCOPE("Upload voxelization");
+
+	const UINT64 sliceBytes = g_strideY * 4;
+	const UINT64 slicesPerChunk = std::max<UINT64>(1, c_maxVoxelizationUploadBytes / sliceBytes);
+
+	for(UINT64 y = 0; y < g_gridSizeY; y += slicesPerChunk) {
+		const UINT64 numSlices = std::min<UINT64>(slicesPerChunk, g_gridSizeY - y);
+
+		D3D11_BOX box;
+		box.left = UINT(y * sliceBytes);
+		box.right = UINT((y + numSlices) * sliceBytes);
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		pd3dImmediateContext->UpdateSubresource(g_bufVoxelization, 0, &box, voxels + y * g_strideY, 0, 0);
+	}
+}
+
+// runs the CPU counterpart of the compute shader voxelization, adds the clearance margin and uploads the result; g_secsCpuVoxelization
+// covers voxelization, dilation and conversion to the 32-bit layout
+HRESULT VoxelizeViaCpu(ID3D11DeviceContext* pd3dImmediateContext) {
+	PROFILE_SCOPE("CPU voxelization");
+	HRESULT hr;
+
+	LARGE_INTEGER frequency, counter1, counter2;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter1);
+
+	XMFLOAT4X4 matModelToVoxel;
+	XMMATRIX matModelToWorld = XMMatrixIdentity();
+	XMStoreFloat4x4(&matModelToVoxel, XMLoadFloat4x4A(&g_matWorldToVoxel) * matModelToWorld);
+
+	CpuVoxelizationMesh mesh;
+	mesh.m_vertices = &g_cpuMeshVertices[0];
+	mesh.m_vertexFloatStride = g_bytesPerMeshVertex / sizeof(float);
+	mesh.m_indices = g_windowIndices.empty() ? &g_cpuMeshIndices[0] : &g_windowIndices[0];
+	mesh.m_numTriangles = g_numWindowTriangles;
+
+	try {
+		g_cpuVoxelUpload.resize(size_t(g_dataSize));
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	if(g_voxelizationMethod == VOXELIZATION_POINT_CLOUD_CPU) {
+		PointCloudFileFormat format;
+		format.m_headerSize = 0;
+		format.m_recordSize = 3 * sizeof(float);
+		format.m_positionOffset = 0;
+		std::fill(g_cpuVoxelUpload.begin(), g_cpuVoxelUpload.end(), 0u);
+		V_RETURN(VoxelizePointCloudFile(c_pointCloudFileName, format, &matModelToVoxel.m[0][0], GetVoxelGridLayout(), &g_cpuVoxelUpload[0], &g_numCloudPoints));
+	} else if(g_voxelizationMethod == VOXELIZATION_SURFACE_CONSERVATIVE_SPARSE_CPU) {
+		V_RETURN(g_sparseVoxelGrid.Voxelize(mesh, &matModelToVoxel.m[0][0], g_gridSizeX, g_gridSizeY, g_gridSizeZ));
+		V_RETURN(g_sparseVoxelGrid.CopyToDense(GetVoxelGridLayout(), &g_cpuVoxelUpload[0]));
+	} else {
+		const UINT* gridSize = g_cpuVoxelGrid.GetGridSize();
+		if(gridSize[0] != g_gridSizeX || gridSize[1] != g_gridSizeY || gridSize[2] != g_gridSizeZ)
+			V_RETURN(g_cpuVoxelGrid.Init(g_gridSizeX, g_gridSizeY, g_gridSizeZ));
+
+		CpuVoxelizationMethod method = CPU_VOXELIZATION_SURFACE_CONSERVATIVE;
+		if(g_voxelizationMethod == VOXELIZATION_SOLID_CPU)
+			method = CPU_VOXELIZATION_SOLID;
+		else if(g_voxelizationMethod == VOXELIZATION_SURFACE_CPU)
+			method = CPU_VOXELIZATION_SURFACE;
+		else if(g_voxelizationMethod == VOXELIZATION_SOLID_FLOOD_FILL_CPU)
+			method = CPU_VOXELIZATION_SOLID_FLOOD_FILL;
+		if(g_computeVoxelAttributes && (method == CPU_VOXELIZATION_SURFACE_CONSERVATIVE || method == CPU_VOXELIZATION_SURFACE))
+			V_RETURN(VoxelizeOnCpu(mesh, &matModelToVoxel.m[0][0], method, g_cpuVoxelGrid, nullptr, g_cpuVoxelAttributes));
+		else
+			V_RETURN(VoxelizeOnCpu(mesh, &matModelToVoxel.m[0][0], method, g_cpuVoxelGrid));
+		g_cpuVoxelGrid.CopyToGpuLayout(&g_cpuVoxelUpload[0]);
+	}
+
+	if(g_clearanceMargin > 0)
+		V_RETURN(ApplyVoxelMorphology(GetVoxelGridLayout(), &g_cpuVoxelUpload[0], VOXEL_MORPHOLOGY_DILATE, VOXEL_NEIGHBORHOOD_26, g_clearanceMargin));
+
+	QueryPerformanceCounter(&counter2);
+	g_secsCpuVoxelization = double(counter2.QuadPart - counter1.QuadPart) / double(frequency.QuadPart);
+
+	UploadVoxelization(pd3dImmediateContext, &g_cpuVoxelUpload[0]);
+
+	g_validVoxelization = true;
+	return S_OK;
+}
+
+// applies a morphological operator to the voxelization buffer; each dilation or erosion step reads the buffer and writes a temporary
+// one, which is then copied back
+HRESULT ApplyMorphologyViaCompute(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext, VoxelMorphologyOp op, VoxelNeighborhood neighborhood, UINT radius) {
+	HRESULT hr;
+
+	// create temporary buffer on first use
+	if(g_bufVoxelizationTemp == nullptr) {
+		D3D11_BUFFER_DESC bufDesc;
+		bufDesc.ByteWidth = UINT(g_dataSize * 4);
+		bufDesc.Usage = D3D11_USAGE_DEFAULT;
+		bufDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+		bufDesc.CPUAccessFlags = 0;
+		bufDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+		bufDesc.StructureByteStride = 0;
+		V_RETURN(pd3dDevice->CreateBuffer(&bufDesc, nullptr, &g_bufVoxelizationTemp));
+		DXUT_SetDebugName(g_bufVoxelizationTemp, "bufVoxelizationTemp");
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+		uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements = UINT(g_dataSize);
+		uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+		V_RETURN(pd3dDevice->CreateUnorderedAccessView(g_bufVoxelizationTemp, &uavDesc, &g_uavVoxelizationTemp));
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mappedBuf;
+	pd3dImmediateContext->Map(g_cbVoxelGrid, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedBuf);
+	CB_VoxelGrid* cbVoxelGrid = reinterpret_cast<CB_VoxelGrid*>(mappedBuf.pData);
+	cbVoxelGrid->m_stride[0] = g_strideX * 4;
+	cbVoxelGrid->m_stride[1] = UINT(g_strideY * 4);
+	cbVoxelGrid->m_gridSize[0] = g_gridSizeX;
+	cbVoxelGrid->m_gridSize[1] = g_gridSizeY;
+	cbVoxelGrid->m_gridSize[2] = g_gridSizeZ;
+	pd3dImmediateContext->Unmap(g_cbVoxelGrid, 0);
+
+	pd3dImmediateContext->CSSetConstantBuffers(0, 1, &g_cbVoxelGrid);
+	pd3dImmediateContext->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 0, nullptr, nullptr);
+
+	const UINT neighborhoodIndex = neighborhood == VOXEL_NEIGHBORHOOD_6 ? 0 : (neighborhood == VOXEL_NEIGHBORHOOD_18 ? 1 : 2);
+	for(UINT pass = 0; pass < 2; pass++) {
+		bool erode;
+		switch(op) {
+			case VOXEL_MORPHOLOGY_DILATE: erode = false; break;
+			case VOXEL_MORPHOLOGY_ERODE: erode = true; break;
+			case VOXEL_MORPHOLOGY_OPEN: erode = pass == 0; break;
+			default: erode = pass == 1; break;
+		}
+
+		pd3dImmediateContext->CSSetShader(g_csMorphology[erode ? 1 : 0][neighborhoodIndex], nullptr, 0);
+		for(UINT i = 0; i < radius; i++) {
+			ID3D11UnorderedAccessView* uavs[2] = { nullptr, g_uavVoxelizationTemp };
+			pd3dImmediateContext->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+			pd3dImmediateContext->CSSetShaderResources(2, 1, &g_srvVoxelization);
+
+			const UINT numThreads = UINT(g_dataSize);
+			const UINT threadsPerBlock = 256;
+
+			pd3dImmediateContext->Dispatch(256, (numThreads + (threadsPerBlock * 256 - 1)) / (threadsPerBlock * 256), 1);
+
+			ID3D11ShaderResourceView* srvReset = nullptr;
+			ID3D11UnorderedAccessView* uavsReset[2] = { nullptr, nullptr };
+			pd3dImmediateContext->CSSetShaderResources(2, 1, &srvReset);
+			pd3dImmediateContext->CSSetUnorderedAccessViews(0, 2, uavsReset, nullptr);
+
+			pd3dImmediateContext->CopyResource(g_bufVoxelization, g_bufVoxelizationTemp);
+		}
+
+		if(op == VOXEL_MORPHOLOGY_DILATE || op == VOXEL_MORPHOLOGY_ERODE)
+			break;
+	}
+
+	return S_OK;
+}
+
+VoxelGridLayout GetVoxelGridLayout() {
+	VoxelGridLayout layout;
+	layout.m_gridSize[0] = g_gridSizeX;
+	layout.m_gridSize[1] = g_gridSizeY;
+	layout.m_gridSize[2] = g_gridSizeZ;
+	layout.m_strideX = g_strideX;
+	layout.m_strideY = g_strideY;
+	layout.m_dataSize = g_dataSize;
+	return layout;
+}
+
+VoxelCacheKey DetermineVoxelizationCacheKey() {
+	// everything that enters the voxelization: mesh, method, and all parameters of SetupVoxelization and cbVoxelGrid
+	VoxelCacheKeyBuilder key;
+	key.Add(g_meshDigest);
+	key.Add(g_voxelizationMethod);
+	key.Add(g_useCubeVoxels);
+	key.Add(g_voxelWindow);
+	key.Add(g_useTriangleSetup);
+	key.Add(GetVoxelGridLayout());
+	key.Add(g_matWorldToVoxel);
+	key.Add(g_matWorldToVoxelProj);
+	key.Add(g_clearanceMargin);
+
+	// the point cloud is identified by the size and modification time of its file
+	if(g_voxelizationMethod == VOXELIZATION_POINT_CLOUD_CPU) {
+		WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+		GetFileAttributesExW(c_pointCloudFileName, GetFileExInfoStandard, &attributes);
+		key.Add(attributes.nFileSizeHigh);
+		key.Add(attributes.nFileSizeLow);
+		key.Add(attributes.ftLastWriteTime);
+	}
+	return key.Finalize();
+}
+
+bool VoxelizeViaCache(ID3D11DeviceContext* pd3dImmediateContext) {
+	std::shared_ptr<const CachedVoxelGrid> grid = g_voxelCache.Find(DetermineVoxelizationCacheKey());
+	if(!grid || grid->GetLayout() != GetVoxelGridLayout())
+		return false;
+
+	// upload directly from the mapped cache file
+	UploadVoxelization(pd3dImmediateContext, grid->GetData());
+
+	g_validVoxelization = true;
+	return true;
+}
+
+// copies the voxelization to the staging buffer and maps it for reading; the caller has to unmap g_bufVoxelizationReadback
+HRESULT MapVoxelizationReadback(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext, const UINT32** ppVoxels) {
+	HRESULT hr;
+
+	// create staging buffer for reading back the voxelization on first use
+	if(g_bufVoxelizationReadback == nullptr) {
+		D3D11_BUFFER_DESC bufDesc;
+		bufDesc.ByteWidth = UINT(g_dataSize * 4);
+		bufDesc.Usage = D3D11_USAGE_STAGING;
+		bufDesc.BindFlags = 0;
+		bufDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		bufDesc.MiscFlags = 0;
+		bufDesc.StructureByteStride = 0;
+		V_RETURN(pd3dDevice->CreateBuffer(&bufDesc, nullptr, &g_bufVoxelizationReadback));
+		DXUT_SetDebugName(g_bufVoxelizationReadback, "bufVoxelizationReadback");
+	}
+
+	pd3dImmediateContext->CopyResource(g_bufVoxelizationReadback, g_bufVoxelization);
+
+	D3D11_MAPPED_SUBRESOURCE mappedBuf;
+	V_RETURN(pd3dImmediateContext->Map(g_bufVoxelizationReadback, 0, D3D11_MAP_READ, 0, &mappedBuf));
+	*ppVoxels = reinterpret_cast<const UINT32*>(mappedBuf.pData);
+
+	return S_OK;
+}
+
+HRESULT StoreVoxelizationInCache(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext) {
+	HRESULT hr;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	hr = g_voxelCache.Insert(DetermineVoxelizationCacheKey(), GetVoxelGridLayout(), voxels);
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+
+	return hr;
+}
+
+HRESULT AnalyzeVoxelization(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext) {
+	PROFILE_SCOPE("Voxel analytics");
+	HRESULT hr;
+
+	if(!g_validVoxelization)
+		return E_FAIL;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	hr = ComputeVoxelAnalytics(GetVoxelGridLayout(), voxels, g_voxelAnalytics);
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+
+	return hr;
+}
+
+HRESULT StoreOverlapReference(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext) {
+	HRESULT hr;
+
+	if(!g_validVoxelization)
+		return E_FAIL;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	hr = S_OK;
+	try {
+		g_overlapReference.assign(voxels, voxels + g_dataSize);
+		g_overlapReferenceLayout = GetVoxelGridLayout();
+		g_overlapReferenceSpace[0] = g_voxelSpace[0];
+		g_overlapReferenceSpace[1] = g_voxelSpace[1];
+	} catch(const std::bad_alloc&) {
+		hr = E_OUTOFMEMORY;
+	}
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+
+	return hr;
+}
+
+// Determines the offset by which voxel (x, y, z) of the stored voxelization is aligned with voxel (x, y, z) + offset of the current
+// one from their voxel spaces; returns false if their voxel sizes differ or their voxels do not lie on the same lattice.
+bool DetermineOverlapReferenceOffset(int offset[3]) {
+	const UINT gridSize[3] = { g_gridSizeX, g_gridSizeY, g_gridSizeZ };
+	const float spaceMin[3] = { g_voxelSpace[0].x, g_voxelSpace[0].y, g_voxelSpace[0].z };
+	const float spaceMax[3] = { g_voxelSpace[1].x, g_voxelSpace[1].y, g_voxelSpace[1].z };
+	const float referenceMin[3] = { g_overlapReferenceSpace[0].x, g_overlapReferenceSpace[0].y, g_overlapReferenceSpace[0].z };
+	const float referenceMax[3] = { g_overlapReferenceSpace[1].x, g_overlapReferenceSpace[1].y, g_overlapReferenceSpace[1].z };
+
+	for(UINT a = 0; a < 3; a++) {
+		const float voxelSize = (spaceMax[a] - spaceMin[a]) / float(gridSize[a]);
+		const float referenceVoxelSize = (referenceMax[a] - referenceMin[a]) / float(g_overlapReferenceLayout.m_gridSize[a]);
+		if(fabsf(referenceVoxelSize - voxelSize) > 1e-4f * voxelSize)
+			return false;
+
+		const float voxelOffset = (referenceMin[a] - spaceMin[a]) / voxelSize;
+		offset[a] = int(floorf(voxelOffset + 0.5f));
+		if(fabsf(voxelOffset - float(offset[a])) > 1e-3f)
+			return false;
+	}
+	return true;
+}
+
+// tests the voxelization for overlap with the stored one, aligned by their voxel spaces; returns S_FALSE if their voxels are not
+// aligned, leaving g_voxelizationOverlaps false
+HRESULT TestVoxelizationOverlap(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext) {
+	PROFILE_SCOPE("Overlap test");
+	HRESULT hr;
+
+	g_voxelizationOverlaps = false;
+	if(!g_validVoxelization || g_overlapReference.empty())
+		return E_FAIL;
+
+	int offset[3];
+	if(!DetermineOverlapReferenceOffset(offset))
+		return S_FALSE;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	g_voxelizationOverlaps = DoVoxelGridsOverlap(GetVoxelGridLayout(), voxels, g_overlapReferenceLayout, &g_overlapReference[0], offset);
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+
+	return S_OK;
+}
+
+// combines the voxelization with the stored one, aligned by their voxel spaces, and uploads the result; returns S_FALSE if their
+// voxels are not aligned, leaving the voxelization unchanged
+HRESULT CombineVoxelizationWithReference(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext, VoxelCsgOp op) {
+	PROFILE_SCOPE("Voxel CSG");
+	HRESULT hr;
+
+	if(!g_validVoxelization || g_overlapReference.empty())
+		return E_FAIL;
+
+	int offset[3];
+	if(!DetermineOverlapReferenceOffset(offset))
+		return S_FALSE;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	hr = S_OK;
+	try {
+		g_cpuVoxelUpload.assign(voxels, voxels + g_dataSize);
+	} catch(const std::bad_alloc&) {
+		hr = E_OUTOFMEMORY;
+	}
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+	if(FAILED(hr))
+		return hr;
+
+	V_RETURN(ApplyVoxelCsg(op, GetVoxelGridLayout(), &g_cpuVoxelUpload[0], g_overlapReferenceLayout, &g_overlapReference[0], offset));
+	UploadVoxelization(pd3dImmediateContext, &g_cpuVoxelUpload[0]);
+
+	return S_OK;
+}
+
+HRESULT ExportVoxelizationMesh(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext, const WCHAR* fileName) {
+	PROFILE_SCOPE("Export mesh");
+	HRESULT hr;
+
+	if(!g_validVoxelization)
+		return E_FAIL;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	VoxelMesh mesh;
+	hr = ExtractVoxelMesh(GetVoxelGridLayout(), voxels, mesh);
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+	if(FAILED(hr))
+		return hr;
+
+	// voxel space to world space
+	const float scale[3] = {
+		(g_voxelSpace[1].x - g_voxelSpace[0].x) / float(g_gridSizeX),
+		(g_voxelSpace[1].y - g_voxelSpace[0].y) / float(g_gridSizeY),
+		(g_voxelSpace[1].z - g_voxelSpace[0].z) / float(g_gridSizeZ),
+	};
+	const float offset[3] = { g_voxelSpace[0].x, g_voxelSpace[0].y, g_voxelSpace[0].z };
+
+	return SaveVoxelMeshAsObj(mesh, fileName, scale, offset);
+}
+
+HRESULT ExportVoxelizationSlices(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext, const WCHAR* fileName) {
+	PROFILE_SCOPE("Export slices");
+	HRESULT hr;
+
+	if(!g_validVoxelization)
+		return E_FAIL;
+
+	FILE* file = nullptr;
+	if(_wfopen_s(&file, fileName, L"wb") != 0 || file == nullptr)
+		return E_FAIL;
+
+	const VoxelGridLayout layout = GetVoxelGridLayout();
+	const size_t sliceSize = size_t(MakeVoxelSliceLayout(layout).m_sliceStride * sizeof(UINT32));
+
+	const UINT32* voxels;
+	if(SUCCEEDED(hr = MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels))) {
+		hr = ForEachVoxelSlice(layout, voxels, [&](UINT, const UINT32* slice) {
+			return fwrite(slice, 1, sliceSize, file) == sliceSize ? S_OK : E_FAIL;
+		});
+		pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+	}
+
+	fclose(file);
+	return hr;
+}
+
+// Computes the distance field of the voxelization and writes it to fileName in the order of ComputeDistanceField. The voxelization
+// of the solid methods gives the sign and, through its boundary, the surface; that of the others is the surface of an unsigned field.
+HRESULT ExportDistanceField(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext, const WCHAR* fileName) {
+	PROFILE_SCOPE("Export distance field");
+	HRESULT hr;
+
+	if(!g_validVoxelization)
+		return E_FAIL;
+
+	const bool solid = g_voxelizationMethod == VOXELIZATION_SOLID_PS || g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE ||
+	                   g_voxelizationMethod == VOXELIZATION_SOLID_CPU || g_voxelizationMethod == VOXELIZATION_SOLID_FLOOD_FILL_CPU;
+
+	const UINT32* voxels;
+	V_RETURN(MapVoxelizationReadback(pd3dDevice, pd3dImmediateContext, &voxels));
+	std::vector<INT16> distances;
+	hr = ComputeDistanceField(GetVoxelGridLayout(), solid ? nullptr : voxels, solid ? voxels : nullptr, c_distanceFieldScale, distances);
+	pd3dImmediateContext->Unmap(g_bufVoxelizationReadback, 0);
+	if(FAILED(hr))
+		return hr;
+
+	const auto range = std::minmax_element(distances.begin(), distances.end());
+	g_distanceFieldRange[0] = float(*range.first) / c_distanceFieldScale;
+	g_distanceFieldRange[1] = float(*range.second) / c_distanceFieldScale;
+
+	FILE* file = nullptr;
+	if(_wfopen_s(&file, fileName, L"wb") != 0 || file == nullptr)
+		return E_FAIL;
+
+	hr = fwrite(&distances[0], sizeof(INT16), distances.size(), file) == distances.size() ? S_OK : E_FAIL;
+	fclose(file);
+	return hr;
+}
+
 //--------------------------------------------------------------------------------------------------------------------------------------------------------------
 
 void RenderModel(ID3D11DeviceContext* pd3dImmediateContext) {
@@ -922,6 +1766,63 @@ void RenderModel(ID3D11DeviceContext* pd3dImmediateContext) {
 	pd3dImmediateContext->DrawIndexed(g_numMeshIndices, 0, 0);
 }
 
+// transformation of the texture coordinates of the screen quad to the world-space points at view-space depth 1 that they cover
+XMMATRIX DetermineQuadToWorld() {
+	return XMMatrixInverse(nullptr, XMLoadFloat4x4A(&g_matView))
+		* XMMatrixMultiplyTranspose(
+			XMMatrixTranslation(-0.5f, -0.5f, -1.0f),
+			XMMatrixScaling(2.0f / g_matProj(0, 0), -2.0f / g_matProj(1, 1), 1.0f));
+}
+
+// camera position in the demo's right-handed world space
+XMVECTOR GetCameraPos() {
+	XMFLOAT3 cameraPos;
+	XMStoreFloat3(&cameraPos, g_camera.GetEyePt());
+	cameraPos.z = -cameraPos.z;
+	return XMLoadFloat3(&cameraPos);
+}
+
+// intersects the ray from the camera through the cursor with the model via g_meshRaycaster, which is built for the current voxel grid
+// on first use; returns S_OK on a hit and S_FALSE on a miss
+HRESULT CastCursorRay() {
+	PROFILE_SCOPE("Cursor ray");
+	HRESULT hr;
+
+	if(!g_validMeshRaycaster) {
+		CpuVoxelizationMesh mesh;
+		mesh.m_vertices = &g_cpuMeshVertices[0];
+		mesh.m_vertexFloatStride = g_bytesPerMeshVertex / sizeof(float);
+		mesh.m_indices = &g_cpuMeshIndices[0];
+		mesh.m_numTriangles = g_numMeshIndices / 3;
+		V_RETURN(g_meshRaycaster.Build(mesh, &g_matWorldToVoxel.m[0][0], g_gridSizeX, g_gridSizeY, g_gridSizeZ));
+		g_validMeshRaycaster = true;
+	}
+
+	POINT cursor;
+	if(!GetCursorPos(&cursor) || !ScreenToClient(DXUTGetHWND(), &cursor))
+		return E_FAIL;
+
+	// world-space ray through the cursor's pixel, transformed to voxel space, where it has the same parameter
+	const XMVECTOR texcoord = XMVectorSet(
+		(float(cursor.x) + 0.5f) / float(DXUTGetDXGIBackBufferSurfaceDesc()->Width),
+		(float(cursor.y) + 0.5f) / float(DXUTGetDXGIBackBufferSurfaceDesc()->Height), 0.0f, 1.0f);
+	const XMVECTOR origin = GetCameraPos();
+	const XMVECTOR direction = XMVector3TransformCoord(texcoord, XMMatrixTranspose(DetermineQuadToWorld())) - origin;
+
+	const XMMATRIX matWorldToVoxel = XMMatrixTranspose(XMLoadFloat4x4A(&g_matWorldToVoxel));
+	XMFLOAT3 voxOrigin;
+	XMFLOAT3 voxDirection;
+	XMStoreFloat3(&voxOrigin, XMVector3TransformCoord(origin, matWorldToVoxel));
+	XMStoreFloat3(&voxDirection, XMVector3TransformNormal(direction, matWorldToVoxel));
+
+	float t;
+	if(!g_meshRaycaster.IntersectRay(&voxOrigin.x, &voxDirection.x, FLT_MAX, t, g_cursorHitTriangle))
+		return S_FALSE;
+
+	XMStoreFloat3(&g_cursorHitPos, origin + t * direction);
+	return S_OK;
+}
+
 void RenderVoxelizationViaRaycasting(ID3D11DeviceContext* pd3dImmediateContext) {
 	if(!g_validVoxelization)
 		return;
@@ -936,13 +1837,7 @@ void RenderVoxelizationViaRaycasting(ID3D11DeviceContext* pd3dImmediateContext)
 	XMMATRIX matView = XMLoadFloat4x4A(&g_matView);
 	XMMATRIX matProj = XMLoadFloat4x4A(&g_matProj);
 
-	XMMATRIX matQuadToWorld
-		= XMMatrixInverse(nullptr, matView)
-		* XMMatrixMultiplyTranspose(
-			XMMatrixTranslation(-0.5f, -0.5f, -1.0f),
-			XMMatrixScaling(2.0f / g_matProj(0, 0), -2.0f / g_matProj(1, 1), 1.0f));
-
-	XMMATRIX matQuadToVoxel = matWorldToVoxel * matQuadToWorld;
+	XMMATRIX matQuadToVoxel = matWorldToVoxel * DetermineQuadToWorld();
 
 	XMMATRIX matVoxelToScreen
 		= XMMatrixMultiplyTranspose(
@@ -950,11 +1845,8 @@ void RenderVoxelizationViaRaycasting(ID3D11DeviceContext* pd3dImmediateContext)
 			XMMatrixScaling(float(DXUTGetDXGIBackBufferSurfaceDesc()->Width) * 0.5f, float(DXUTGetDXGIBackBufferSurfaceDesc()->Height) * 0.5f, 1.0f))
 		* matProj * matView * XMMatrixInverse(nullptr, matWorldToVoxel);
 
-	XMFLOAT3 cameraPos;
-	XMStoreFloat3(&cameraPos, g_camera.GetEyePt());
-	cameraPos.z = -cameraPos.z;
 	XMFLOAT3 rayOrigin;
-	XMStoreFloat3(&rayOrigin, XMVector3TransformCoord(XMLoadFloat3(&cameraPos), XMMatrixTranspose(matWorldToVoxel)));
+	XMStoreFloat3(&rayOrigin, XMVector3TransformCoord(GetCameraPos(), XMMatrixTranspose(matWorldToVoxel)));
 	XMFLOAT3 voxLightPos;
 	XMStoreFloat3(&voxLightPos, XMVector3TransformCoord(XMLoadFloat3(&g_wLightPos), XMMatrixTranspose(matWorldToVoxel)));
 
@@ -966,7 +1858,7 @@ void RenderVoxelizationViaRaycasting(ID3D11DeviceContext* pd3dImmediateContext)
 	cbRaycasting->m_rayOrigin = rayOrigin;
 	cbRaycasting->m_voxLightPos = voxLightPos;
 	cbRaycasting->m_stride[0] = g_strideX;
-	cbRaycasting->m_stride[1] = g_strideY;
+	cbRaycasting->m_stride[1] = UINT(g_strideY);
 	cbRaycasting->m_gridSize[0] = g_gridSizeX;
 	cbRaycasting->m_gridSize[1] = g_gridSizeY;
 	cbRaycasting->m_gridSize[2] = g_gridSizeZ;
@@ -1013,19 +1905,124 @@ void RenderText() {
 			case VOXELIZATION_SURFACE_CONSERVATIVE_COMPUTE:
 				methodName = "Conservative surface (compute)";
 				break;
+			case VOXELIZATION_SOLID_CPU:
+				methodName = "Solid (CPU)";
+				break;
+			case VOXELIZATION_SURFACE_CONSERVATIVE_CPU:
+				methodName = "Conservative surface (CPU)";
+				break;
+			case VOXELIZATION_SURFACE_CONSERVATIVE_SPARSE_CPU:
+				methodName = "Conservative surface (sparse, CPU)";
+				break;
+			case VOXELIZATION_SURFACE_CPU:
+				methodName = "Surface (CPU)";
+				break;
+			case VOXELIZATION_POINT_CLOUD_CPU:
+				methodName = "Point cloud (CPU)";
+				break;
+			case VOXELIZATION_SOLID_FLOOD_FILL_CPU:
+				methodName = "Solid by flood fill (CPU)";
+				break;
 		}
 		g_textHelper->DrawFormattedTextLine(L"Method: %S", methodName);
 
 		if(g_secsVoxelization > 0.0) {
 			g_textHelper->DrawFormattedTextLine(L"Time: %0.2f ms", g_secsVoxelization * 1000.0);
 		}
+
+		if(!g_voxelizationFromCache && g_voxelizationMethod >= VOXELIZATION_SOLID_CPU)
+			g_textHelper->DrawFormattedTextLine(L"CPU time: %0.2f ms (%d threads)", g_secsCpuVoxelization * 1000.0, GetWorkerThreadCount());
+
+		if(!g_voxelizationFromCache && g_voxelizationMethod == VOXELIZATION_POINT_CLOUD_CPU)
+			g_textHelper->DrawFormattedTextLine(L"Points: %llu (%s)", g_numCloudPoints, c_pointCloudFileName);
+
+		if(!g_voxelizationFromCache && g_voxelizationMethod == VOXELIZATION_SURFACE_CONSERVATIVE_SPARSE_CPU)
+			g_textHelper->DrawFormattedTextLine(L"Bricks: %d (%0.2f MiB)", UINT(g_sparseVoxelGrid.GetBricks().size()), g_sparseVoxelGrid.GetMemoryUsage() / 1048576.0);
+
+		if(g_computeVoxelAttributes && !g_voxelizationFromCache && (g_voxelizationMethod == VOXELIZATION_SURFACE_CONSERVATIVE_CPU || g_voxelizationMethod == VOXELIZATION_SURFACE_CPU))
+			g_textHelper->DrawFormattedTextLine(L"Normals: %d voxels (%0.2f MiB)", UINT(g_cpuVoxelAttributes.m_normals.size()),
+				(g_cpuVoxelAttributes.m_wordRanks.size() + g_cpuVoxelAttributes.m_normals.size()) * sizeof(UINT32) / 1048576.0);
+
+		if(g_useTriangleSetup && !g_voxelizationFromCache && (g_voxelizationMethod == VOXELIZATION_SOLID_COMPUTE || g_voxelizationMethod == VOXELIZATION_SURFACE_CONSERVATIVE_COMPUTE))
+			g_textHelper->DrawFormattedTextLine(L"Triangle setup: %s", g_triangleSetupRebuilt ? L"rebuilt" : L"reused");
+
+		if(IsModelCroppedByVoxelWindow())
+			g_textHelper->DrawFormattedTextLine(L"Window: %s, %d of %d triangles", c_voxelWindowPresets[g_voxelWindowPreset].m_name, g_numWindowTriangles, g_numMeshIndices / 3);
+
+		if(g_useVoxelCache)
+			g_textHelper->DrawFormattedTextLine(L"Cache: %s", g_voxelizationFromCache ? L"hit" : L"miss");
+
+		if(g_clearanceMargin > 0)
+			g_textHelper->DrawFormattedTextLine(L"Clearance margin: %d", g_clearanceMargin);
+
+		if(!g_overlapReference.empty() && g_hrOverlapTest != E_PENDING) {
+			if(g_hrOverlapTest == S_OK)
+				g_textHelper->DrawFormattedTextLine(L"Overlap with stored voxelization: %s", g_voxelizationOverlaps ? L"yes" : L"no");
+			else
+				g_textHelper->DrawFormattedTextLine(L"Overlap with stored voxelization: %s", g_hrOverlapTest == S_FALSE ? L"skipped, voxels not aligned" : L"failed");
+		}
+
+		if(!g_overlapReference.empty() && g_voxelCsgMode > 0 && g_hrVoxelCsg != E_PENDING) {
+			const WCHAR* opName = c_voxelCsgOpNames[g_voxelCsgMode - 1];
+			if(g_hrVoxelCsg == S_OK)
+				g_textHelper->DrawFormattedTextLine(L"Combined with stored voxelization: %s", opName);
+			else
+				g_textHelper->DrawFormattedTextLine(L"Combined with stored voxelization: %s %s", opName, g_hrVoxelCsg == S_FALSE ? L"skipped, voxels not aligned" : L"failed");
+		}
+
+		if(g_showVoxelAnalytics && SUCCEEDED(g_hrVoxelAnalytics)) {
+			const VoxelAnalytics& analytics = g_voxelAnalytics;
+			g_textHelper->DrawFormattedTextLine(L"Volume: %llu voxels, surface area: %llu faces", analytics.m_volume, analytics.m_surfaceArea);
+			g_textHelper->DrawFormattedTextLine(L"Center of mass: %0.1f, %0.1f, %0.1f", analytics.m_centerOfMass[0], analytics.m_centerOfMass[1], analytics.m_centerOfMass[2]);
+			g_textHelper->DrawFormattedTextLine(L"Inertia: xx %0.3g, yy %0.3g, zz %0.3g, xy %0.3g, xz %0.3g, yz %0.3g",
+				analytics.m_inertiaTensor[0][0], analytics.m_inertiaTensor[1][1], analytics.m_inertiaTensor[2][2],
+				analytics.m_inertiaTensor[0][1], analytics.m_inertiaTensor[0][2], analytics.m_inertiaTensor[1][2]);
+		}
+	}
+
+	if(g_hrVoxelizationMeshExport != S_FALSE)
+		g_textHelper->DrawFormattedTextLine(L"Mesh export: %s", SUCCEEDED(g_hrVoxelizationMeshExport) ? L"voxelization.obj written" : L"failed");
+
+	if(g_hrVoxelizationSliceExport != S_FALSE)
+		g_textHelper->DrawFormattedTextLine(L"Slice export: %s", SUCCEEDED(g_hrVoxelizationSliceExport) ? L"slices.bin written" : L"failed");
+
+	if(g_showCursorHit) {
+		if(g_hrCursorHit == S_OK)
+			g_textHelper->DrawFormattedTextLine(L"Cursor hit: triangle %u at %0.3f, %0.3f, %0.3f", g_cursorHitTriangle, g_cursorHitPos.x, g_cursorHitPos.y, g_cursorHitPos.z);
+		else
+			g_textHelper->DrawFormattedTextLine(L"Cursor hit: %s", SUCCEEDED(g_hrCursorHit) ? L"none" : L"failed");
 	}
 
-	g_textHelper->SetInsertionPos(5, DXUTGetDXGIBackBufferSurfaceDesc()->Height - 65);
+	if(g_hrDistanceFieldExport != S_FALSE) {
+		if(SUCCEEDED(g_hrDistanceFieldExport))
+			g_textHelper->DrawFormattedTextLine(L"Distance field export: distances.bin written, %0.2f to %0.2f voxels", g_distanceFieldRange[0], g_distanceFieldRange[1]);
+		else
+			g_textHelper->DrawTextLine(L"Distance field export: failed");
+	}
+
+	if(g_profilingEnabled)
+		g_textHelper->DrawTextLine(L"Profiling: on");
+	else if(g_hrProfileTrace != S_FALSE)
+		g_textHelper->DrawFormattedTextLine(L"Profiling: off, %s", SUCCEEDED(g_hrProfileTrace) ? L"profile.json written" : L"writing trace failed");
+
+	g_textHelper->SetInsertionPos(5, DXUTGetDXGIBackBufferSurfaceDesc()->Height - 290);
 	g_textHelper->SetForegroundColor(XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f));
 	g_textHelper->DrawTextLine(L"SPACE - Turn voxelization on/off");
 	g_textHelper->DrawTextLine(L"TAB - Display model or voxelization");
-	g_textHelper->DrawTextLine(L"1/2/3/4 - Select voxelization method");
+	g_textHelper->DrawTextLine(L"0-9 - Select voxelization method");
+	g_textHelper->DrawTextLine(L"C - Toggle caching of voxelization results");
+	g_textHelper->DrawTextLine(L"M - Change clearance margin");
+	g_textHelper->DrawTextLine(L"W - Change voxel window");
+	g_textHelper->DrawTextLine(L"T - Toggle triangle setup stream (compute)");
+	g_textHelper->DrawTextLine(L"N - Toggle per-voxel normals (CPU surface)");
+	g_textHelper->DrawTextLine(L"I - Toggle volume, center of mass and inertia");
+	g_textHelper->DrawTextLine(L"O - Store voxelization for overlap test / clear");
+	g_textHelper->DrawTextLine(L"U - Combine with stored voxelization (CSG)");
+	g_textHelper->DrawTextLine(L"E - Export voxelization as mesh");
+	g_textHelper->DrawTextLine(L"Z - Export voxelization as z-slices");
+	g_textHelper->DrawTextLine(L"F - Export distance field of voxelization");
+	g_textHelper->DrawTextLine(L"H - Toggle exact model hit under cursor");
+	g_textHelper->DrawTextLine(L"P - Toggle profiling, writing trace");
 
 	g_textHelper->End();
 }
@@ -1043,7 +2040,10 @@ void CALLBACK OnFrameRender(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dI
 	if(g_voxelize) {
 		pd3dImmediateContext->Begin(g_qryTimestampDisjoint);
 		pd3dImmediateContext->End(g_qryTimestamp1);
-		switch(g_voxelizationMethod) {
+		g_voxelizationFromCache = g_useVoxelCache && VoxelizeViaCache(pd3dImmediateContext);
+		if(!g_voxelizationFromCache)
+			CullTrianglesToVoxelWindow(pd3dImmediateContext);
+		if(!g_voxelizationFromCache) switch(g_voxelizationMethod) {
 			case VOXELIZATION_SOLID_PS:
 			case VOXELIZATION_SURFACE_PS:
 				VoxelizeViaRendering(pd3dImmediateContext);
@@ -1052,9 +2052,62 @@ void CALLBACK OnFrameRender(ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dI
 			case VOXELIZATION_SURFACE_CONSERVATIVE_COMPUTE:
 				VoxelizeViaCompute(pd3dImmediateContext);
 				break;
+			case VOXELIZATION_SOLID_CPU:
+			case VOXELIZATION_SURFACE_CONSERVATIVE_CPU:
+			case VOXELIZATION_SURFACE_CONSERVATIVE_SPARSE_CPU:
+			case VOXELIZATION_SURFACE_CPU:
+			case VOXELIZATION_POINT_CLOUD_CPU:
+			case VOXELIZATION_SOLID_FLOOD_FILL_CPU:
+				VoxelizeViaCpu(pd3dImmediateContext);
+				break;
 		}
+		// the CPU methods dilate before uploading
+		if(!g_voxelizationFromCache && g_clearanceMargin > 0 && g_voxelizationMethod < VOXELIZATION_SOLID_CPU)
+			ApplyMorphologyViaCompute(pd3dDevice, pd3dImmediateContext, VOXEL_MORPHOLOGY_DILATE, VOXEL_NEIGHBORHOOD_26, g_clearanceMargin);
 		pd3dImmediateContext->End(g_qryTimestamp2);
 		pd3dImmediateContext->End(g_qryTimestampDisjoint);
+
+		if(g_useVoxelCache && !g_voxelizationFromCache)
+			StoreVoxelizationInCache(pd3dDevice, pd3dImmediateContext);
+
+		if(!g_overlapReference.empty())
+			g_hrOverlapTest = TestVoxelizationOverlap(pd3dDevice, pd3dImmediateContext);
+
+		// the cache keeps the voxelization itself, and the analytics are of the combined one
+		if(!g_overlapReference.empty() && g_voxelCsgMode > 0)
+			g_hrVoxelCsg = CombineVoxelizationWithReference(pd3dDevice, pd3dImmediateContext, c_voxelCsgOps[g_voxelCsgMode - 1]);
+
+		if(g_showVoxelAnalytics)
+			g_hrVoxelAnalytics = AnalyzeVoxelization(pd3dDevice, pd3dImmediateContext);
+	}
+
+	if(g_exportVoxelizationMesh) {
+		g_hrVoxelizationMeshExport = ExportVoxelizationMesh(pd3dDevice, pd3dImmediateContext, L"voxelization.obj");
+		g_exportVoxelizationMesh = false;
+	}
+
+	if(g_toggleOverlapReference) {
+		if(g_overlapReference.empty())
+			StoreOverlapReference(pd3dDevice, pd3dImmediateContext);
+		else
+			std::vector<UINT32>().swap(g_overlapReference);
+		g_voxelizationOverlaps = false;
+		g_hrOverlapTest = E_PENDING;
+		g_hrVoxelCsg = E_PENDING;
+		g_toggleOverlapReference = false;
+	}
+
+	if(g_exportVoxelizationSlices) {
+		g_hrVoxelizationSliceExport = ExportVoxelizationSlices(pd3dDevice, pd3dImmediateContext, L"slices.bin");
+		g_exportVoxelizationSlices = false;
+	}
+
+	if(g_showCursorHit)
+		g_hrCursorHit = CastCursorRay();
+
+	if(g_exportDistanceField) {
+		g_hrDistanceFieldExport = ExportDistanceField(pd3dDevice, pd3dImmediateContext, L"distances.bin");
+		g_exportDistanceField = false;
 	}
 
 	// render scene
@@ -1146,9 +2199,92 @@ void CALLBACK OnKeyboard(UINT nChar, bool bKeyDown, bool bAltDown, void* pUserCo
 			g_voxelizationMethod = VOXELIZATION_SOLID_COMPUTE;
 			break;
 
+		case '5':
+			g_voxelizationMethod = VOXELIZATION_SURFACE_CONSERVATIVE_CPU;
+			break;
+
+		case '6':
+			g_voxelizationMethod = VOXELIZATION_SOLID_CPU;
+			break;
+
+		case '7':
+			g_voxelizationMethod = VOXELIZATION_SURFACE_CONSERVATIVE_SPARSE_CPU;
+			break;
+
+		case '8':
+			g_voxelizationMethod = VOXELIZATION_SURFACE_CPU;
+			break;
+
+		case '9':
+			g_voxelizationMethod = VOXELIZATION_POINT_CLOUD_CPU;
+			break;
+
+		case '0':
+			g_voxelizationMethod = VOXELIZATION_SOLID_FLOOD_FILL_CPU;
+			break;
+
 		case 'L':
 			g_showVoxelBorderLines = !g_showVoxelBorderLines;
 			break;
+
+		case 'C':
+			g_useVoxelCache = !g_useVoxelCache;
+			break;
+
+		case 'M':
+			g_clearanceMargin = (g_clearanceMargin + 1) % (c_maxClearanceMargin + 1);
+			break;
+
+		case 'I':
+			g_showVoxelAnalytics = !g_showVoxelAnalytics;
+			break;
+
+		case 'O':
+			g_toggleOverlapReference = true;
+			break;
+
+		case 'U':
+			g_voxelCsgMode = (g_voxelCsgMode + 1) % (ARRAYSIZE(c_voxelCsgOps) + 1);
+			g_hrVoxelCsg = E_PENDING;
+			break;
+
+		case 'E':
+			g_exportVoxelizationMesh = true;
+			break;
+
+		case 'Z':
+			g_exportVoxelizationSlices = true;
+			break;
+
+		case 'F':
+			g_exportDistanceField = true;
+			break;
+
+		case 'H':
+			g_showCursorHit = !g_showCursorHit;
+			break;
+
+		case 'T':
+			g_useTriangleSetup = !g_useTriangleSetup;
+			break;
+
+		case 'N':
+			g_computeVoxelAttributes = !g_computeVoxelAttributes;
+			break;
+
+		case 'P':
+			if(g_profilingEnabled) {
+				StopProfiling();
+				g_hrProfileTrace = WriteProfileTrace(L"profile.json");
+			} else {
+				StartProfiling();
+			}
+			break;
+
+		case 'W':
+			SetVoxelWindowPreset((g_voxelWindowPreset + 1) % ARRAYSIZE(c_voxelWindowPresets));
+			SetupVoxelization();
+			break;
 	}
 }
 
@@ -0,0 +1,262 @@
+//==============================================================================================================================================================
+// Exact Euclidean distance fields computed from binary voxelizations
+//==============================================================================================================================================================
+
+#include "DistanceField.h"
+#include "Parallel.h"
+#include "BitOps.h"
+#include <cmath>
+#include <limits>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	const UINT32 c_infinity = 0xffffffffu;
+	const UINT c_noVoxel = 0xffffffffu;
+
+	// number of neighboring lines processed together in the x and y passes so that each gathered cache line is fully used
+	const UINT c_lineBlock = 16;
+
+	// Lower envelope of the parabolas (q - i)^2 + f(i) over all i with finite f(i), evaluated at q = 0..n-1 (Felzenszwalb and
+	// Huttenlocher). The line is given as c_lineBlock interleaved lines; only line 'lane' is transformed.
+	class DistanceTransform1D {
+	public:
+		explicit DistanceTransform1D(UINT n) : m_v(n), m_z(n + 1), m_f(n) {}
+
+		void Transform(UINT32* line, UINT n, UINT lane) {
+			// build lower envelope
+			int k = -1;
+			for(UINT q = 0; q < n; q++) {
+				const UINT32 fq = line[q * c_lineBlock + lane];
+				if(fq == c_infinity)
+					continue;
+
+				double s = -std::numeric_limits<double>::infinity();
+				while(k >= 0) {
+					const UINT vk = m_v[k];
+					s = ((double(fq) + double(q) * double(q)) - (double(m_f[k]) + double(vk) * double(vk))) / (2.0 * (double(q) - double(vk)));
+					if(s > m_z[k])
+						break;
+					k--;
+				}
+				if(k < 0)
+					s = -std::numeric_limits<double>::infinity();
+
+				k++;
+				m_v[k] = q;
+				m_f[k] = fq;
+				m_z[k] = s;
+			}
+
+			// no finite input: line stays at infinity
+			if(k < 0)
+				return;
+
+			m_z[k + 1] = std::numeric_limits<double>::infinity();
+
+			// evaluate envelope
+			int j = 0;
+			for(UINT q = 0; q < n; q++) {
+				while(m_z[j + 1] < double(q))
+					j++;
+				const UINT64 dq = UINT64(int(q) - int(m_v[j]) < 0 ? m_v[j] - q : q - m_v[j]);
+				const UINT64 d = dq * dq + m_f[j];
+				line[q * c_lineBlock + lane] = d >= c_infinity ? c_infinity - 1 : UINT32(d);
+			}
+		}
+
+	private:
+		std::vector<UINT> m_v;
+		std::vector<double> m_z;
+		std::vector<UINT32> m_f;
+	};
+
+	// Writes the squared distances along z of the voxels strictly between zLow and zHigh, which are consecutive surface voxels of a
+	// column, and 0 for the one at zHigh; zLow is c_noVoxel before the column's first surface voxel and zHigh after its last one.
+	void FillColumnGap(UINT32* out, UINT zLow, UINT zHigh, UINT sizeZ) {
+		if(zLow == c_noVoxel && zHigh == c_noVoxel) {
+			std::fill(out, out + sizeZ, c_infinity);
+		} else if(zLow == c_noVoxel) {
+			for(UINT z = 0; z < zHigh; z++)
+				out[z] = (zHigh - z) * (zHigh - z);
+		} else if(zHigh == c_noVoxel) {
+			for(UINT z = zLow + 1; z < sizeZ; z++)
+				out[z] = (z - zLow) * (z - zLow);
+		} else {
+			// voxels up to the middle are closer to zLow
+			const UINT zMid = zLow + (zHigh - zLow) / 2;
+			for(UINT z = zLow + 1; z <= zMid; z++)
+				out[z] = (z - zLow) * (z - zLow);
+			for(UINT z = zMid + 1; z < zHigh; z++)
+				out[z] = (zHigh - z) * (zHigh - z);
+		}
+
+		if(zHigh != c_noVoxel)
+			out[zHigh] = 0;
+	}
+
+	// marks solid voxels with at least one 6-neighbor outside of the solid (or outside of the grid)
+	void DetermineSolidBoundary(const VoxelGridLayout& layout, const UINT32* solid, std::vector<UINT32>& boundary) {
+		boundary.assign(size_t(layout.m_dataSize), 0u);
+
+		const UINT sizeX = layout.m_gridSize[0];
+		const UINT sizeY = layout.m_gridSize[1];
+		const UINT numWords = layout.m_strideX;
+		const UINT lastBits = layout.m_gridSize[2] & 31;
+		const UINT32 lastMask = lastBits ? (1u << lastBits) - 1 : ~0u;
+
+		ParallelFor(0, sizeY, 1, [&](UINT64 yBegin, UINT64 yEnd) {
+			for(UINT y = UINT(yBegin); y < UINT(yEnd); y++) {
+				for(UINT x = 0; x < sizeX; x++) {
+					const UINT64 base = GetVoxelWordIndex(layout, x, y, 0);
+					for(UINT w = 0; w < numWords; w++) {
+						// bits beyond the grid's z extent may be set by the solid voxelization and must be ignored
+						const UINT32 c = w + 1 < numWords ? solid[base + w] : solid[base + w] & lastMask;
+						if(c == 0)
+							continue;
+
+						const UINT32 prev = w > 0 ? solid[base + w - 1] : 0u;
+						const UINT32 next = w + 1 < numWords ? solid[base + w + 1] : 0u;
+
+						UINT32 interior = c;
+						interior &= (c << 1) | (prev >> 31);
+						interior &= (c >> 1) | (next << 31);
+						interior &= x > 0 ? solid[base - layout.m_strideX + w] : 0u;
+						interior &= x + 1 < sizeX ? solid[base + layout.m_strideX + w] : 0u;
+						interior &= y > 0 ? solid[base - layout.m_strideY + w] : 0u;
+						interior &= y + 1 < sizeY ? solid[base + layout.m_strideY + w] : 0u;
+
+						boundary[base + w] = c & ~interior;
+					}
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	HRESULT ComputeDistanceFieldImpl(const VoxelGridLayout& layout, const UINT32* surfaceVoxels, const UINT32* solidVoxels, float scale, std::vector<T>& distances) {
+		if(surfaceVoxels == nullptr && solidVoxels == nullptr)
+			return E_INVALIDARG;
+
+		const UINT sizeX = layout.m_gridSize[0];
+		const UINT sizeY = layout.m_gridSize[1];
+		const UINT sizeZ = layout.m_gridSize[2];
+		const UINT64 numVoxels = UINT64(sizeX) * sizeY * sizeZ;
+		const UINT64 sliceSize = UINT64(sizeX) * sizeZ;
+
+		std::vector<UINT32> boundary;
+		if(surfaceVoxels == nullptr) {
+			DetermineSolidBoundary(layout, solidVoxels, boundary);
+			surfaceVoxels = boundary.data();
+		}
+
+		std::vector<UINT32> squaredDistances;
+		try {
+			squaredDistances.resize(numVoxels);
+			distances.resize(numVoxels);
+		} catch(const std::bad_alloc&) {
+			return E_OUTOFMEMORY;
+		}
+
+		UINT32* sqDist = squaredDistances.data();
+
+		//---- pass 1: distance along z, filling the gaps between the surface voxels found by scanning the packed columns ----
+		const UINT numWords = (sizeZ + 31) >> 5;
+		const UINT lastBits = sizeZ & 31;
+		const UINT32 lastMask = lastBits ? (1u << lastBits) - 1 : ~0u;
+
+		ParallelFor(0, sizeY, 1, [&](UINT64 yBegin, UINT64 yEnd) {
+			for(UINT y = UINT(yBegin); y < UINT(yEnd); y++) {
+				for(UINT x = 0; x < sizeX; x++) {
+					const UINT32* column = surfaceVoxels + GetVoxelWordIndex(layout, x, y, 0);
+					UINT32* out = sqDist + y * sliceSize + UINT64(x) * sizeZ;
+
+					UINT zPrev = c_noVoxel;
+					for(UINT w = 0; w < numWords; w++) {
+						// bits beyond the grid's z extent are ignored, as in DetermineSolidBoundary
+						UINT32 bits = w + 1 < numWords ? column[w] : column[w] & lastMask;
+						while(bits != 0) {
+							const UINT z = (w << 5) + LowestSetBit(bits);
+							bits &= bits - 1;
+							FillColumnGap(out, zPrev, z, sizeZ);
+							zPrev = z;
+						}
+					}
+					FillColumnGap(out, zPrev, c_noVoxel, sizeZ);
+				}
+			}
+		});
+
+		//---- pass 2: lines along x, processed in blocks of neighboring z ----
+		ParallelFor(0, sizeY, 1, [&](UINT64 yBegin, UINT64 yEnd) {
+			DistanceTransform1D transform(sizeX);
+			std::vector<UINT32> lines(UINT64(sizeX) * c_lineBlock);
+
+			for(UINT y = UINT(yBegin); y < UINT(yEnd); y++) {
+				UINT32* slice = sqDist + y * sliceSize;
+				for(UINT z0 = 0; z0 < sizeZ; z0 += c_lineBlock) {
+					const UINT count = std::min(c_lineBlock, sizeZ - z0);
+
+					for(UINT x = 0; x < sizeX; x++)
+						for(UINT i = 0; i < count; i++)
+							lines[x * c_lineBlock + i] = slice[UINT64(x) * sizeZ + z0 + i];
+
+					for(UINT i = 0; i < count; i++)
+						transform.Transform(lines.data(), sizeX, i);
+
+					for(UINT x = 0; x < sizeX; x++)
+						for(UINT i = 0; i < count; i++)
+							slice[UINT64(x) * sizeZ + z0 + i] = lines[x * c_lineBlock + i];
+				}
+			}
+		});
+
+		//---- pass 3: lines along y, followed by sign determination and quantization ----
+		const double maxValue = double(std::numeric_limits<T>::max());
+		const double quantizationScale = double(scale);
+
+		ParallelFor(0, sizeX, 1, [&](UINT64 xBegin, UINT64 xEnd) {
+			DistanceTransform1D transform(sizeY);
+			std::vector<UINT32> lines(UINT64(sizeY) * c_lineBlock);
+
+			for(UINT x = UINT(xBegin); x < UINT(xEnd); x++) {
+				for(UINT z0 = 0; z0 < sizeZ; z0 += c_lineBlock) {
+					const UINT count = std::min(c_lineBlock, sizeZ - z0);
+					const UINT64 offset = UINT64(x) * sizeZ + z0;
+
+					for(UINT y = 0; y < sizeY; y++)
+						for(UINT i = 0; i < count; i++)
+							lines[y * c_lineBlock + i] = sqDist[y * sliceSize + offset + i];
+
+					for(UINT i = 0; i < count; i++)
+						transform.Transform(lines.data(), sizeY, i);
+
+					for(UINT y = 0; y < sizeY; y++) {
+						const UINT32 solidWord = solidVoxels ? solidVoxels[GetVoxelWordIndex(layout, x, y, z0 >> 5)] : 0u;
+						for(UINT i = 0; i < count; i++) {
+							const UINT32 d2 = lines[y * c_lineBlock + i];
+							double value = d2 == c_infinity ? maxValue : std::min(maxValue, std::floor(std::sqrt(double(d2)) * quantizationScale + 0.5));
+							if(solidWord & (1u << ((z0 + i) & 31)))
+								value = -value;
+							distances[y * sliceSize + offset + i] = T(value);
+						}
+					}
+				}
+			}
+		});
+
+		return S_OK;
+	}
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT ComputeDistanceField(const VoxelGridLayout& layout, const UINT32* surfaceVoxels, const UINT32* solidVoxels, float scale, std::vector<INT8>& distances) {
+	return ComputeDistanceFieldImpl(layout, surfaceVoxels, solidVoxels, scale, distances);
+}
+
+HRESULT ComputeDistanceField(const VoxelGridLayout& layout, const UINT32* surfaceVoxels, const UINT32* solidVoxels, float scale, std::vector<INT16>& distances) {
+	return ComputeDistanceFieldImpl(layout, surfaceVoxels, solidVoxels, scale, distances);
+}
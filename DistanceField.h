@@ -0,0 +1,21 @@
+//==============================================================================================================================================================
+// Exact Euclidean distance fields computed from binary voxelizations
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+#include <vector>
+
+//==============================================================================================================================================================
+
+// Computes, for every voxel, the exact Euclidean distance between its center and the center of the closest surface voxel, using a
+// separable three-pass transform (Felzenszwalb/Meijster) along z, x and y. Distances are negative for voxels in the interior of
+// the solid voxelization and are stored as round(distance * scale), clamped to the range of the output type. Voxels without any
+// surface voxel in the grid receive the maximum value. The output is ordered like the voxel grid: z fastest, then x, then y.
+//
+// surfaceVoxels is a surface voxelization such as produced by CS_VoxelizeSurfaceConservative; if it is nullptr, the boundary voxels
+// of solidVoxels are used instead. solidVoxels is a solid voxelization (CS_VoxelizeSolid) providing the sign; if it is nullptr, an
+// unsigned distance field is computed. At least one of the two grids must be given.
+HRESULT ComputeDistanceField(const VoxelGridLayout& layout, const UINT32* surfaceVoxels, const UINT32* solidVoxels, float scale, std::vector<INT8>& distances);
+HRESULT ComputeDistanceField(const VoxelGridLayout& layout, const UINT32* surfaceVoxels, const UINT32* solidVoxels, float scale, std::vector<INT16>& distances);
@@ -0,0 +1,132 @@
+//==============================================================================================================================================================
+// C++ stand-ins for the HLSL types and intrinsics used by the code shared with the shaders
+//==============================================================================================================================================================
+
+#pragma once
+
+#include <Windows.h>
+#include <intrin.h>
+#include <cmath>
+
+//==============================================================================================================================================================
+
+// Only what VoxelizationCommon.hlsli needs: vector types with componentwise arithmetic, the intrinsics it calls, and byte address and
+// typed buffers over CPU memory. Everything lives in namespace hlsl so that names such as min or float3 do not leak into the rest of
+// the C++ code.
+namespace hlsl {
+
+	typedef unsigned int uint;
+
+	struct uint2 {
+		uint x, y;
+		uint2() {}
+		uint2(uint x_, uint y_) : x(x_), y(y_) {}
+	};
+
+	struct uint3 {
+		uint x, y, z;
+		uint3() {}
+		uint3(uint x_, uint y_, uint z_) : x(x_), y(y_), z(z_) {}
+	};
+
+	struct int2 {
+		int x, y;
+		int2() {}
+		int2(int x_, int y_) : x(x_), y(y_) {}
+	};
+
+	struct int3 {
+		int x, y, z;
+		int3() {}
+		int3(int x_, int y_, int z_) : x(x_), y(y_), z(z_) {}
+	};
+
+	struct float2 {
+		float x, y;
+		float2() {}
+		float2(float x_, float y_) : x(x_), y(y_) {}
+	};
+
+	struct float3 {
+		float x, y, z;
+		float3() {}
+		float3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+		explicit float3(const uint3& v) : x(float(v.x)), y(float(v.y)), z(float(v.z)) {}
+	};
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	inline float3 operator-(const float3& a) { return float3(-a.x, -a.y, -a.z); }
+	inline float3 operator+(const float3& a, const float3& b) { return float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	inline float3 operator-(const float3& a, const float3& b) { return float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float3 operator*(const float3& a, const float3& b) { return float3(a.x * b.x, a.y * b.y, a.z * b.z); }
+	inline float3 operator/(const float3& a, const float3& b) { return float3(a.x / b.x, a.y / b.y, a.z / b.z); }
+	inline float3 operator-(float a, const float3& b) { return float3(a - b.x, a - b.y, a - b.z); }
+	inline float3 operator*(float a, const float3& b) { return float3(a * b.x, a * b.y, a * b.z); }
+	inline float3 operator*(const float3& a, float b) { return float3(a.x * b, a.y * b, a.z * b); }
+	inline float3 operator/(float a, const float3& b) { return float3(a / b.x, a / b.y, a / b.z); }
+
+	// the argument order of std::min and std::max, so that NaNs propagate the same way
+	inline float min(float a, float b) { return b < a ? b : a; }
+	inline float max(float a, float b) { return a < b ? b : a; }
+	inline int min(int a, int b) { return b < a ? b : a; }
+	inline int max(int a, int b) { return a < b ? b : a; }
+	inline uint min(uint a, uint b) { return b < a ? b : a; }
+	inline uint max(uint a, uint b) { return a < b ? b : a; }
+	inline float3 min(const float3& a, const float3& b) { return float3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z)); }
+	inline float3 max(const float3& a, const float3& b) { return float3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z)); }
+
+	inline float abs(float a) { return fabsf(a); }
+	inline float3 abs(const float3& a) { return float3(fabsf(a.x), fabsf(a.y), fabsf(a.z)); }
+	inline float floor(float a) { return floorf(a); }
+	inline float frac(float a) { return a - floorf(a); }
+	inline float exp2(float a) { return exp2f(a); }
+
+	inline float dot(const float2& a, const float2& b) { return a.x * b.x + a.y * b.y; }
+	inline float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline float3 cross(const float3& a, const float3& b) { return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+	inline float3 normalize(const float3& a) { return (1.0f / sqrtf(dot(a, a))) * a; }
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// RWByteAddressBuffer over CPU memory; addresses are in bytes and 64-bit, and the atomic operations act on aligned 32-bit words,
+	// which also serves grids of 64-bit words since those store the same bits at the same addresses
+	class RWByteAddressBuffer {
+	public:
+		explicit RWByteAddressBuffer(void* data) : m_data(static_cast<UINT8*>(data)) {}
+
+		uint Load(UINT64 address) const {
+			return *reinterpret_cast<const uint*>(m_data + address);
+		}
+
+		void Store(UINT64 address, uint value) const {
+			*reinterpret_cast<uint*>(m_data + address) = value;
+		}
+
+		void InterlockedOr(UINT64 address, uint value) const {
+			_InterlockedOr(reinterpret_cast<volatile long*>(m_data + address), long(value));
+		}
+
+		void InterlockedXor(UINT64 address, uint value) const {
+			_InterlockedXor(reinterpret_cast<volatile long*>(m_data + address), long(value));
+		}
+
+	private:
+		UINT8* m_data;
+	};
+
+	// read-only Buffer<T> over CPU memory, indexed in elements
+	template<typename T>
+	class Buffer {
+	public:
+		explicit Buffer(const T* data) : m_data(data) {}
+
+		T operator[](UINT64 index) const {
+			return m_data[index];
+		}
+
+	private:
+		const T* m_data;
+	};
+
+}
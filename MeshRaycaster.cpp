@@ -0,0 +1,150 @@
+//==============================================================================================================================================================
+// Exact ray casting against triangle meshes, accelerated by a conservative surface voxelization
+//==============================================================================================================================================================
+
+#include "MeshRaycaster.h"
+#include "VoxelizationCommon.hlsli"
+#include <algorithm>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	inline void Subtract(const float* a, const float* b, float r[3]) {
+		r[0] = a[0] - b[0];
+		r[1] = a[1] - b[1];
+		r[2] = a[2] - b[2];
+	}
+
+	inline void Cross(const float a[3], const float b[3], float r[3]) {
+		r[0] = a[1] * b[2] - a[2] * b[1];
+		r[1] = a[2] * b[0] - a[0] * b[2];
+		r[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	inline float Dot(const float a[3], const float b[3]) {
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT MeshRaycaster::Build(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ) {
+	Clear();
+
+	HRESULT hr;
+	if(FAILED(hr = m_grid.Init(gridSizeX, gridSizeY, gridSizeZ)))
+		return hr;
+	if(FAILED(hr = VoxelizeSurfaceConservativeOnCpu(mesh, matModelToVoxel, m_grid, m_lists))) {
+		Clear();
+		return hr;
+	}
+
+	try {
+		m_vertices.resize(UINT64(mesh.m_numTriangles) * 9);
+	} catch(const std::bad_alloc&) {
+		Clear();
+		return E_OUTOFMEMORY;
+	}
+
+	// transform the vertices as the voxelizer does
+	const float* m = matModelToVoxel;
+	for(UINT64 i = 0; i < UINT64(mesh.m_numTriangles) * 3; i++) {
+		const float* p = mesh.m_vertices + UINT64(mesh.m_indices[i]) * mesh.m_vertexFloatStride;
+		const float w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+		m_vertices[i * 3 + 0] = (m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3]) / w;
+		m_vertices[i * 3 + 1] = (m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7]) / w;
+		m_vertices[i * 3 + 2] = (m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11]) / w;
+	}
+
+	return S_OK;
+}
+
+void MeshRaycaster::Clear() {
+	m_grid = VoxelGrid64();
+	m_lists.m_wordRanks.clear();
+	m_lists.m_cellOffsets.clear();
+	m_lists.m_cellTriangles.clear();
+	m_vertices.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+UINT MeshRaycaster::GetVoxelTriangles(UINT x, UINT y, UINT z, const UINT32*& triangles) const {
+	const UINT* gridSize = m_grid.GetGridSize();
+	if(x >= gridSize[0] || y >= gridSize[1] || z >= gridSize[2] || !m_grid.IsSet(x, y, z)) {
+		triangles = nullptr;
+		return 0;
+	}
+
+	const UINT32 cell = m_lists.GetCell(m_grid, x, y, z);
+	triangles = m_lists.m_cellTriangles.data() + m_lists.m_cellOffsets[cell];
+	return m_lists.m_cellOffsets[cell + 1] - m_lists.m_cellOffsets[cell];
+}
+
+// Moeller and Trumbore
+bool MeshRaycaster::IntersectTriangle(UINT32 tri, const float origin[3], const float direction[3], float tMin, float tMax, float& t) const {
+	const float* v0 = &m_vertices[UINT64(tri) * 9];
+	float e1[3], e2[3], p[3], s[3], q[3];
+	Subtract(v0 + 3, v0, e1);
+	Subtract(v0 + 6, v0, e2);
+
+	Cross(direction, e2, p);
+	const float det = Dot(e1, p);
+	if(det == 0.0f)
+		return false;
+	const float invDet = 1.0f / det;
+
+	Subtract(origin, v0, s);
+	const float u = Dot(s, p) * invDet;
+	if(u < 0.0f || u > 1.0f)
+		return false;
+
+	Cross(s, e1, q);
+	const float v = Dot(direction, q) * invDet;
+	if(v < 0.0f || u + v > 1.0f)
+		return false;
+
+	t = Dot(e2, q) * invDet;
+	return t >= tMin && t <= tMax;
+}
+
+bool MeshRaycaster::IntersectRay(const float origin[3], const float direction[3], float tMax, float& tHit, UINT32& triangle) const {
+	const UINT* gridSize = m_grid.GetGridSize();
+	if(m_grid.GetDataSize() == 0)
+		return false;
+
+	// traverse the voxels as CastVoxelRay does, clipped to the grid
+	hlsl::VoxelRayTraversal ray;
+	if(!hlsl::BeginVoxelRayTraversal(hlsl::float3(origin[0], origin[1], origin[2]), hlsl::float3(direction[0], direction[1], direction[2]),
+		hlsl::uint3(gridSize[0], gridSize[1], gridSize[2]), tMax, ray))
+	{
+		return false;
+	}
+
+	bool hit = false;
+	tHit = ray.tExit;
+	const int maxSteps = int(gridSize[0] + gridSize[1] + gridSize[2]) + 1;
+	for(int step = 0; step < maxSteps; step++) {
+		// voxels outside of the grid list no triangles
+		const UINT32* triangles;
+		const UINT count = GetVoxelTriangles(UINT(ray.cell.x), UINT(ray.cell.y), UINT(ray.cell.z), triangles);
+		for(UINT i = 0; i < count; i++) {
+			// parts of the triangle outside of the grid are not considered
+			float t;
+			if(IntersectTriangle(triangles[i], origin, direction, ray.tEnter, tHit, t) && (!hit || t < tHit || (t == tHit && triangles[i] < triangle))) {
+				tHit = t;
+				triangle = triangles[i];
+				hit = true;
+			}
+		}
+
+		// hits of later voxels lie beyond this one
+		const float tExit = ray.t0 + std::min(ray.tMax.x, std::min(ray.tMax.y, ray.tMax.z));
+		if((hit && tHit <= tExit) || !hlsl::StepVoxelRayTraversal(ray))
+			break;
+	}
+
+	return hit;
+}
@@ -0,0 +1,39 @@
+//==============================================================================================================================================================
+// Exact ray casting against triangle meshes, accelerated by a conservative surface voxelization
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "CpuVoxelizer.h"
+
+//==============================================================================================================================================================
+
+// Uniform grid over a mesh whose cells are exactly the voxels set by VoxelizeOnCpu with CPU_VOXELIZATION_SURFACE_CONSERVATIVE, which
+// are those of CS_VoxelizeSurfaceConservative, each listing the triangles that overlap it. Rays are given in voxel space, i.e. after
+// transformation by matModelToVoxel, and traverse the voxels they pierce in order, with the traversal CastVoxelRay uses; only the
+// triangles of set voxels are intersected, and traversal stops at the first voxel containing a hit. Since the voxelization is
+// conservative, every intersection with the mesh inside of the grid lies in a voxel listing the triangle, so the result is the same as
+// that of testing all triangles. A MeshRaycaster copies the triangles' vertices, so the mesh may be released after Build; casting rays
+// does not modify it and may happen from several threads simultaneously.
+class MeshRaycaster {
+public:
+	HRESULT Build(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ);
+	void Clear();
+
+	const VoxelGrid64& GetGrid() const { return m_grid; }
+	const CpuVoxelTriangleLists& GetTriangleLists() const { return m_lists; }
+
+	// number of triangles overlapping voxel (x, y, z) and pointer to their indices; 0 for voxels that are not set
+	UINT GetVoxelTriangles(UINT x, UINT y, UINT z, const UINT32*& triangles) const;
+
+	// Intersects the ray origin + t * direction, t in [0, tMax], with the part of the mesh inside of the grid; on a hit, returns the
+	// smallest t and the index of the triangle hit.
+	bool IntersectRay(const float origin[3], const float direction[3], float tMax, float& tHit, UINT32& triangle) const;
+
+private:
+	bool IntersectTriangle(UINT32 tri, const float origin[3], const float direction[3], float tMin, float tMax, float& t) const;
+
+	VoxelGrid64 m_grid;
+	CpuVoxelTriangleLists m_lists;
+	std::vector<float> m_vertices;		// voxel-space positions of the triangles' corners, 9 floats per triangle
+};
@@ -0,0 +1,143 @@
+//==============================================================================================================================================================
+// Simple fork-join parallelism for the CPU-side voxel processing
+//==============================================================================================================================================================
+
+#pragma once
+
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//==============================================================================================================================================================
+
+inline UINT GetWorkerThreadCount() {
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls func(chunkBegin, chunkEnd) for consecutive chunks of at most grainSize elements covering [begin, end). Chunks are handed out
+// dynamically to the calling thread and up to GetWorkerThreadCount() - 1 helper threads; the call returns once all chunks are done.
+template<typename Func>
+void ParallelFor(UINT64 begin, UINT64 end, UINT64 grainSize, const Func& func) {
+	if(begin >= end)
+		return;
+
+	grainSize = std::max<UINT64>(grainSize, 1);
+	const UINT64 numChunks = (end - begin + grainSize - 1) / grainSize;
+	const UINT numThreads = UINT(std::min<UINT64>(GetWorkerThreadCount(), numChunks));
+
+	if(numThreads <= 1) {
+		func(begin, end);
+		return;
+	}
+
+	std::atomic<UINT64> nextChunk(0);
+	auto worker = [&]() {
+		for(UINT64 chunk; (chunk = nextChunk.fetch_add(1)) < numChunks; ) {
+			const UINT64 chunkBegin = begin + chunk * grainSize;
+			func(chunkBegin, std::min(chunkBegin + grainSize, end));
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for(UINT i = 1; i < numThreads; i++)
+		threads.emplace_back(worker);
+	worker();
+	for(auto& thread : threads)
+		thread.join();
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// NUMA node with processors; m_affinity.Mask is 0 for the single pseudo node of machines (or processes) without NUMA information, in
+// which case threads are not pinned.
+struct NumaNode {
+	USHORT m_nodeNumber;
+	GROUP_AFFINITY m_affinity;
+	UINT m_numProcessors;
+};
+
+inline std::vector<NumaNode> QueryNumaNodes() {
+	std::vector<NumaNode> nodes;
+	ULONG highestNode = 0;
+	if(GetNumaHighestNodeNumber(&highestNode)) {
+		for(ULONG n = 0; n <= highestNode; n++) {
+			NumaNode node = {};
+			node.m_nodeNumber = USHORT(n);
+			if(!GetNumaNodeProcessorMaskEx(node.m_nodeNumber, &node.m_affinity) || node.m_affinity.Mask == 0)
+				continue;
+			for(KAFFINITY mask = node.m_affinity.Mask; mask != 0; mask &= mask - 1)
+				node.m_numProcessors++;
+			nodes.push_back(node);
+		}
+	}
+
+	if(nodes.size() <= 1) {
+		NumaNode node = {};
+		node.m_numProcessors = GetWorkerThreadCount();
+		nodes.assign(1, node);
+	}
+	return nodes;
+}
+
+// NUMA nodes, queried once; node indices elsewhere refer to this array
+inline const std::vector<NumaNode>& GetNumaNodes() {
+	static const std::vector<NumaNode> nodes = QueryNumaNodes();
+	return nodes;
+}
+
+// Like ParallelFor, but [nodeBegins[0], nodeBegins[numNodes]) is split into a range per node of GetNumaNodes(), whose chunks are
+// processed by threads pinned to the node: func(node, chunkBegin, chunkEnd) is called by threads of node, and, with shareWork, by
+// those of other nodes once their own ranges are exhausted. The calling thread takes part as a thread of node 0, pinned for the
+// duration of the call.
+template<typename Func>
+void ParallelForNuma(const UINT64* nodeBegins, UINT64 grainSize, const Func& func, bool shareWork = true) {
+	const std::vector<NumaNode>& nodes = GetNumaNodes();
+	const UINT numNodes = UINT(nodes.size());
+	if(nodeBegins[0] >= nodeBegins[numNodes])
+		return;
+
+	grainSize = std::max<UINT64>(grainSize, 1);
+	if(numNodes == 1) {
+		ParallelFor(nodeBegins[0], nodeBegins[1], grainSize, [&](UINT64 begin, UINT64 end) { func(0, begin, end); });
+		return;
+	}
+
+	std::vector<std::atomic<UINT64>> nextChunks(numNodes);
+	for(UINT n = 0; n < numNodes; n++)
+		nextChunks[n] = 0;
+
+	auto worker = [&](UINT home) {
+		for(UINT i = 0; i < (shareWork ? numNodes : 1); i++) {
+			const UINT node = (home + i) % numNodes;
+			const UINT64 numChunks = (nodeBegins[node + 1] - nodeBegins[node] + grainSize - 1) / grainSize;
+			for(UINT64 chunk; (chunk = nextChunks[node].fetch_add(1)) < numChunks; ) {
+				const UINT64 chunkBegin = nodeBegins[node] + chunk * grainSize;
+				func(node, chunkBegin, std::min(chunkBegin + grainSize, nodeBegins[node + 1]));
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(UINT n = 0; n < numNodes; n++) {
+		const UINT64 numChunks = (nodeBegins[n + 1] - nodeBegins[n] + grainSize - 1) / grainSize;
+		const UINT numThreads = UINT(std::min<UINT64>(nodes[n].m_numProcessors, numChunks));
+		for(UINT i = (n == 0) ? 1 : 0; i < numThreads; i++) {
+			threads.emplace_back([&, n]() {
+				SetThreadGroupAffinity(GetCurrentThread(), &nodes[n].m_affinity, nullptr);
+				worker(n);
+			});
+		}
+	}
+
+	GROUP_AFFINITY previous;
+	const BOOL pinned = SetThreadGroupAffinity(GetCurrentThread(), &nodes[0].m_affinity, &previous);
+	worker(0);
+	if(pinned)
+		SetThreadGroupAffinity(GetCurrentThread(), &previous, nullptr);
+
+	for(auto& thread : threads)
+		thread.join();
+}
@@ -0,0 +1,264 @@
+//==============================================================================================================================================================
+// Streaming voxelization of point clouds into packed voxel grids
+//==============================================================================================================================================================
+
+#include "PointCloudVoxelizer.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include <intrin.h>
+#include <cmath>
+#include <cstring>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// points sorted at once by a worker; the keys of a batch and the radix sort's second buffer stay in the worker's cache
+	const UINT64 c_batchPoints = 1 << 16;
+
+	// points read from a file at once
+	const UINT64 c_chunkPoints = 1 << 22;
+
+	const UINT c_radixBits = 11;
+
+	inline void AtomicOr(UINT32* address, UINT32 voxels) {
+		_InterlockedOr(reinterpret_cast<volatile long*>(address), long(voxels));
+	}
+
+	// Voxelizes points with buffers for the batches of all workers, which are allocated once and reused for the chunks of a file.
+	// The batches are sorted by keys word * 32 + bit, so that sorting by the bits above the lowest 5 brings the pairs of each word
+	// together.
+	class PointBatcher {
+	public:
+		PointBatcher(const float matWorldToVoxel[16], const VoxelGridLayout& layout, UINT32* voxels);
+
+		HRESULT Init(UINT64 maxPointsPerCall);
+		void Voxelize(const UINT8* points, UINT64 count, UINT recordSize);
+
+	private:
+		void VoxelizeBatch(const UINT8* points, UINT64 count, UINT recordSize, UINT64* keys, UINT64* temp) const;
+		const UINT64* SortKeys(UINT64* keys, UINT64* temp, UINT64 count) const;
+
+		const float* m_matWorldToVoxel;
+		VoxelGridLayout m_layout;
+		UINT32* m_voxels;
+		UINT m_addressBits;
+		UINT m_numWorkers;
+		UINT64 m_batchPoints;
+		std::vector<UINT64> m_buffers;
+	};
+
+	PointBatcher::PointBatcher(const float matWorldToVoxel[16], const VoxelGridLayout& layout, UINT32* voxels)
+		: m_matWorldToVoxel(matWorldToVoxel), m_layout(layout), m_voxels(voxels), m_addressBits(1), m_numWorkers(1), m_batchPoints(0)
+	{
+		while((1ull << m_addressBits) < layout.m_dataSize)
+			m_addressBits++;
+	}
+
+	HRESULT PointBatcher::Init(UINT64 maxPointsPerCall) {
+		m_batchPoints = std::max<UINT64>(1, std::min(c_batchPoints, maxPointsPerCall));
+		m_numWorkers = UINT(std::min<UINT64>(GetWorkerThreadCount(), (maxPointsPerCall + m_batchPoints - 1) / m_batchPoints));
+		m_numWorkers = std::max(m_numWorkers, 1u);
+
+		try {
+			m_buffers.resize(size_t(2 * m_batchPoints * m_numWorkers));
+		} catch(const std::bad_alloc&) {
+			return E_OUTOFMEMORY;
+		}
+		return S_OK;
+	}
+
+	void PointBatcher::Voxelize(const UINT8* points, UINT64 count, UINT recordSize) {
+		ParallelFor(0, m_numWorkers, 1, [&](UINT64 workerBegin, UINT64 workerEnd) {
+			for(UINT64 worker = workerBegin; worker < workerEnd; worker++) {
+				UINT64* keys = &m_buffers[size_t(2 * m_batchPoints * worker)];
+				UINT64* temp = keys + m_batchPoints;
+
+				const UINT64 begin = worker * count / m_numWorkers;
+				const UINT64 end = (worker + 1) * count / m_numWorkers;
+				for(UINT64 i = begin; i < end; i += m_batchPoints)
+					VoxelizeBatch(points + i * recordSize, std::min(m_batchPoints, end - i), recordSize, keys, temp);
+			}
+		});
+	}
+
+	void PointBatcher::VoxelizeBatch(const UINT8* points, UINT64 count, UINT recordSize, UINT64* keys, UINT64* temp) const {
+		PROFILE_SCOPE("Point batch");
+
+		const float* m = m_matWorldToVoxel;
+		const float sizeX = float(m_layout.m_gridSize[0]);
+		const float sizeY = float(m_layout.m_gridSize[1]);
+		const float sizeZ = float(m_layout.m_gridSize[2]);
+
+		// transform points and determine their voxels
+		UINT64 numKeys = 0;
+		for(UINT64 i = 0; i < count; i++) {
+			float p[3];
+			memcpy(p, points + i * recordSize, sizeof(p));
+
+			const float w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+			const float x = (m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3]) / w;
+			const float y = (m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7]) / w;
+			const float z = (m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11]) / w;
+
+			// also rejects NaNs
+			if(!(x >= 0.0f && x < sizeX && y >= 0.0f && y < sizeY && z >= 0.0f && z < sizeZ))
+				continue;
+
+			const UINT voxZ = UINT(z);
+			keys[numKeys++] = (GetVoxelWordIndex(m_layout, UINT(x), UINT(y), voxZ >> 5) << 5) | (voxZ & 31);
+		}
+		if(numKeys == 0)
+			return;
+
+		// merge the bits of each word and set them, skipping words whose bits are all set already
+		const UINT64* sorted = SortKeys(keys, temp, numKeys);
+		UINT64 word = sorted[0] >> 5;
+		UINT32 bits = 0;
+		for(UINT64 i = 0; i <= numKeys; i++) {
+			if(i == numKeys || (sorted[i] >> 5) != word) {
+				const UINT32 current = *reinterpret_cast<volatile const UINT32*>(m_voxels + word);
+				if((current & bits) != bits)
+					AtomicOr(m_voxels + word, bits);
+				if(i == numKeys)
+					break;
+				word = sorted[i] >> 5;
+				bits = 0;
+			}
+			bits |= 1u << (sorted[i] & 31);
+		}
+	}
+
+	// LSD radix sort by the word address in bits [5, 5 + m_addressBits) of the keys; returns keys or temp, whichever holds the result
+	const UINT64* PointBatcher::SortKeys(UINT64* keys, UINT64* temp, UINT64 count) const {
+		const UINT64 mask = (1ull << c_radixBits) - 1;
+		UINT64* src = keys;
+		UINT64* dst = temp;
+
+		for(UINT shift = 5; shift < 5 + m_addressBits; shift += c_radixBits) {
+			UINT32 offsets[1 << c_radixBits] = {};
+			for(UINT64 i = 0; i < count; i++)
+				offsets[(src[i] >> shift) & mask]++;
+
+			UINT32 sum = 0;
+			for(UINT i = 0; i <= mask; i++) {
+				const UINT32 n = offsets[i];
+				offsets[i] = sum;
+				sum += n;
+			}
+
+			for(UINT64 i = 0; i < count; i++)
+				dst[offsets[(src[i] >> shift) & mask]++] = src[i];
+			std::swap(src, dst);
+		}
+		return src;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// reads up to maxBytes, stopping early only at the end of the file
+	HRESULT ReadFileFully(HANDLE file, UINT8* buffer, UINT64 maxBytes, UINT64& bytesRead) {
+		bytesRead = 0;
+		while(bytesRead < maxBytes) {
+			DWORD n = 0;
+			if(!ReadFile(file, buffer + bytesRead, DWORD(std::min<UINT64>(maxBytes - bytesRead, 1u << 30)), &n, nullptr))
+				return HRESULT_FROM_WIN32(GetLastError());
+			if(n == 0)
+				break;
+			bytesRead += n;
+		}
+		return S_OK;
+	}
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT VoxelizePoints(const void* points, UINT64 count, UINT recordSize, const float matWorldToVoxel[16], const VoxelGridLayout& layout, UINT32* voxels) {
+	if(recordSize < 3 * sizeof(float) || matWorldToVoxel == nullptr || (count > 0 && points == nullptr))
+		return E_INVALIDARG;
+	if(count == 0 || layout.m_dataSize == 0)
+		return S_OK;
+	if(voxels == nullptr)
+		return E_INVALIDARG;
+
+	HRESULT hr;
+	PointBatcher batcher(matWorldToVoxel, layout, voxels);
+	if(FAILED(hr = batcher.Init(count)))
+		return hr;
+
+	batcher.Voxelize(static_cast<const UINT8*>(points), count, recordSize);
+	return S_OK;
+}
+
+HRESULT VoxelizePointCloudFile(const WCHAR* fileName, const PointCloudFileFormat& format, const float matWorldToVoxel[16], const VoxelGridLayout& layout, UINT32* voxels, UINT64* numPoints) {
+	if(numPoints != nullptr)
+		*numPoints = 0;
+	if(fileName == nullptr || matWorldToVoxel == nullptr || format.m_recordSize < format.m_positionOffset + 3 * sizeof(float) || format.m_positionOffset > format.m_recordSize)
+		return E_INVALIDARG;
+	if(voxels == nullptr && layout.m_dataSize != 0)
+		return E_INVALIDARG;
+
+	HRESULT hr;
+	PointBatcher batcher(matWorldToVoxel, layout, voxels);
+	std::vector<UINT8> buffers[2];
+	try {
+		buffers[0].resize(size_t(c_chunkPoints * format.m_recordSize));
+		buffers[1].resize(size_t(c_chunkPoints * format.m_recordSize));
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+	if(FAILED(hr = batcher.Init(c_chunkPoints)))
+		return hr;
+
+	HANDLE file = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	LARGE_INTEGER headerSize;
+	headerSize.QuadPart = LONGLONG(format.m_headerSize);
+	if(!SetFilePointerEx(file, headerSize, nullptr, FILE_BEGIN)) {
+		hr = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(file);
+		return hr;
+	}
+
+	// double buffering: a helper thread reads the next chunk into one buffer while the other one is voxelized
+	UINT64 bytes = 0;
+	if(FAILED(hr = ReadFileFully(file, buffers[0].data(), buffers[0].size(), bytes))) {
+		CloseHandle(file);
+		return hr;
+	}
+
+	UINT64 total = 0;
+	for(UINT current = 0; bytes >= format.m_recordSize; current ^= 1) {
+		const UINT64 count = bytes / format.m_recordSize;
+		const bool more = bytes == buffers[current].size();
+
+		UINT64 nextBytes = 0;
+		HRESULT hrRead = S_OK;
+		std::thread reader;
+		if(more)
+			reader = std::thread([&]() {
+				PROFILE_SCOPE("Read points");
+				hrRead = ReadFileFully(file, buffers[current ^ 1].data(), buffers[current ^ 1].size(), nextBytes);
+			});
+
+		if(layout.m_dataSize != 0)
+			batcher.Voxelize(buffers[current].data() + format.m_positionOffset, count, format.m_recordSize);
+		total += count;
+
+		if(reader.joinable())
+			reader.join();
+		if(FAILED(hrRead)) {
+			CloseHandle(file);
+			return hrRead;
+		}
+		bytes = nextBytes;
+	}
+
+	CloseHandle(file);
+	if(numPoints != nullptr)
+		*numPoints = total;
+	return S_OK;
+}
@@ -0,0 +1,31 @@
+//==============================================================================================================================================================
+// Streaming voxelization of point clouds into packed voxel grids
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//==============================================================================================================================================================
+
+// Layout of a binary point file: m_headerSize bytes followed by records of m_recordSize bytes, each holding a point's position as
+// three floats at byte offset m_positionOffset. Files of bare positions have m_recordSize = 12; other per-point attributes such as
+// intensity or color are skipped.
+struct PointCloudFileFormat {
+	UINT64 m_headerSize;
+	UINT m_recordSize;
+	UINT m_positionOffset;
+};
+
+// Sets the voxels containing count points, given as records of recordSize bytes starting with the position, after transformation
+// by matWorldToVoxel (g_matWorldToVoxel, i.e. row-major and applied to column vectors). The grid is in the layout of the
+// voxelization buffer and is not cleared, so that clouds can be voxelized piecewise; points outside of it are ignored. The points are
+// distributed across worker threads, each of which collects the voxels of its points in batches of (word, bit) pairs, radix sorts
+// them by word address and ORs the merged bits of each word into the grid with a single atomic operation, in ascending order of
+// addresses.
+HRESULT VoxelizePoints(const void* points, UINT64 count, UINT recordSize, const float matWorldToVoxel[16], const VoxelGridLayout& layout, UINT32* voxels);
+
+// VoxelizePoints for all points of a file, which is streamed in chunks of fixed size: the next chunk is read while the workers
+// process the current one, so voxelization overlaps with I/O and memory use is independent of the size of the cloud. numPoints
+// receives the number of points read, if not nullptr.
+HRESULT VoxelizePointCloudFile(const WCHAR* fileName, const PointCloudFileFormat& format, const float matWorldToVoxel[16], const VoxelGridLayout& layout, UINT32* voxels, UINT64* numPoints = nullptr);
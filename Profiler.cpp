@@ -0,0 +1,158 @@
+//==============================================================================================================================================================
+// Scoped timers for the CPU voxelization pipeline, dumped as Chrome trace events
+//==============================================================================================================================================================
+
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//==============================================================================================================================================================
+
+std::atomic<bool> g_profilingEnabled(false);
+
+namespace {
+
+	struct ProfileEvent {
+		const char* m_name;
+		INT64 m_begin;
+		INT64 m_end;
+		DWORD m_threadId;
+	};
+
+	// Written only by the thread that has acquired it; m_count is the number of events ever recorded, so the buffer holds those in
+	// [m_count - c_profileEventsPerThread, m_count) once it has wrapped around. Buffers of finished threads are handed to new ones,
+	// since ParallelFor starts fresh threads for every loop; their events are kept, tagged with the original thread's id.
+	struct ProfileBuffer {
+		std::atomic<UINT64> m_count;
+		std::atomic<bool> m_acquired;
+		ProfileEvent m_events[c_profileEventsPerThread];
+	};
+
+	std::mutex g_profileBuffersMutex;
+	std::vector<std::unique_ptr<ProfileBuffer>> g_profileBuffers;
+	INT64 g_profilingStart = 0;
+
+	ProfileBuffer* AcquireProfileBuffer() {
+		std::lock_guard<std::mutex> lock(g_profileBuffersMutex);
+		for(auto& buffer : g_profileBuffers) {
+			// acquire pairs with the release by ~ThreadProfileBuffer, ordering the previous owner's writes before ours
+			if(!buffer->m_acquired.load(std::memory_order_acquire)) {
+				buffer->m_acquired.store(true, std::memory_order_relaxed);
+				return buffer.get();
+			}
+		}
+
+		try {
+			std::unique_ptr<ProfileBuffer> buffer(new ProfileBuffer);
+			buffer->m_count.store(0, std::memory_order_relaxed);
+			buffer->m_acquired.store(true, std::memory_order_relaxed);
+			g_profileBuffers.push_back(std::move(buffer));
+		} catch(const std::bad_alloc&) {
+			return nullptr;
+		}
+		return g_profileBuffers.back().get();
+	}
+
+	// releases the thread's buffer when the thread exits
+	struct ThreadProfileBuffer {
+		ProfileBuffer* m_buffer = nullptr;
+		bool m_failed = false;
+
+		~ThreadProfileBuffer() {
+			if(m_buffer != nullptr)
+				m_buffer->m_acquired.store(false, std::memory_order_release);
+		}
+	};
+
+	thread_local ThreadProfileBuffer t_profileBuffer;
+
+	void WriteJsonString(FILE* file, const char* s) {
+		fputc('"', file);
+		for(; *s != '\0'; s++) {
+			if(*s == '"' || *s == '\\')
+				fputc('\\', file);
+			if(UINT8(*s) >= 0x20)
+				fputc(*s, file);
+		}
+		fputc('"', file);
+	}
+
+}
+
+//==============================================================================================================================================================
+
+void RecordProfileEvent(const char* name, INT64 begin, INT64 end) {
+	ThreadProfileBuffer& local = t_profileBuffer;
+	if(local.m_buffer == nullptr) {
+		if(local.m_failed)
+			return;
+		local.m_buffer = AcquireProfileBuffer();
+		if(local.m_buffer == nullptr) {
+			local.m_failed = true;
+			return;
+		}
+	}
+
+	ProfileBuffer* buffer = local.m_buffer;
+	const UINT64 count = buffer->m_count.load(std::memory_order_relaxed);
+	ProfileEvent& event = buffer->m_events[count % c_profileEventsPerThread];
+	event.m_name = name;
+	event.m_begin = begin;
+	event.m_end = end;
+	event.m_threadId = GetCurrentThreadId();
+	buffer->m_count.store(count + 1, std::memory_order_release);
+}
+
+void StartProfiling() {
+	{
+		std::lock_guard<std::mutex> lock(g_profileBuffersMutex);
+		for(auto& buffer : g_profileBuffers)
+			buffer->m_count.store(0, std::memory_order_relaxed);
+	}
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	g_profilingStart = counter.QuadPart;
+	g_profilingEnabled.store(true, std::memory_order_release);
+}
+
+void StopProfiling() {
+	g_profilingEnabled.store(false, std::memory_order_release);
+}
+
+HRESULT WriteProfileTrace(const WCHAR* fileName) {
+	FILE* file = nullptr;
+	if(_wfopen_s(&file, fileName, L"w") != 0 || file == nullptr)
+		return E_FAIL;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	const double microsecondsPerTick = 1e6 / double(frequency.QuadPart);
+	const DWORD processId = GetCurrentProcessId();
+
+	// complete events ("ph": "X") with timestamps in microseconds since the start of the capture
+	fprintf(file, "{\"traceEvents\":[");
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(g_profileBuffersMutex);
+		for(auto& buffer : g_profileBuffers) {
+			const UINT64 count = buffer->m_count.load(std::memory_order_acquire);
+			for(UINT64 i = count - std::min<UINT64>(count, c_profileEventsPerThread); i < count; i++) {
+				const ProfileEvent& event = buffer->m_events[i % c_profileEventsPerThread];
+				fprintf(file, first ? "\n{\"name\":" : ",\n{\"name\":");
+				WriteJsonString(file, event.m_name);
+				fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+					double(event.m_begin - g_profilingStart) * microsecondsPerTick, double(event.m_end - event.m_begin) * microsecondsPerTick,
+					static_cast<unsigned long>(processId), static_cast<unsigned long>(event.m_threadId));
+				first = false;
+			}
+		}
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	const bool failed = ferror(file) != 0;
+	return (fclose(file) != 0 || failed) ? E_FAIL : S_OK;
+}
@@ -0,0 +1,56 @@
+//==============================================================================================================================================================
+// Scoped timers for the CPU voxelization pipeline, dumped as Chrome trace events
+//==============================================================================================================================================================
+
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+
+//==============================================================================================================================================================
+
+// Whether profile scopes record events; scopes test it with a single relaxed load, so that they can stay in release builds.
+extern std::atomic<bool> g_profilingEnabled;
+
+// Appends a complete event, with begin and end in QueryPerformanceCounter ticks, to the calling thread's ring buffer. The buffer is
+// owned by the thread while it lives, so recording takes no locks; it keeps the c_profileEventsPerThread most recent events.
+void RecordProfileEvent(const char* name, INT64 begin, INT64 end);
+
+const UINT c_profileEventsPerThread = 1 << 14;
+
+// Records an event from its construction to its destruction; name has to be a string literal or otherwise outlive the trace.
+class ProfileScope {
+public:
+	explicit ProfileScope(const char* name) : m_name(name), m_begin(0) {
+		if(g_profilingEnabled.load(std::memory_order_relaxed)) {
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			m_begin = counter.QuadPart;
+		}
+	}
+
+	~ProfileScope() {
+		if(m_begin != 0) {
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			RecordProfileEvent(m_name, m_begin, counter.QuadPart);
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* m_name;
+	INT64 m_begin;
+};
+
+#define PROFILE_SCOPE_NAME2(line) profileScope##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(name)
+
+// Starting discards the events of the previous capture. Both have to be called while no profiled code runs, as has writing the
+// trace, which contains the events recorded since the start as JSON for chrome://tracing or Perfetto, one track per thread.
+void StartProfiling();
+void StopProfiling();
+HRESULT WriteProfileTrace(const WCHAR* fileName);
@@ -0,0 +1,457 @@
+//==============================================================================================================================================================
+// Sparse conservative surface voxelization into an octree of 8^3 voxel bricks, built top-down from the triangles
+//==============================================================================================================================================================
+
+#include "SparseVoxelizer.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include <intrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// largest supported grid size per axis, limited by the precision of voxel space coordinates
+	const UINT c_maxGridSize = 1u << 16;
+
+	// axes of the xy, xz and yz projections
+	const UINT c_projectionAxes[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+	// edge function of a projected triangle edge, made conservative for square cells: for a cell with minimum corner p and size s,
+	// dot(m_normal, p) + m_offset + m_cellOffset * s >= 0 if the cell overlaps the inner half plane of the edge
+	struct EdgeFunction {
+		float m_normal[2];
+		float m_offset;
+		float m_cellOffset;
+	};
+
+	struct TriangleSetup {
+		float m_boxMin[3];				// voxOrigMin of CS_VoxelizeSurfaceConservative
+		float m_boxMax[3];				// voxOrigMax
+		float m_normal[3];
+		float m_planeOffset;
+		float m_planeMin;				// smallest and largest dot(m_normal, c) over the corners c of the unit cube
+		float m_planeMax;
+		EdgeFunction m_edges[3][3];		// per projection and edge
+	};
+
+	// same as Determine2dEdge in Voxelization.hlsl, but with the cell offset kept separate so that it can be scaled
+	EdgeFunction DetermineEdgeFunction(float orientation, float edge_x, float edge_y, float vertex_x, float vertex_y) {
+		EdgeFunction f;
+		f.m_normal[0] = -orientation * edge_y;
+		f.m_normal[1] = orientation * edge_x;
+		f.m_offset = -(f.m_normal[0] * vertex_x + f.m_normal[1] * vertex_y);
+		f.m_cellOffset = std::max(0.0f, f.m_normal[0]) + std::max(0.0f, f.m_normal[1]);
+		return f;
+	}
+
+	// returns false for triangles without area, which CS_VoxelizeSurfaceConservative does not voxelize outside of its 1D and 2D cases
+	// either
+	bool SetupTriangle(const CpuVoxelizationMesh& mesh, const float* m, UINT tri, TriangleSetup& setup) {
+		float v[3][3];
+		for(UINT i = 0; i < 3; i++) {
+			const float* p = mesh.m_vertices + UINT64(mesh.m_indices[tri * 3 + i]) * mesh.m_vertexFloatStride;
+			const float w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+			for(UINT a = 0; a < 3; a++)
+				v[i][a] = (m[a * 4] * p[0] + m[a * 4 + 1] * p[1] + m[a * 4 + 2] * p[2] + m[a * 4 + 3]) / w;
+		}
+
+		// bounding box of touched voxels
+		for(UINT a = 0; a < 3; a++) {
+			const float vMin = std::min(v[0][a], std::min(v[1][a], v[2][a]));
+			const float vMax = std::max(v[0][a], std::max(v[1][a], v[2][a]));
+			setup.m_boxMin[a] = floorf(vMin);
+			if(setup.m_boxMin[a] == vMin)
+				setup.m_boxMin[a]--;
+			setup.m_boxMax[a] = floorf(vMax + 1.0f);
+		}
+
+		// edges and normal
+		float e[3][3];
+		for(UINT a = 0; a < 3; a++) {
+			e[0][a] = v[1][a] - v[0][a];
+			e[1][a] = v[2][a] - v[1][a];
+			e[2][a] = v[0][a] - v[2][a];
+		}
+
+		float* n = setup.m_normal;
+		n[0] = e[2][1] * e[0][2] - e[2][2] * e[0][1];
+		n[1] = e[2][2] * e[0][0] - e[2][0] * e[0][2];
+		n[2] = e[2][0] * e[0][1] - e[2][1] * e[0][0];
+		if(n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f)
+			return false;
+
+		setup.m_planeOffset = -(n[0] * v[0][0] + n[1] * v[0][1] + n[2] * v[0][2]);
+		setup.m_planeMin = std::min(0.0f, n[0]) + std::min(0.0f, n[1]) + std::min(0.0f, n[2]);
+		setup.m_planeMax = std::max(0.0f, n[0]) + std::max(0.0f, n[1]) + std::max(0.0f, n[2]);
+
+		// orientations of the xy, xz and yz projections as in CS_VoxelizeSurfaceConservative
+		const float orientations[3] = { n[2] < 0.0f ? -1.0f : 1.0f, n[1] > 0.0f ? -1.0f : 1.0f, n[0] < 0.0f ? -1.0f : 1.0f };
+		for(UINT proj = 0; proj < 3; proj++) {
+			const UINT a = c_projectionAxes[proj][0];
+			const UINT b = c_projectionAxes[proj][1];
+			for(UINT i = 0; i < 3; i++)
+				setup.m_edges[proj][i] = DetermineEdgeFunction(orientations[proj], e[i][a], e[i][b], v[i][a], v[i][b]);
+		}
+		return true;
+	}
+
+	bool OverlapsProjection(const TriangleSetup& setup, UINT proj, float pa, float pb, float size) {
+		for(UINT i = 0; i < 3; i++) {
+			const EdgeFunction& f = setup.m_edges[proj][i];
+			if(f.m_normal[0] * pa + f.m_normal[1] * pb + f.m_offset + f.m_cellOffset * size < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	bool OverlapsPlane(const TriangleSetup& setup, const float p[3], float size) {
+		const float d = setup.m_normal[0] * p[0] + setup.m_normal[1] * p[1] + setup.m_normal[2] * p[2] + setup.m_planeOffset;
+		return d + setup.m_planeMin * size <= 0.0f && d + setup.m_planeMax * size >= 0.0f;
+	}
+
+	// conservative test of triangle against the cube [p, p + size)
+	bool OverlapsCube(const TriangleSetup& setup, const float p[3], float size) {
+		for(UINT a = 0; a < 3; a++) {
+			if(p[a] >= setup.m_boxMax[a] || p[a] + size <= setup.m_boxMin[a])
+				return false;
+		}
+		return OverlapsPlane(setup, p, size)
+			&& OverlapsProjection(setup, 0, p[0], p[1], size)
+			&& OverlapsProjection(setup, 1, p[0], p[2], size)
+			&& OverlapsProjection(setup, 2, p[1], p[2], size);
+	}
+
+	// interleaves the lower 21 bits of x with zeros
+	UINT64 SpreadBits(UINT64 x) {
+		x &= 0x1fffff;
+		x = (x | (x << 32)) & 0x001f00000000ffffull;
+		x = (x | (x << 16)) & 0x001f0000ff0000ffull;
+		x = (x | (x << 8)) & 0x100f00f00f00f00full;
+		x = (x | (x << 4)) & 0x10c30c30c30c30c3ull;
+		x = (x | (x << 2)) & 0x1249249249249249ull;
+		return x;
+	}
+
+	UINT64 GetMortonCode(UINT x, UINT y, UINT z) {
+		return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	struct OctreeTask {
+		UINT32 m_origin[3];
+		UINT m_size;
+		std::vector<UINT32> m_triangles;
+	};
+
+	class OctreeBuilder {
+	public:
+		OctreeBuilder(const std::vector<TriangleSetup>& triangles, const UINT gridSize[3])
+			: m_triangles(triangles), m_gridSize(gridSize)
+		{
+		}
+
+		// calls func(childOrigin, childSize, childTriangles) for each child of the node that is inside of the grid and overlaps triangles
+		template<typename Func>
+		void ForEachChild(const UINT32 origin[3], UINT size, const std::vector<UINT32>& triangles, std::vector<UINT32>& childTriangles, const Func& func) const {
+			const UINT childSize = size / 2;
+			for(UINT child = 0; child < 8; child++) {
+				UINT32 childOrigin[3];
+				float p[3];
+				bool inside = true;
+				for(UINT a = 0; a < 3; a++) {
+					childOrigin[a] = origin[a] + ((child >> a) & 1) * childSize;
+					p[a] = float(childOrigin[a]);
+					inside &= childOrigin[a] < m_gridSize[a];
+				}
+				if(!inside)
+					continue;
+
+				childTriangles.clear();
+				for(UINT32 tri : triangles) {
+					if(OverlapsCube(m_triangles[tri], p, float(childSize)))
+						childTriangles.push_back(tri);
+				}
+				if(!childTriangles.empty())
+					func(childOrigin, childSize, childTriangles);
+			}
+		}
+
+		void Subdivide(const UINT32 origin[3], UINT size, const std::vector<UINT32>& triangles, UINT depth, std::vector<std::vector<UINT32>>& scratch, std::vector<SparseVoxelBrick>& bricks) const {
+			if(size == SparseVoxelGrid::c_brickSize) {
+				VoxelizeBrick(origin, triangles, bricks);
+				return;
+			}
+
+			ForEachChild(origin, size, triangles, scratch[depth], [&](const UINT32* childOrigin, UINT childSize, const std::vector<UINT32>& childTriangles) {
+				Subdivide(childOrigin, childSize, childTriangles, depth + 1, scratch, bricks);
+			});
+		}
+
+	private:
+		// per voxel tests; the brick is dropped if the node tests were too conservative to leave any voxel set
+		void VoxelizeBrick(const UINT32 origin[3], const std::vector<UINT32>& triangles, std::vector<SparseVoxelBrick>& bricks) const {
+			SparseVoxelBrick brick;
+			memset(&brick, 0, sizeof(brick));
+			brick.m_origin[0] = origin[0];
+			brick.m_origin[1] = origin[1];
+			brick.m_origin[2] = origin[2];
+
+			bool empty = true;
+			for(UINT32 tri : triangles) {
+				const TriangleSetup& setup = m_triangles[tri];
+
+				float voxMin[3], voxMax[3];
+				for(UINT a = 0; a < 3; a++) {
+					voxMin[a] = std::max(float(origin[a]), std::max(0.0f, setup.m_boxMin[a]));
+					voxMax[a] = std::min(float(origin[a] + SparseVoxelGrid::c_brickSize), std::min(float(m_gridSize[a]), setup.m_boxMax[a]));
+				}
+
+				float p[3];
+				for(p[1] = voxMin[1]; p[1] < voxMax[1]; p[1]++) {
+					UINT64& slice = brick.m_slices[UINT(p[1]) - origin[1]];
+					for(p[0] = voxMin[0]; p[0] < voxMax[0]; p[0]++) {
+						if(!OverlapsProjection(setup, 0, p[0], p[1], 1.0f))
+							continue;
+
+						const UINT column = (UINT(p[0]) - origin[0]) * 8;
+						for(p[2] = voxMin[2]; p[2] < voxMax[2]; p[2]++) {
+							if(OverlapsPlane(setup, p, 1.0f) && OverlapsProjection(setup, 1, p[0], p[2], 1.0f) && OverlapsProjection(setup, 2, p[1], p[2], 1.0f)) {
+								slice |= UINT64(1) << (column + UINT(p[2]) - origin[2]);
+								empty = false;
+							}
+						}
+					}
+				}
+			}
+
+			if(!empty)
+				bricks.push_back(brick);
+		}
+
+		const std::vector<TriangleSetup>& m_triangles;
+		const UINT* m_gridSize;
+	};
+
+}
+
+//==============================================================================================================================================================
+
+SparseVoxelGrid::SparseVoxelGrid()
+	: m_rootSize(0), m_numLevels(0)
+{
+	m_gridSize[0] = m_gridSize[1] = m_gridSize[2] = 0;
+}
+
+void SparseVoxelGrid::Clear() {
+	m_gridSize[0] = m_gridSize[1] = m_gridSize[2] = 0;
+	m_rootSize = 0;
+	m_numLevels = 0;
+	m_nodes.clear();
+	m_bricks.clear();
+}
+
+UINT64 SparseVoxelGrid::GetMemoryUsage() const {
+	return m_nodes.size() * sizeof(SparseVoxelNode) + m_bricks.size() * sizeof(SparseVoxelBrick);
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+HRESULT SparseVoxelGrid::Voxelize(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ) {
+	PROFILE_SCOPE("Sparse voxelization");
+
+	if(mesh.m_vertices == nullptr || mesh.m_indices == nullptr || matModelToVoxel == nullptr)
+		return E_INVALIDARG;
+	if(gridSizeX > c_maxGridSize || gridSizeY > c_maxGridSize || gridSizeZ > c_maxGridSize)
+		return E_INVALIDARG;
+
+	Clear();
+	m_gridSize[0] = gridSizeX;
+	m_gridSize[1] = gridSizeY;
+	m_gridSize[2] = gridSizeZ;
+
+	m_rootSize = 2 * c_brickSize;
+	m_numLevels = 1;
+	while(m_rootSize < std::max(gridSizeX, std::max(gridSizeY, gridSizeZ))) {
+		m_rootSize *= 2;
+		m_numLevels++;
+	}
+
+	try {
+		// set up triangles, dropping those that miss the grid entirely
+		std::vector<TriangleSetup> triangles(mesh.m_numTriangles);
+		std::vector<UINT8> valid(mesh.m_numTriangles);
+		ParallelFor(0, mesh.m_numTriangles, 4096, [&](UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Triangle setup");
+			for(UINT tri = UINT(begin); tri < UINT(end); tri++) {
+				TriangleSetup& setup = triangles[tri];
+				valid[tri] = SetupTriangle(mesh, matModelToVoxel, tri, setup)
+					&& setup.m_boxMax[0] > 0.0f && setup.m_boxMin[0] < float(gridSizeX)
+					&& setup.m_boxMax[1] > 0.0f && setup.m_boxMin[1] < float(gridSizeY)
+					&& setup.m_boxMax[2] > 0.0f && setup.m_boxMin[2] < float(gridSizeZ);
+			}
+		});
+
+		const OctreeBuilder builder(triangles, m_gridSize);
+
+		// expand the top levels breadth-first until there are enough subtrees to keep the worker threads busy
+		std::vector<OctreeTask> tasks(1);
+		tasks[0].m_origin[0] = tasks[0].m_origin[1] = tasks[0].m_origin[2] = 0;
+		tasks[0].m_size = m_rootSize;
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++) {
+			if(valid[tri])
+				tasks[0].m_triangles.push_back(tri);
+		}
+		if(tasks[0].m_triangles.empty())
+			tasks.clear();
+
+		const size_t minTasks = 16 * size_t(GetWorkerThreadCount());
+		std::vector<UINT32> childTriangles;
+		while(!tasks.empty() && tasks.size() < minTasks && tasks[0].m_size > 2 * c_brickSize) {
+			std::vector<OctreeTask> children;
+			for(const OctreeTask& task : tasks) {
+				builder.ForEachChild(task.m_origin, task.m_size, task.m_triangles, childTriangles, [&](const UINT32* childOrigin, UINT childSize, const std::vector<UINT32>& triangles) {
+					children.push_back(OctreeTask());
+					OctreeTask& child = children.back();
+					memcpy(child.m_origin, childOrigin, sizeof(child.m_origin));
+					child.m_size = childSize;
+					child.m_triangles = triangles;
+				});
+			}
+			tasks.swap(children);
+		}
+
+		// build the subtrees' bricks in parallel
+		std::vector<std::vector<SparseVoxelBrick>> taskBricks(tasks.size());
+		ParallelFor(0, tasks.size(), 1, [&](UINT64 begin, UINT64 end) {
+			PROFILE_SCOPE("Build bricks");
+			std::vector<std::vector<UINT32>> scratch(m_numLevels);		// triangle lists of the children, per depth
+			for(UINT64 i = begin; i < end; i++)
+				builder.Subdivide(tasks[i].m_origin, tasks[i].m_size, tasks[i].m_triangles, 0, scratch, taskBricks[i]);
+		});
+
+		size_t numBricks = 0;
+		for(const auto& bricks : taskBricks)
+			numBricks += bricks.size();
+
+		// sort bricks by Morton code so that the children of each node are consecutive and in child order
+		std::vector<std::pair<UINT64, UINT32>> codes;
+		codes.reserve(numBricks);
+		m_bricks.reserve(numBricks);
+		for(auto& bricks : taskBricks) {
+			for(const SparseVoxelBrick& brick : bricks) {
+				codes.push_back(std::make_pair(GetMortonCode(brick.m_origin[0] / c_brickSize, brick.m_origin[1] / c_brickSize, brick.m_origin[2] / c_brickSize), UINT32(m_bricks.size())));
+				m_bricks.push_back(brick);
+			}
+			std::vector<SparseVoxelBrick>().swap(bricks);
+		}
+		std::sort(codes.begin(), codes.end());
+
+		std::vector<SparseVoxelBrick> sortedBricks(numBricks);
+		for(size_t i = 0; i < numBricks; i++)
+			sortedBricks[i] = m_bricks[codes[i].second];
+		m_bricks.swap(sortedBricks);
+
+		// build inner levels bottom-up; the parent of a node or brick is its Morton code shifted by 3 bits
+		std::vector<std::vector<SparseVoxelNode>> levels(m_numLevels);
+		std::vector<UINT64> childCodes(numBricks);
+		for(size_t i = 0; i < numBricks; i++)
+			childCodes[i] = codes[i].first;
+
+		for(UINT level = m_numLevels; level-- > 0; ) {
+			std::vector<UINT64> parentCodes;
+			std::vector<SparseVoxelNode>& nodes = levels[level];
+			for(size_t i = 0; i < childCodes.size(); i++) {
+				const UINT64 parentCode = childCodes[i] >> 3;
+				if(parentCodes.empty() || parentCodes.back() != parentCode) {
+					SparseVoxelNode node = { UINT32(i), 0u };
+					parentCodes.push_back(parentCode);
+					nodes.push_back(node);
+				}
+				nodes.back().m_childMask |= 1u << (childCodes[i] & 7);
+			}
+			childCodes.swap(parentCodes);
+		}
+
+		if(levels[0].empty()) {
+			SparseVoxelNode root = { 0u, 0u };
+			levels[0].push_back(root);
+		}
+
+		// concatenate levels root first, turning child indices of inner levels into indices into the node array
+		size_t numNodes = 0;
+		for(const auto& nodes : levels)
+			numNodes += nodes.size();
+		m_nodes.reserve(numNodes);
+		for(UINT level = 0; level < m_numLevels; level++) {
+			const UINT32 childOffset = UINT32(m_nodes.size() + levels[level].size());
+			for(SparseVoxelNode node : levels[level]) {
+				if(level + 1 < m_numLevels)
+					node.m_firstChild += childOffset;
+				m_nodes.push_back(node);
+			}
+		}
+	} catch(const std::bad_alloc&) {
+		Clear();
+		return E_OUTOFMEMORY;
+	}
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+bool SparseVoxelGrid::IsSet(UINT x, UINT y, UINT z) const {
+	if(x >= m_gridSize[0] || y >= m_gridSize[1] || z >= m_gridSize[2])
+		return false;
+
+	UINT index = 0;
+	for(UINT level = 0; level < m_numLevels; level++) {
+		const UINT shift = m_numLevels - level + 2;		// log2 of the child size
+		const UINT child = ((x >> shift) & 1) | (((y >> shift) & 1) << 1) | (((z >> shift) & 1) << 2);
+		const SparseVoxelNode& node = m_nodes[index];
+		if((node.m_childMask & (1u << child)) == 0)
+			return false;
+		index = node.m_firstChild + __popcnt(node.m_childMask & ((1u << child) - 1));
+	}
+
+	const SparseVoxelBrick& brick = m_bricks[index];
+	return ((brick.m_slices[y & 7] >> ((x & 7) * 8 + (z & 7))) & 1) != 0;
+}
+
+UINT64 SparseVoxelGrid::CountVoxels() const {
+	UINT64 count = 0;
+	for(const SparseVoxelBrick& brick : m_bricks) {
+		for(UINT y = 0; y < c_brickSize; y++)
+			count += __popcnt64(brick.m_slices[y]);
+	}
+	return count;
+}
+
+HRESULT SparseVoxelGrid::CopyToDense(const VoxelGridLayout& layout, UINT32* voxels) const {
+	if(layout != MakeVoxelGridLayout(m_gridSize[0], m_gridSize[1], m_gridSize[2]))
+		return E_INVALIDARG;
+
+	std::fill(voxels, voxels + layout.m_dataSize, 0u);
+
+	// each brick column covers one byte of a (little-endian) word, so bricks can be written in parallel without atomics
+	UINT8* bytes = reinterpret_cast<UINT8*>(voxels);
+	ParallelFor(0, m_bricks.size(), 256, [&](UINT64 begin, UINT64 end) {
+		for(UINT64 i = begin; i < end; i++) {
+			const SparseVoxelBrick& brick = m_bricks[i];
+			const UINT byteInWord = (brick.m_origin[2] & 31) >> 3;
+			for(UINT y = 0; y < c_brickSize && brick.m_origin[1] + y < m_gridSize[1]; y++) {
+				for(UINT x = 0; x < c_brickSize && brick.m_origin[0] + x < m_gridSize[0]; x++) {
+					const UINT64 word = GetVoxelWordIndex(layout, brick.m_origin[0] + x, brick.m_origin[1] + y, brick.m_origin[2] >> 5);
+					bytes[word * 4 + byteInWord] = UINT8(brick.m_slices[y] >> (x * 8));
+				}
+			}
+		}
+	});
+
+	return S_OK;
+}
@@ -0,0 +1,61 @@
+//==============================================================================================================================================================
+// Sparse conservative surface voxelization into an octree of 8^3 voxel bricks, built top-down from the triangles
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "CpuVoxelizer.h"
+#include <vector>
+
+//==============================================================================================================================================================
+
+// 8x8x8 voxels; slice y holds voxel (x, y, z) in bit x * 8 + z, i.e. the bricks keep the z-fastest, then x, then y order of the
+// voxelization buffer
+struct SparseVoxelBrick {
+	UINT32 m_origin[3];				// in voxels, multiple of 8
+	UINT64 m_slices[8];
+};
+
+// inner octree node; the children present according to m_childMask (bit x | y << 1 | z << 2 for the child in the upper half along
+// x, y, z) are stored consecutively in child order, starting at m_firstChild in the node array or, on the last level, in the brick
+// array
+struct SparseVoxelNode {
+	UINT32 m_firstChild;
+	UINT32 m_childMask;
+};
+
+// Conservative surface voxelization that never allocates the dense grid. The root cube is recursively subdivided, and each node
+// receives only those triangles of its parent that overlap it: first the bounding boxes (as in CS_VoxelizeSurfaceConservative), then
+// the triangle's plane and its edges in the xy, xz and yz projections, all scaled to the node's size. Nodes without triangles are
+// pruned right away, and nodes of 8^3 voxels are voxelized into bricks with the same tests per voxel, so that work and memory scale
+// with the surface area rather than the grid volume. Subtrees are distributed across worker threads.
+class SparseVoxelGrid {
+public:
+	static const UINT c_brickSize = 8;
+
+	SparseVoxelGrid();
+
+	// voxelizes the mesh (see CpuVoxelizationMesh and VoxelizeOnCpu) into a grid of the given size, up to 65536 voxels per axis
+	HRESULT Voxelize(const CpuVoxelizationMesh& mesh, const float matModelToVoxel[16], UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ);
+	void Clear();
+
+	const UINT* GetGridSize() const { return m_gridSize; }
+	UINT GetRootSize() const { return m_rootSize; }						// power of two, at least 2 * c_brickSize
+	UINT GetNumLevels() const { return m_numLevels; }					// levels of inner nodes
+	const std::vector<SparseVoxelNode>& GetNodes() const { return m_nodes; }	// breadth-first, root first
+	const std::vector<SparseVoxelBrick>& GetBricks() const { return m_bricks; }	// in Morton order
+	UINT64 GetMemoryUsage() const;										// in bytes
+
+	bool IsSet(UINT x, UINT y, UINT z) const;
+	UINT64 CountVoxels() const;
+
+	// writes the voxels to a dense grid in the layout of the voxelization buffer, whose size has to match
+	HRESULT CopyToDense(const VoxelGridLayout& layout, UINT32* voxels) const;
+
+private:
+	UINT m_gridSize[3];
+	UINT m_rootSize;
+	UINT m_numLevels;
+	std::vector<SparseVoxelNode> m_nodes;
+	std::vector<SparseVoxelBrick> m_bricks;
+};
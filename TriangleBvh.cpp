@@ -0,0 +1,173 @@
+//==============================================================================================================================================================
+// Bounding volume hierarchy over the triangles of a mesh, for culling the mesh to a region of interest
+//==============================================================================================================================================================
+
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <cfloat>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	inline bool Overlaps(const float aMin[3], const float aMax[3], const float bMin[3], const float bMax[3]) {
+		return aMin[0] <= bMax[0] && aMax[0] >= bMin[0]
+			&& aMin[1] <= bMax[1] && aMax[1] >= bMin[1]
+			&& aMin[2] <= bMax[2] && aMax[2] >= bMin[2];
+	}
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT TriangleBvh::Build(const CpuVoxelizationMesh& mesh) {
+	if(mesh.m_vertices == nullptr || mesh.m_indices == nullptr)
+		return E_INVALIDARG;
+
+	Clear();
+	if(mesh.m_numTriangles == 0)
+		return S_OK;
+
+	try {
+		std::vector<Bounds> bounds(mesh.m_numTriangles);
+		std::vector<float> centroids(UINT64(mesh.m_numTriangles) * 3);
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++) {
+			Bounds& b = bounds[tri];
+			for(UINT i = 0; i < 3; i++) {
+				const float* p = mesh.m_vertices + UINT64(mesh.m_indices[tri * 3 + i]) * mesh.m_vertexFloatStride;
+				for(UINT a = 0; a < 3; a++) {
+					b.m_min[a] = i == 0 ? p[a] : std::min(b.m_min[a], p[a]);
+					b.m_max[a] = i == 0 ? p[a] : std::max(b.m_max[a], p[a]);
+				}
+			}
+			for(UINT a = 0; a < 3; a++)
+				centroids[tri * 3 + a] = 0.5f * (b.m_min[a] + b.m_max[a]);
+		}
+
+		m_triangles.resize(mesh.m_numTriangles);
+		for(UINT tri = 0; tri < mesh.m_numTriangles; tri++)
+			m_triangles[tri] = tri;
+
+		m_nodes.reserve(2 * ((mesh.m_numTriangles + c_maxLeafTriangles - 1) / c_maxLeafTriangles));
+		m_nodes.push_back(Node());
+		m_nodes[0].m_first = 0;
+		m_nodes[0].m_count = mesh.m_numTriangles;
+
+		// split nodes depth-first; a node's triangles are m_triangles[m_first, m_first + m_count) until it is split
+		std::vector<UINT32> stack(1, 0);
+		while(!stack.empty()) {
+			const UINT32 index = stack.back();
+			stack.pop_back();
+
+			const UINT32 first = m_nodes[index].m_first;
+			const UINT32 count = m_nodes[index].m_count;
+
+			// bounds of triangles and of centroids
+			float nodeMin[3], nodeMax[3], centroidMin[3], centroidMax[3];
+			for(UINT a = 0; a < 3; a++) {
+				nodeMin[a] = centroidMin[a] = FLT_MAX;
+				nodeMax[a] = centroidMax[a] = -FLT_MAX;
+			}
+			for(UINT32 i = first; i < first + count; i++) {
+				const UINT32 tri = m_triangles[i];
+				for(UINT a = 0; a < 3; a++) {
+					nodeMin[a] = std::min(nodeMin[a], bounds[tri].m_min[a]);
+					nodeMax[a] = std::max(nodeMax[a], bounds[tri].m_max[a]);
+					centroidMin[a] = std::min(centroidMin[a], centroids[tri * 3 + a]);
+					centroidMax[a] = std::max(centroidMax[a], centroids[tri * 3 + a]);
+				}
+			}
+
+			Node& node = m_nodes[index];
+			for(UINT a = 0; a < 3; a++) {
+				node.m_min[a] = nodeMin[a];
+				node.m_max[a] = nodeMax[a];
+			}
+
+			// keep small nodes and nodes whose centroids coincide as leaves
+			UINT axis = 0;
+			for(UINT a = 1; a < 3; a++) {
+				if(centroidMax[a] - centroidMin[a] > centroidMax[axis] - centroidMin[axis])
+					axis = a;
+			}
+			if(count <= c_maxLeafTriangles || centroidMax[axis] == centroidMin[axis])
+				continue;
+
+			// split at the median centroid along the longest axis
+			const UINT32 half = count / 2;
+			std::nth_element(m_triangles.begin() + first, m_triangles.begin() + first + half, m_triangles.begin() + first + count, [&](UINT32 a, UINT32 b) {
+				return centroids[a * 3 + axis] < centroids[b * 3 + axis];
+			});
+
+			const UINT32 children = UINT32(m_nodes.size());
+			m_nodes[index].m_first = children;
+			m_nodes[index].m_count = 0;
+
+			m_nodes.push_back(Node());
+			m_nodes.push_back(Node());
+			m_nodes[children].m_first = first;
+			m_nodes[children].m_count = half;
+			m_nodes[children + 1].m_first = first + half;
+			m_nodes[children + 1].m_count = count - half;
+
+			stack.push_back(children + 1);
+			stack.push_back(children);
+		}
+
+		m_bounds.resize(mesh.m_numTriangles);
+		for(UINT i = 0; i < mesh.m_numTriangles; i++)
+			m_bounds[i] = bounds[m_triangles[i]];
+	} catch(const std::bad_alloc&) {
+		Clear();
+		return E_OUTOFMEMORY;
+	}
+
+	return S_OK;
+}
+
+void TriangleBvh::Clear() {
+	m_nodes.clear();
+	m_triangles.clear();
+	m_bounds.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void TriangleBvh::FindTriangles(const float boxMin[3], const float boxMax[3], std::vector<UINT32>& triangles) const {
+	if(m_nodes.empty())
+		return;
+
+	UINT32 stack[64];
+	UINT stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0) {
+		const Node& node = m_nodes[stack[--stackSize]];
+		if(!Overlaps(node.m_min, node.m_max, boxMin, boxMax))
+			continue;
+
+		// node entirely inside of the box: take all its triangles without further tests
+		const bool contained = node.m_min[0] >= boxMin[0] && node.m_max[0] <= boxMax[0]
+			&& node.m_min[1] >= boxMin[1] && node.m_max[1] <= boxMax[1]
+			&& node.m_min[2] >= boxMin[2] && node.m_max[2] <= boxMax[2];
+
+		if(node.m_count > 0) {
+			for(UINT32 i = node.m_first; i < node.m_first + node.m_count; i++) {
+				if(contained || Overlaps(m_bounds[i].m_min, m_bounds[i].m_max, boxMin, boxMax))
+					triangles.push_back(m_triangles[i]);
+			}
+		} else if(contained) {
+			// the triangles of a subtree are consecutive; find its range via the leftmost and rightmost leaves
+			const Node* left = &node;
+			while(left->m_count == 0)
+				left = &m_nodes[left->m_first];
+			const Node* right = &node;
+			while(right->m_count == 0)
+				right = &m_nodes[right->m_first + 1];
+			triangles.insert(triangles.end(), m_triangles.begin() + left->m_first, m_triangles.begin() + right->m_first + right->m_count);
+		} else {
+			stack[stackSize++] = node.m_first + 1;
+			stack[stackSize++] = node.m_first;
+		}
+	}
+}
@@ -0,0 +1,45 @@
+//==============================================================================================================================================================
+// Bounding volume hierarchy over the triangles of a mesh, for culling the mesh to a region of interest
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "CpuVoxelizer.h"
+#include <vector>
+
+//==============================================================================================================================================================
+
+// Binary hierarchy of axis-aligned boxes in model space, built once per mesh by splitting the triangles at the median of their
+// centroids along the longest axis. Finding the triangles that touch a box visits only the nodes overlapping it, so its cost is
+// proportional to the number of triangles near the box rather than to the size of the mesh.
+class TriangleBvh {
+public:
+	static const UINT c_maxLeafTriangles = 4;
+
+	HRESULT Build(const CpuVoxelizationMesh& mesh);
+	void Clear();
+
+	UINT GetNumTriangles() const { return UINT(m_triangles.size()); }
+	UINT GetNumNodes() const { return UINT(m_nodes.size()); }
+
+	// appends the indices of all triangles whose bounding boxes overlap the closed box [boxMin, boxMax], in no particular order
+	void FindTriangles(const float boxMin[3], const float boxMax[3], std::vector<UINT32>& triangles) const;
+
+private:
+	// inner nodes have m_count == 0 and their children at m_first and m_first + 1; leaves reference m_count triangles starting at m_first
+	struct Node {
+		float m_min[3];
+		UINT32 m_first;
+		float m_max[3];
+		UINT32 m_count;
+	};
+
+	struct Bounds {
+		float m_min[3];
+		float m_max[3];
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<UINT32> m_triangles;			// triangle indices in leaf order
+	std::vector<Bounds> m_bounds;				// bounding boxes of m_triangles
+};
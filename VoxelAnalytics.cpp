@@ -0,0 +1,188 @@
+//==============================================================================================================================================================
+// Volumetric measures of voxelized solids computed directly on packed voxel grids
+//==============================================================================================================================================================
+
+#include "VoxelAnalytics.h"
+#include "Parallel.h"
+#include <intrin.h>
+#include <cstring>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// c_bitIndexMasks[b] has the bits set whose index has bit b set, so that sum(i) over the set bits i of m is
+	// sum(popcount(m & c_bitIndexMasks[b]) << b)
+	const UINT64 c_bitIndexMasks[6] = {
+		0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+		0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull,
+	};
+
+	// integer sums over the set voxels of one slab of constant y
+	struct SlabSums {
+		UINT64 m_count;
+		UINT64 m_sums[3];				// x, y, z
+		UINT64 m_sumsOfSquares[3];		// xx, yy, zz
+		UINT64 m_sumsOfProducts[3];		// xy, xz, yz
+		UINT64 m_faceCounts[3];
+	};
+
+	// words 2v and 2v + 1 of a column as one 64-bit word, with the bits beyond the grid's z extent cleared
+	inline UINT64 LoadWordPair(const UINT32* column, UINT v, UINT numWords, UINT numPairs, UINT64 lastPairMask) {
+		const UINT w = 2 * v;
+		UINT64 c = column[w];
+		if(w + 1 < numWords)
+			c |= UINT64(column[w + 1]) << 32;
+		return v + 1 < numPairs ? c : c & lastPairMask;
+	}
+
+	// adds count, sum(z) and sum(z^2) of the set bits of c, whose bit i is voxel z = z0 + i
+	inline void AccumulateMoments(UINT64 c, UINT64 z0, UINT64& count, UINT64& sumZ, UINT64& sumZZ) {
+		UINT64 masked[6];
+		UINT64 sumI = 0;
+		UINT64 sumII = 0;
+		for(UINT b = 0; b < 6; b++) {
+			masked[b] = c & c_bitIndexMasks[b];
+			const UINT64 n = __popcnt64(masked[b]);
+			sumI += n << b;
+			sumII += n << (2 * b);
+		}
+
+		// i^2 = sum over pairs of bits (b, b') of i of 2^(b + b'); the mixed pairs occur twice
+		for(UINT b = 0; b < 6; b++) {
+			for(UINT b2 = b + 1; b2 < 6; b2++)
+				sumII += __popcnt64(masked[b] & c_bitIndexMasks[b2]) << (b + b2 + 1);
+		}
+
+		const UINT64 n = __popcnt64(c);
+		count += n;
+		sumZ += z0 * n + sumI;
+		sumZZ += z0 * z0 * n + 2 * z0 * sumI + sumII;
+	}
+
+	void AccumulateSlab(const VoxelGridLayout& layout, const UINT32* voxels, UINT y, SlabSums& sums) {
+		const UINT sizeX = layout.m_gridSize[0];
+		const UINT sizeY = layout.m_gridSize[1];
+		const UINT numWords = layout.m_strideX;
+		const UINT numPairs = (numWords + 1) / 2;
+		const UINT lastPairBits = layout.m_gridSize[2] - 64 * (numPairs - 1);
+		const UINT64 lastPairMask = lastPairBits < 64 ? (1ull << lastPairBits) - 1 : ~0ull;
+
+		for(UINT x = 0; x < sizeX; x++) {
+			const UINT32* column = voxels + GetVoxelWordIndex(layout, x, y, 0);
+			const UINT32* columnPrevX = x > 0 ? column - layout.m_strideX : nullptr;
+			const UINT32* columnPrevY = y > 0 ? column - layout.m_strideY : nullptr;
+
+			UINT64 count = 0;
+			UINT64 sumZ = 0;
+			UINT64 sumZZ = 0;
+			UINT64 carry = 0;			// topmost voxel of the previous pair
+			for(UINT v = 0; v < numPairs; v++) {
+				const UINT64 c = LoadWordPair(column, v, numWords, numPairs, lastPairMask);
+				const UINT64 prevX = columnPrevX ? LoadWordPair(columnPrevX, v, numWords, numPairs, lastPairMask) : 0;
+				const UINT64 prevY = columnPrevY ? LoadWordPair(columnPrevY, v, numWords, numPairs, lastPairMask) : 0;
+				if((c | prevX | prevY | carry) == 0)
+					continue;
+
+				// a face lies between two voxels iff exactly one of them is set; the lower faces along each axis are counted here,
+				// the upper ones at the far side of the grid below
+				sums.m_faceCounts[0] += __popcnt64(c ^ prevX);
+				sums.m_faceCounts[1] += __popcnt64(c ^ prevY);
+				sums.m_faceCounts[2] += __popcnt64(c ^ ((c << 1) | carry));
+				carry = c >> 63;
+
+				if(c == 0)
+					continue;
+				if(x + 1 == sizeX)
+					sums.m_faceCounts[0] += __popcnt64(c);
+				if(y + 1 == sizeY)
+					sums.m_faceCounts[1] += __popcnt64(c);
+
+				AccumulateMoments(c, UINT64(v) * 64, count, sumZ, sumZZ);
+			}
+
+			// set topmost voxel of a grid whose z extent is a multiple of 64; otherwise its face was counted by the XOR above
+			sums.m_faceCounts[2] += carry;
+
+			if(count == 0)
+				continue;
+
+			sums.m_count += count;
+			sums.m_sums[0] += x * count;
+			sums.m_sums[1] += y * count;
+			sums.m_sums[2] += sumZ;
+			sums.m_sumsOfSquares[0] += UINT64(x) * x * count;
+			sums.m_sumsOfSquares[1] += UINT64(y) * y * count;
+			sums.m_sumsOfSquares[2] += sumZZ;
+			sums.m_sumsOfProducts[0] += UINT64(x) * y * count;
+			sums.m_sumsOfProducts[1] += x * sumZ;
+			sums.m_sumsOfProducts[2] += y * sumZ;
+		}
+	}
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT ComputeVoxelAnalytics(const VoxelGridLayout& layout, const UINT32* voxels, VoxelAnalytics& analytics) {
+	memset(&analytics, 0, sizeof(analytics));
+	if(layout.m_gridSize[0] == 0 || layout.m_gridSize[1] == 0 || layout.m_gridSize[2] == 0)
+		return S_OK;
+	if(voxels == nullptr)
+		return E_INVALIDARG;
+
+	std::vector<SlabSums> slabs;
+	try {
+		slabs.resize(layout.m_gridSize[1]);			// zero-initialized
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	ParallelFor(0, layout.m_gridSize[1], 1, [&](UINT64 yBegin, UINT64 yEnd) {
+		for(UINT y = UINT(yBegin); y < UINT(yEnd); y++)
+			AccumulateSlab(layout, voxels, y, slabs[y]);
+	});
+
+	SlabSums total;
+	memset(&total, 0, sizeof(total));
+	for(const SlabSums& slab : slabs) {
+		total.m_count += slab.m_count;
+		for(UINT a = 0; a < 3; a++) {
+			total.m_sums[a] += slab.m_sums[a];
+			total.m_sumsOfSquares[a] += slab.m_sumsOfSquares[a];
+			total.m_sumsOfProducts[a] += slab.m_sumsOfProducts[a];
+			total.m_faceCounts[a] += slab.m_faceCounts[a];
+		}
+	}
+
+	analytics.m_volume = total.m_count;
+	for(UINT a = 0; a < 3; a++) {
+		analytics.m_faceCounts[a] = total.m_faceCounts[a];
+		analytics.m_surfaceArea += total.m_faceCounts[a];
+	}
+	if(total.m_count == 0)
+		return S_OK;
+
+	// covariance of the voxel positions; the offset of the voxel centers by 0.5 only affects the mean
+	const double count = double(total.m_count);
+	double mean[3], covariance[3][3];
+	for(UINT a = 0; a < 3; a++) {
+		mean[a] = double(total.m_sums[a]) / count;
+		analytics.m_centerOfMass[a] = mean[a] + 0.5;
+	}
+	for(UINT a = 0; a < 3; a++)
+		covariance[a][a] = double(total.m_sumsOfSquares[a]) / count - mean[a] * mean[a];
+	covariance[0][1] = covariance[1][0] = double(total.m_sumsOfProducts[0]) / count - mean[0] * mean[1];
+	covariance[0][2] = covariance[2][0] = double(total.m_sumsOfProducts[1]) / count - mean[0] * mean[2];
+	covariance[1][2] = covariance[2][1] = double(total.m_sumsOfProducts[2]) / count - mean[1] * mean[2];
+
+	// point masses at the voxel centers, plus 1/6 on the diagonal for the inertia of each unit cube about its own center
+	const double trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+	for(UINT a = 0; a < 3; a++) {
+		for(UINT b = 0; b < 3; b++)
+			analytics.m_inertiaTensor[a][b] = count * ((a == b ? trace : 0.0) - covariance[a][b]);
+		analytics.m_inertiaTensor[a][a] += count / 6.0;
+	}
+
+	return S_OK;
+}
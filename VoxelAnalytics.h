@@ -0,0 +1,27 @@
+//==============================================================================================================================================================
+// Volumetric measures of voxelized solids computed directly on packed voxel grids
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//==============================================================================================================================================================
+
+// Measures of the set voxels of a grid, treated as unit cubes of unit mass in voxel space, i.e. voxel (x, y, z) covers
+// [x, x+1) x [y, y+1) x [z, z+1). Multiply by the voxel size (and its powers) to obtain world-space quantities.
+struct VoxelAnalytics {
+	UINT64 m_volume;				// number of set voxels
+	UINT64 m_faceCounts[3];			// number of faces between a set voxel and an empty one (or the grid boundary) with normal along x, y, z
+	UINT64 m_surfaceArea;			// sum of m_faceCounts
+	double m_centerOfMass[3];
+	double m_inertiaTensor[3][3];	// about the center of mass, including the inertia of each voxel cube
+};
+
+// Computes all measures in one pass over the grid, which is given in the layout of the voxelization buffer; bits beyond the grid's
+// z extent are ignored. Pairs of words along z are processed as 64-bit words: the volume is their population count, first and second
+// moments along z follow from population counts of the word masked with the bits of the bit indices (so that sum(z) and sum(z^2)
+// need no loop over the set bits), and faces are the set bits of the XOR of a word with its neighbor along x, y or shifted along z.
+// The grid is split into slabs of constant y that are processed by worker threads; the partial sums are integers and are combined
+// in a fixed order, so the result does not depend on the number of threads. The measures of an empty grid are all zero.
+HRESULT ComputeVoxelAnalytics(const VoxelGridLayout& layout, const UINT32* voxels, VoxelAnalytics& analytics);
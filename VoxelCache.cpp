@@ -0,0 +1,437 @@
+//==============================================================================================================================================================
+// Content-addressed cache for voxelization results
+//==============================================================================================================================================================
+
+#include "VoxelCache.h"
+#include <algorithm>
+#include <cstring>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	const UINT32 c_fileMagic = 0x43584f56;		// "VOXC"
+	const UINT32 c_fileVersion = 2;			// version 2: 64-bit row stride and data size in VoxelGridLayout
+
+	// the voxel data directly follows the header, so that the mapped file can be used as is
+	struct VoxelCacheFileHeader {
+		UINT32 m_magic;
+		UINT32 m_version;
+		VoxelCacheKey m_key;
+		VoxelGridLayout m_layout;
+		UINT32 m_padding[2];
+	};
+	static_assert(sizeof(VoxelCacheFileHeader) == 64, "cache file header must keep the voxel data 64-byte aligned");
+
+	inline UINT64 RotateLeft(UINT64 x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline UINT64 FinalizationMix(UINT64 k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdull;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	inline UINT64 LoadLittleEndian64(const UINT8* p) {
+		UINT64 value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	const UINT64 c_murmurC1 = 0x87c37b91114253d5ull;
+	const UINT64 c_murmurC2 = 0x4cf5ad432745937full;
+
+	std::wstring KeyToString(const VoxelCacheKey& key) {
+		const WCHAR digits[] = L"0123456789abcdef";
+		std::wstring s(32, L'0');
+		for(int i = 0; i < 32; i++)
+			s[i] = digits[(key.m_hash[i >> 4] >> (60 - 4 * (i & 15))) & 15];
+		return s;
+	}
+
+	bool StringToKey(const WCHAR* s, VoxelCacheKey& key) {
+		key.m_hash[0] = key.m_hash[1] = 0;
+		for(int i = 0; i < 32; i++) {
+			UINT64 digit;
+			if(s[i] >= L'0' && s[i] <= L'9')
+				digit = s[i] - L'0';
+			else if(s[i] >= L'a' && s[i] <= L'f')
+				digit = s[i] - L'a' + 10;
+			else
+				return false;
+			key.m_hash[i >> 4] = (key.m_hash[i >> 4] << 4) | digit;
+		}
+		return true;
+	}
+
+	UINT64 FileTimeToUInt64(const FILETIME& ft) {
+		return (UINT64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	}
+
+}
+
+//==============================================================================================================================================================
+
+VoxelCacheKeyBuilder::VoxelCacheKeyBuilder()
+	: m_h1(0), m_h2(0), m_length(0), m_tailSize(0)
+{
+}
+
+void VoxelCacheKeyBuilder::ProcessBlock(UINT64 k1, UINT64 k2) {
+	k1 *= c_murmurC1; k1 = RotateLeft(k1, 31); k1 *= c_murmurC2; m_h1 ^= k1;
+	m_h1 = RotateLeft(m_h1, 27); m_h1 += m_h2; m_h1 = m_h1 * 5 + 0x52dce729;
+
+	k2 *= c_murmurC2; k2 = RotateLeft(k2, 33); k2 *= c_murmurC1; m_h2 ^= k2;
+	m_h2 = RotateLeft(m_h2, 31); m_h2 += m_h1; m_h2 = m_h2 * 5 + 0x38495ab5;
+}
+
+void VoxelCacheKeyBuilder::Add(const void* data, size_t size) {
+	const UINT8* p = reinterpret_cast<const UINT8*>(data);
+	m_length += size;
+
+	// complete pending partial block
+	if(m_tailSize > 0) {
+		const size_t count = std::min(size, size_t(16 - m_tailSize));
+		memcpy(m_tail + m_tailSize, p, count);
+		m_tailSize += UINT(count);
+		p += count;
+		size -= count;
+		if(m_tailSize < 16)
+			return;
+		ProcessBlock(LoadLittleEndian64(m_tail), LoadLittleEndian64(m_tail + 8));
+		m_tailSize = 0;
+	}
+
+	for(; size >= 16; p += 16, size -= 16)
+		ProcessBlock(LoadLittleEndian64(p), LoadLittleEndian64(p + 8));
+
+	memcpy(m_tail, p, size);
+	m_tailSize = UINT(size);
+}
+
+VoxelCacheKey VoxelCacheKeyBuilder::Finalize() const {
+	UINT64 h1 = m_h1;
+	UINT64 h2 = m_h2;
+
+	if(m_tailSize > 0) {
+		UINT8 tail[16] = { 0 };
+		memcpy(tail, m_tail, m_tailSize);
+		UINT64 k1 = LoadLittleEndian64(tail);
+		UINT64 k2 = LoadLittleEndian64(tail + 8);
+		k2 *= c_murmurC2; k2 = RotateLeft(k2, 33); k2 *= c_murmurC1; h2 ^= k2;
+		k1 *= c_murmurC1; k1 = RotateLeft(k1, 31); k1 *= c_murmurC2; h1 ^= k1;
+	}
+
+	h1 ^= m_length;
+	h2 ^= m_length;
+	h1 += h2;
+	h2 += h1;
+	h1 = FinalizationMix(h1);
+	h2 = FinalizationMix(h2);
+	h1 += h2;
+	h2 += h1;
+
+	VoxelCacheKey key;
+	key.m_hash[0] = h1;
+	key.m_hash[1] = h2;
+	return key;
+}
+
+//==============================================================================================================================================================
+
+CachedVoxelGrid::CachedVoxelGrid()
+	: m_data(nullptr), m_sizeInBytes(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_view(nullptr)
+{
+	memset(&m_layout, 0, sizeof(m_layout));
+}
+
+CachedVoxelGrid::~CachedVoxelGrid() {
+	if(m_view)
+		UnmapViewOfFile(m_view);
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	if(m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+}
+
+//==============================================================================================================================================================
+
+VoxelCache::VoxelCache()
+	: m_maxMemoryBytes(0), m_maxDiskBytes(0), m_memoryUsage(0), m_diskUsage(0)
+{
+}
+
+VoxelCache::~VoxelCache() {
+	Release();
+}
+
+HRESULT VoxelCache::Init(const WCHAR* directory, UINT64 maxMemoryBytes, UINT64 maxDiskBytes) {
+	Release();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_maxMemoryBytes = maxMemoryBytes;
+	m_maxDiskBytes = maxDiskBytes;
+
+	if(directory == nullptr || directory[0] == L'\0')
+		return S_OK;
+
+	if(!CreateDirectoryW(directory, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	m_directory = directory;
+
+	// index existing cache files, ordering them by their last use
+	struct FoundFile {
+		VoxelCacheKey m_key;
+		UINT64 m_size;
+		UINT64 m_lastUse;
+	};
+	std::vector<FoundFile> files;
+
+	WIN32_FIND_DATAW findData;
+	HANDLE find = FindFirstFileW((m_directory + L"\\*.vox").c_str(), &findData);
+	if(find != INVALID_HANDLE_VALUE) {
+		do {
+			FoundFile file;
+			if((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || wcslen(findData.cFileName) != 36 || !StringToKey(findData.cFileName, file.m_key))
+				continue;
+			file.m_size = (UINT64(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+			file.m_lastUse = FileTimeToUInt64(findData.ftLastWriteTime);
+			files.push_back(file);
+		} while(FindNextFileW(find, &findData));
+		FindClose(find);
+	}
+
+	std::sort(files.begin(), files.end(), [](const FoundFile& a, const FoundFile& b) { return a.m_lastUse > b.m_lastUse; });
+	for(std::vector<FoundFile>::const_iterator it = files.begin(); it != files.end(); ++it) {
+		m_diskLru.push_back(disk_entry_t(it->m_key, it->m_size));
+		m_diskIndex[it->m_key] = std::prev(m_diskLru.end());
+		m_diskUsage += it->m_size;
+	}
+
+	// enforce limit in case it was lowered since the last run
+	while(m_diskUsage > m_maxDiskBytes && !m_diskLru.empty())
+		RemoveFromDiskTier(m_diskLru.back().first);
+
+	return S_OK;
+}
+
+void VoxelCache::Release() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_memoryLru.clear();
+	m_memoryIndex.clear();
+	m_memoryUsage = 0;
+
+	m_diskLru.clear();
+	m_diskIndex.clear();
+	m_diskUsage = 0;
+
+	m_directory.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const CachedVoxelGrid> VoxelCache::Find(const VoxelCacheKey& key) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// in-memory tier
+	auto itMemory = m_memoryIndex.find(key);
+	if(itMemory != m_memoryIndex.end()) {
+		m_memoryLru.splice(m_memoryLru.begin(), m_memoryLru, itMemory->second);
+		auto itDisk = m_diskIndex.find(key);
+		if(itDisk != m_diskIndex.end())
+			m_diskLru.splice(m_diskLru.begin(), m_diskLru, itDisk->second);
+		return itMemory->second->second;
+	}
+
+	// on-disk tier
+	auto itDisk = m_diskIndex.find(key);
+	if(itDisk == m_diskIndex.end())
+		return nullptr;
+
+	std::shared_ptr<const CachedVoxelGrid> grid;
+	if(FAILED(MapFile(key, grid))) {
+		RemoveFromDiskTier(key);
+		return nullptr;
+	}
+
+	m_diskLru.splice(m_diskLru.begin(), m_diskLru, itDisk->second);
+	AddToMemoryTier(key, grid);
+	return grid;
+}
+
+HRESULT VoxelCache::Insert(const VoxelCacheKey& key, const VoxelGridLayout& layout, const UINT32* voxels, std::shared_ptr<const CachedVoxelGrid>* ppGrid) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::shared_ptr<const CachedVoxelGrid> grid;
+	if(m_directory.empty()) {
+		std::shared_ptr<CachedVoxelGrid> copy(new CachedVoxelGrid());
+		copy->m_layout = layout;
+		copy->m_copy.assign(voxels, voxels + layout.m_dataSize);
+		copy->m_data = copy->m_copy.data();
+		copy->m_sizeInBytes = layout.m_dataSize * sizeof(UINT32);
+		grid = copy;
+	} else {
+		HRESULT hr;
+		UINT64 fileSize;
+		RemoveFromDiskTier(key);
+		if(FAILED(hr = WriteFile(key, layout, voxels, fileSize)))
+			return hr;
+		AddToDiskTier(key, fileSize);
+		if(FAILED(hr = MapFile(key, grid)))
+			return hr;
+	}
+
+	AddToMemoryTier(key, grid);
+
+	if(ppGrid)
+		*ppGrid = grid;
+	return S_OK;
+}
+
+UINT64 VoxelCache::GetMemoryUsage() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_memoryUsage;
+}
+
+UINT64 VoxelCache::GetDiskUsage() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_diskUsage;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+std::wstring VoxelCache::GetFilePath(const VoxelCacheKey& key, const WCHAR* extension) const {
+	return m_directory + L"\\" + KeyToString(key) + extension;
+}
+
+HRESULT VoxelCache::MapFile(const VoxelCacheKey& key, std::shared_ptr<const CachedVoxelGrid>& grid) const {
+	std::shared_ptr<CachedVoxelGrid> mapped(new CachedVoxelGrid());
+
+	// share delete access so that eviction can remove files that are still mapped by a client
+	mapped->m_file = CreateFileW(GetFilePath(key, L".vox").c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(mapped->m_file == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(mapped->m_file, &fileSize) || UINT64(fileSize.QuadPart) < sizeof(VoxelCacheFileHeader))
+		return E_FAIL;
+
+	mapped->m_mapping = CreateFileMappingW(mapped->m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapped->m_mapping == nullptr)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	mapped->m_view = MapViewOfFile(mapped->m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if(mapped->m_view == nullptr)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	const VoxelCacheFileHeader* header = reinterpret_cast<const VoxelCacheFileHeader*>(mapped->m_view);
+	if(header->m_magic != c_fileMagic || header->m_version != c_fileVersion || !(header->m_key == key))
+		return E_FAIL;
+	if(UINT64(fileSize.QuadPart) != sizeof(VoxelCacheFileHeader) + header->m_layout.m_dataSize * sizeof(UINT32))
+		return E_FAIL;
+
+	mapped->m_layout = header->m_layout;
+	mapped->m_data = reinterpret_cast<const UINT32*>(header + 1);
+	mapped->m_sizeInBytes = UINT64(fileSize.QuadPart);
+
+	// record use so that the LRU order survives restarts
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	SetFileTime(mapped->m_file, nullptr, nullptr, &now);
+
+	grid = mapped;
+	return S_OK;
+}
+
+HRESULT VoxelCache::WriteFile(const VoxelCacheKey& key, const VoxelGridLayout& layout, const UINT32* voxels, UINT64& fileSize) const {
+	VoxelCacheFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.m_magic = c_fileMagic;
+	header.m_version = c_fileVersion;
+	header.m_key = key;
+	header.m_layout = layout;
+
+	// write to temporary file first so that readers never observe partially written grids
+	const std::wstring tempPath = GetFilePath(key, L".tmp");
+	HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	DWORD written;
+	bool success = ::WriteFile(file, &header, sizeof(header), &written, nullptr) && written == sizeof(header);
+
+	const UINT8* data = reinterpret_cast<const UINT8*>(voxels);
+	UINT64 remaining = layout.m_dataSize * sizeof(UINT32);
+	while(success && remaining > 0) {
+		const DWORD chunk = DWORD(std::min<UINT64>(remaining, 1u << 30));
+		success = ::WriteFile(file, data, chunk, &written, nullptr) && written == chunk;
+		data += chunk;
+		remaining -= chunk;
+	}
+
+	CloseHandle(file);
+
+	if(!success || !MoveFileExW(tempPath.c_str(), GetFilePath(key, L".vox").c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileW(tempPath.c_str());
+		return E_FAIL;
+	}
+
+	fileSize = sizeof(header) + layout.m_dataSize * sizeof(UINT32);
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void VoxelCache::AddToMemoryTier(const VoxelCacheKey& key, const std::shared_ptr<const CachedVoxelGrid>& grid) {
+	auto it = m_memoryIndex.find(key);
+	if(it != m_memoryIndex.end()) {
+		m_memoryUsage -= it->second->second->GetSizeInBytes();
+		m_memoryLru.erase(it->second);
+		m_memoryIndex.erase(it);
+	}
+
+	m_memoryLru.push_front(memory_entry_t(key, grid));
+	m_memoryIndex[key] = m_memoryLru.begin();
+	m_memoryUsage += grid->GetSizeInBytes();
+
+	// evicted grids stay valid for clients still holding a reference
+	while(m_memoryUsage > m_maxMemoryBytes && !m_memoryLru.empty()) {
+		m_memoryUsage -= m_memoryLru.back().second->GetSizeInBytes();
+		m_memoryIndex.erase(m_memoryLru.back().first);
+		m_memoryLru.pop_back();
+	}
+}
+
+void VoxelCache::AddToDiskTier(const VoxelCacheKey& key, UINT64 fileSize) {
+	m_diskLru.push_front(disk_entry_t(key, fileSize));
+	m_diskIndex[key] = m_diskLru.begin();
+	m_diskUsage += fileSize;
+
+	while(m_diskUsage > m_maxDiskBytes && m_diskLru.size() > 1)
+		RemoveFromDiskTier(m_diskLru.back().first);
+}
+
+void VoxelCache::RemoveFromDiskTier(const VoxelCacheKey& key) {
+	auto it = m_diskIndex.find(key);
+	if(it == m_diskIndex.end())
+		return;
+
+	DeleteFileW(GetFilePath(key, L".vox").c_str());
+
+	m_diskUsage -= it->second->second;
+	m_diskLru.erase(it->second);
+	m_diskIndex.erase(it);
+
+	auto itMemory = m_memoryIndex.find(key);
+	if(itMemory != m_memoryIndex.end()) {
+		m_memoryUsage -= itMemory->second->second->GetSizeInBytes();
+		m_memoryLru.erase(itMemory->second);
+		m_memoryIndex.erase(itMemory);
+	}
+}
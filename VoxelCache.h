@@ -0,0 +1,124 @@
+//==============================================================================================================================================================
+// Content-addressed cache for voxelization results
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//==============================================================================================================================================================
+
+// 128-bit digest identifying a voxelization by its inputs (mesh data, grid parameters, transforms, method)
+struct VoxelCacheKey {
+	UINT64 m_hash[2];
+};
+
+inline bool operator==(const VoxelCacheKey& a, const VoxelCacheKey& b) {
+	return a.m_hash[0] == b.m_hash[0] && a.m_hash[1] == b.m_hash[1];
+}
+
+// incremental MurmurHash3 (x64, 128 bit) over an arbitrary sequence of inputs
+class VoxelCacheKeyBuilder {
+public:
+	VoxelCacheKeyBuilder();
+
+	void Add(const void* data, size_t size);
+	template<typename T> void Add(const T& value) { Add(&value, sizeof(T)); }
+
+	VoxelCacheKey Finalize() const;
+
+private:
+	void ProcessBlock(UINT64 k1, UINT64 k2);
+
+	UINT64 m_h1;
+	UINT64 m_h2;
+	UINT64 m_length;
+	UINT8 m_tail[16];
+	UINT m_tailSize;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// read-only voxel grid, backed by a memory-mapped cache file (or by a private copy if the cache has no disk tier)
+class CachedVoxelGrid {
+public:
+	~CachedVoxelGrid();
+
+	const VoxelGridLayout& GetLayout() const { return m_layout; }
+	const UINT32* GetData() const { return m_data; }
+	UINT64 GetSizeInBytes() const { return m_sizeInBytes; }
+
+private:
+	friend class VoxelCache;
+	CachedVoxelGrid();
+	CachedVoxelGrid(const CachedVoxelGrid&) = delete;
+	CachedVoxelGrid& operator=(const CachedVoxelGrid&) = delete;
+
+	VoxelGridLayout m_layout;
+	const UINT32* m_data;
+	UINT64 m_sizeInBytes;
+
+	HANDLE m_file;
+	HANDLE m_mapping;
+	const void* m_view;
+	std::vector<UINT32> m_copy;
+};
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Two-tier LRU cache: recently used grids stay mapped in memory, all others live as files in the cache directory. Both tiers are
+// bounded by a size limit in bytes; the least recently used entries are evicted first. The cache is thread-safe.
+class VoxelCache {
+public:
+	VoxelCache();
+	~VoxelCache();
+
+	// directory may be nullptr, in which case only the in-memory tier is used
+	HRESULT Init(const WCHAR* directory, UINT64 maxMemoryBytes, UINT64 maxDiskBytes);
+	void Release();
+
+	// returns nullptr on a cache miss
+	std::shared_ptr<const CachedVoxelGrid> Find(const VoxelCacheKey& key);
+	HRESULT Insert(const VoxelCacheKey& key, const VoxelGridLayout& layout, const UINT32* voxels, std::shared_ptr<const CachedVoxelGrid>* ppGrid = nullptr);
+
+	UINT64 GetMemoryUsage() const;
+	UINT64 GetDiskUsage() const;
+
+private:
+	struct KeyHash {
+		size_t operator()(const VoxelCacheKey& key) const { return size_t(key.m_hash[0]); }
+	};
+
+	typedef std::pair<VoxelCacheKey, std::shared_ptr<const CachedVoxelGrid>> memory_entry_t;
+	typedef std::pair<VoxelCacheKey, UINT64> disk_entry_t;
+	typedef std::list<memory_entry_t> memory_lru_t;
+	typedef std::list<disk_entry_t> disk_lru_t;
+
+	std::wstring GetFilePath(const VoxelCacheKey& key, const WCHAR* extension) const;
+	HRESULT MapFile(const VoxelCacheKey& key, std::shared_ptr<const CachedVoxelGrid>& grid) const;
+	HRESULT WriteFile(const VoxelCacheKey& key, const VoxelGridLayout& layout, const UINT32* voxels, UINT64& fileSize) const;
+
+	void AddToMemoryTier(const VoxelCacheKey& key, const std::shared_ptr<const CachedVoxelGrid>& grid);
+	void AddToDiskTier(const VoxelCacheKey& key, UINT64 fileSize);
+	void RemoveFromDiskTier(const VoxelCacheKey& key);
+
+	mutable std::mutex m_mutex;
+
+	std::wstring m_directory;
+	UINT64 m_maxMemoryBytes;
+	UINT64 m_maxDiskBytes;
+
+	memory_lru_t m_memoryLru;			// most recently used entry first
+	std::unordered_map<VoxelCacheKey, memory_lru_t::iterator, KeyHash> m_memoryIndex;
+	UINT64 m_memoryUsage;
+
+	disk_lru_t m_diskLru;				// most recently used entry first
+	std::unordered_map<VoxelCacheKey, disk_lru_t::iterator, KeyHash> m_diskIndex;
+	UINT64 m_diskUsage;
+};
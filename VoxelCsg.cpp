@@ -0,0 +1,241 @@
+//==============================================================================================================================================================
+// Boolean operations between packed voxel grids
+//==============================================================================================================================================================
+
+#include "VoxelCsg.h"
+#include "Parallel.h"
+#include <emmintrin.h>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// words of a buffer handed to a worker thread at a time
+	const UINT64 c_chunkWords = 1 << 16;
+
+	// words scanned by an overlap test between checks whether another thread has found an overlap
+	const UINT64 c_overlapCheckWords = 1 << 10;
+
+	// overlap tests covering at most this many words (1 MiB) are scanned by the calling thread alone, since starting worker threads
+	// would take longer than the whole scan, and much longer than finding an overlap early on
+	const UINT64 c_serialOverlapWords = 1 << 18;
+
+	struct UnionOp {
+		static const bool c_clearsUncovered = false;
+		static UINT32 Apply(UINT32 a, UINT32 b) { return a | b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+	};
+
+	struct IntersectionOp {
+		static const bool c_clearsUncovered = true;
+		static UINT32 Apply(UINT32 a, UINT32 b) { return a & b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+	};
+
+	struct DifferenceOp {
+		static const bool c_clearsUncovered = false;
+		static UINT32 Apply(UINT32 a, UINT32 b) { return a & ~b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+	};
+
+	struct XorOp {
+		static const bool c_clearsUncovered = false;
+		static UINT32 Apply(UINT32 a, UINT32 b) { return a ^ b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+	};
+
+	inline __m128i Load(const UINT32* p) {
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	}
+
+	inline void Store(UINT32* p, __m128i v) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+	}
+
+	inline bool HasEqualLayoutAndNoOffset(const VoxelGridLayout& layoutA, const VoxelGridLayout& layoutB, const int offset[3]) {
+		return layoutA == layoutB && (offset == nullptr || (offset[0] == 0 && offset[1] == 0 && offset[2] == 0));
+	}
+
+	// mask of the bits of the last word of a column that lie inside of the grid
+	inline UINT32 GetLastWordMask(const VoxelGridLayout& layout) {
+		return ~0u >> (31 - ((layout.m_gridSize[2] - 1) & 31));
+	}
+
+	// voxels [zBegin, zBegin + 32) of a column as one word; voxels outside of the grid (including bits beyond its z extent) are empty
+	inline UINT32 LoadColumnBits(const VoxelGridLayout& layout, const UINT32* column, UINT32 lastMask, INT64 zBegin) {
+		const INT64 sizeZ = layout.m_gridSize[2];
+		if(zBegin <= -32 || zBegin >= sizeZ)
+			return 0;
+
+		auto loadWord = [&](INT64 w) -> UINT64 {
+			if(w < 0 || w * 32 >= sizeZ)
+				return 0;
+			return (w + 1) * 32 > sizeZ ? column[w] & lastMask : column[w];
+		};
+
+		const INT64 w = zBegin >= 0 ? zBegin >> 5 : -1;
+		const UINT shift = UINT(zBegin - w * 32);
+		return UINT32((loadWord(w) | (loadWord(w + 1) << 32)) >> shift);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// grids with equal layouts: word i of src is combined with word i of dst
+	template<typename Op>
+	void CombineWords(UINT64 numWords, UINT32* dst, const UINT32* src) {
+		ParallelFor(0, numWords, c_chunkWords, [&](UINT64 begin, UINT64 end) {
+			UINT64 i = begin;
+			for(; i + 4 <= end; i += 4)
+				Store(dst + i, Op::Apply(Load(dst + i), Load(src + i)));
+			for(; i < end; i++)
+				dst[i] = Op::Apply(dst[i], src[i]);
+		});
+	}
+
+	template<typename Op>
+	void CombineShifted(const VoxelGridLayout& dstLayout, UINT32* dst, const VoxelGridLayout& srcLayout, const UINT32* src, const int offset[3]) {
+		const UINT32 srcLastMask = GetLastWordMask(srcLayout);
+		const UINT64 rowsPerChunk = std::max<UINT64>(1, c_chunkWords / dstLayout.m_strideY);
+
+		ParallelFor(0, dstLayout.m_gridSize[1], rowsPerChunk, [&](UINT64 yBegin, UINT64 yEnd) {
+			for(UINT y = UINT(yBegin); y < UINT(yEnd); y++) {
+				const INT64 srcY = INT64(y) - offset[1];
+				for(UINT x = 0; x < dstLayout.m_gridSize[0]; x++) {
+					const INT64 srcX = INT64(x) - offset[0];
+					UINT32* column = dst + GetVoxelWordIndex(dstLayout, x, y, 0);
+
+					if(srcX < 0 || srcX >= srcLayout.m_gridSize[0] || srcY < 0 || srcY >= srcLayout.m_gridSize[1]) {
+						if(Op::c_clearsUncovered) {
+							for(UINT w = 0; w < dstLayout.m_strideX; w++)
+								column[w] = 0;
+						}
+						continue;
+					}
+
+					const UINT32* srcColumn = src + GetVoxelWordIndex(srcLayout, UINT(srcX), UINT(srcY), 0);
+					for(UINT w = 0; w < dstLayout.m_strideX; w++)
+						column[w] = Op::Apply(column[w], LoadColumnBits(srcLayout, srcColumn, srcLastMask, INT64(w) * 32 - offset[2]));
+				}
+			}
+		});
+	}
+
+	template<typename Op>
+	void Combine(const VoxelGridLayout& dstLayout, UINT32* dst, const VoxelGridLayout& srcLayout, const UINT32* src, const int offset[3]) {
+		if(HasEqualLayoutAndNoOffset(dstLayout, srcLayout, offset))
+			CombineWords<Op>(dstLayout.m_dataSize, dst, src);
+		else
+			CombineShifted<Op>(dstLayout, dst, srcLayout, src, offset);
+	}
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT ApplyVoxelCsg(VoxelCsgOp op, const VoxelGridLayout& dstLayout, UINT32* dst, const VoxelGridLayout& srcLayout, const UINT32* src, const int offset[3]) {
+	if(dstLayout.m_dataSize == 0)
+		return S_OK;
+	if(dst == nullptr || (src == nullptr && srcLayout.m_dataSize != 0))
+		return E_INVALIDARG;
+
+	const int noOffset[3] = { 0, 0, 0 };
+	if(offset == nullptr)
+		offset = noOffset;
+
+	switch(op) {
+		case VOXEL_CSG_UNION: Combine<UnionOp>(dstLayout, dst, srcLayout, src, offset); break;
+		case VOXEL_CSG_INTERSECTION: Combine<IntersectionOp>(dstLayout, dst, srcLayout, src, offset); break;
+		case VOXEL_CSG_DIFFERENCE: Combine<DifferenceOp>(dstLayout, dst, srcLayout, src, offset); break;
+		case VOXEL_CSG_XOR: Combine<XorOp>(dstLayout, dst, srcLayout, src, offset); break;
+		default: return E_INVALIDARG;
+	}
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+bool DoVoxelGridsOverlap(const VoxelGridLayout& layoutA, const UINT32* a, const VoxelGridLayout& layoutB, const UINT32* b, const int offset[3]) {
+	if(layoutA.m_dataSize == 0 || layoutB.m_dataSize == 0 || a == nullptr || b == nullptr)
+		return false;
+
+	const UINT32 lastMaskA = GetLastWordMask(layoutA);
+	std::atomic<bool> found(false);
+
+	if(HasEqualLayoutAndNoOffset(layoutA, layoutB, offset)) {
+		const UINT numWords = layoutA.m_strideX;
+		auto scanWords = [&](UINT64 begin, UINT64 end) {
+			for(UINT64 blockBegin = begin; blockBegin < end && !found.load(std::memory_order_relaxed); blockBegin += c_overlapCheckWords) {
+				const UINT64 blockEnd = std::min(blockBegin + c_overlapCheckWords, end);
+
+				// words with common bits are rare until an overlap is found; only then the bits beyond the z extent are masked
+				auto testWord = [&](UINT64 i) {
+					const UINT32 common = a[i] & b[i];
+					return common != 0 && (i % numWords + 1 < numWords || (common & lastMaskA) != 0);
+				};
+
+				UINT64 i = blockBegin;
+				for(; i + 4 <= blockEnd; i += 4) {
+					const __m128i common = _mm_and_si128(Load(a + i), Load(b + i));
+					if(_mm_movemask_epi8(_mm_cmpeq_epi32(common, _mm_setzero_si128())) == 0xffff)
+						continue;
+					if(testWord(i) || testWord(i + 1) || testWord(i + 2) || testWord(i + 3)) {
+						found = true;
+						return;
+					}
+				}
+				for(; i < blockEnd; i++) {
+					if(testWord(i)) {
+						found = true;
+						return;
+					}
+				}
+			}
+		};
+
+		if(layoutA.m_dataSize <= c_serialOverlapWords)
+			scanWords(0, layoutA.m_dataSize);
+		else
+			ParallelFor(0, layoutA.m_dataSize, c_chunkWords, scanWords);
+		return found;
+	}
+
+	const int noOffset[3] = { 0, 0, 0 };
+	if(offset == nullptr)
+		offset = noOffset;
+
+	// region of a covered by b
+	INT64 begin[3], end[3];
+	for(UINT i = 0; i < 3; i++) {
+		begin[i] = std::max<INT64>(0, offset[i]);
+		end[i] = std::min<INT64>(layoutA.m_gridSize[i], INT64(layoutB.m_gridSize[i]) + offset[i]);
+		if(begin[i] >= end[i])
+			return false;
+	}
+
+	const UINT32 lastMaskB = GetLastWordMask(layoutB);
+	const UINT wBegin = UINT(begin[2] >> 5);
+	const UINT wEnd = UINT((end[2] + 31) >> 5);
+	const UINT64 rowWords = UINT64(end[0] - begin[0]) * (wEnd - wBegin);
+	auto scanRows = [&](UINT64 yBegin, UINT64 yEnd) {
+		for(UINT y = UINT(yBegin); y < UINT(yEnd) && !found.load(std::memory_order_relaxed); y++) {
+			for(UINT x = UINT(begin[0]); x < UINT(end[0]); x++) {
+				const UINT32* columnA = a + GetVoxelWordIndex(layoutA, x, y, 0);
+				const UINT32* columnB = b + GetVoxelWordIndex(layoutB, UINT(x - offset[0]), UINT(y - offset[1]), 0);
+				for(UINT w = wBegin; w < wEnd; w++) {
+					const UINT32 wordA = w + 1 < layoutA.m_strideX ? columnA[w] : columnA[w] & lastMaskA;
+					if(wordA != 0 && (wordA & LoadColumnBits(layoutB, columnB, lastMaskB, INT64(w) * 32 - offset[2])) != 0) {
+						found = true;
+						return;
+					}
+				}
+			}
+		}
+	};
+
+	if(rowWords * UINT64(end[1] - begin[1]) <= c_serialOverlapWords)
+		scanRows(begin[1], end[1]);
+	else
+		ParallelFor(begin[1], end[1], std::max<UINT64>(1, c_chunkWords / rowWords), scanRows);
+	return found;
+}
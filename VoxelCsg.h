@@ -0,0 +1,31 @@
+//==============================================================================================================================================================
+// Boolean operations between packed voxel grids
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//==============================================================================================================================================================
+
+enum VoxelCsgOp {
+	VOXEL_CSG_UNION,					// dst | src
+	VOXEL_CSG_INTERSECTION,				// dst & src
+	VOXEL_CSG_DIFFERENCE,				// dst & ~src
+	VOXEL_CSG_XOR,						// dst ^ src
+};
+
+// Combines src into dst, both in the layout of the voxelization buffer. Voxel (x, y, z) of src is aligned with voxel (x + offset[0],
+// y + offset[1], z + offset[2]) of dst, where offset = nullptr stands for no offset; voxels of src outside of dst are ignored, and
+// voxels of dst not covered by src are combined with empty ones (so an intersection clears them). Grids voxelized with the same
+// SetupVoxelization parameters have equal layouts and zero offset, in which case the word buffers are combined directly with SSE2;
+// otherwise, each word of dst is combined with the 32 voxels of the corresponding src column, which are funnel-shifted from two
+// src words if offset[2] is not a multiple of 32. Rows of dst are distributed across worker threads. src and dst may be the same
+// buffer only if the layouts are equal and the offset is zero. Bits beyond the z extent of dst are undefined afterwards.
+HRESULT ApplyVoxelCsg(VoxelCsgOp op, const VoxelGridLayout& dstLayout, UINT32* dst, const VoxelGridLayout& srcLayout, const UINT32* src, const int offset[3] = nullptr);
+
+// Returns whether any voxel is set in both a and b, with b aligned to a as src to dst above. Only the region covered by both grids
+// is visited, and the scan stops at the first common voxel, so interference between parts is usually detected long before the
+// grids have been read completely. Regions of up to 1 MiB are scanned by the calling thread alone; larger ones are split across
+// worker threads.
+bool DoVoxelGridsOverlap(const VoxelGridLayout& layoutA, const UINT32* a, const VoxelGridLayout& layoutB, const UINT32* b, const int offset[3] = nullptr);
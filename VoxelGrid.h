@@ -0,0 +1,49 @@
+//==============================================================================================================================================================
+// CPU-side description of the packed voxel grid layout shared with the voxelization shaders
+//==============================================================================================================================================================
+
+#pragma once
+
+#include <Windows.h>
+
+//==============================================================================================================================================================
+
+// One bit per voxel, with 32 consecutive voxels along z packed into one 32-bit word. Words are ordered z-fastest, then x, then y,
+// i.e. voxel (x, y, z) is bit (z & 31) of word x * m_strideX + y * m_strideY + (z >> 5). This is exactly the layout of the
+// voxelization buffer, so grids can be copied between the GPU and the CPU without any conversion. Row stride and size are 64-bit
+// so that grids beyond 4 GiB (e.g. dense 4096^3) can be addressed; use GetVoxelWordIndex rather than 32-bit arithmetic.
+struct VoxelGridLayout {
+	UINT m_gridSize[3];
+	UINT m_strideX;					// in words
+	UINT64 m_strideY;				// in words
+	UINT64 m_dataSize;				// in words
+};
+
+inline VoxelGridLayout MakeVoxelGridLayout(UINT gridSizeX, UINT gridSizeY, UINT gridSizeZ) {
+	VoxelGridLayout layout;
+	layout.m_gridSize[0] = gridSizeX;
+	layout.m_gridSize[1] = gridSizeY;
+	layout.m_gridSize[2] = gridSizeZ;
+	layout.m_strideX = (gridSizeZ + 31) / 32;
+	layout.m_strideY = UINT64(layout.m_strideX) * gridSizeX;
+	layout.m_dataSize = layout.m_strideY * gridSizeY;
+	return layout;
+}
+
+inline bool operator==(const VoxelGridLayout& a, const VoxelGridLayout& b) {
+	return a.m_gridSize[0] == b.m_gridSize[0] && a.m_gridSize[1] == b.m_gridSize[1] && a.m_gridSize[2] == b.m_gridSize[2]
+		&& a.m_strideX == b.m_strideX && a.m_strideY == b.m_strideY && a.m_dataSize == b.m_dataSize;
+}
+
+inline bool operator!=(const VoxelGridLayout& a, const VoxelGridLayout& b) {
+	return !(a == b);
+}
+
+// index of word w of the column at (x, y)
+inline UINT64 GetVoxelWordIndex(const VoxelGridLayout& layout, UINT x, UINT y, UINT w) {
+	return UINT64(x) * layout.m_strideX + y * layout.m_strideY + w;
+}
+
+inline bool IsVoxelSet(const VoxelGridLayout& layout, const UINT32* voxels, UINT x, UINT y, UINT z) {
+	return (voxels[GetVoxelWordIndex(layout, x, y, z >> 5)] & (1u << (z & 31))) != 0u;
+}
@@ -0,0 +1,215 @@
+//==============================================================================================================================================================
+// NUMA-aware, large-page backed memory for voxel grids
+//==============================================================================================================================================================
+
+#include "VoxelMemory.h"
+#include "Parallel.h"
+#include <cstring>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// smaller allocations stay on one node, as starting the pinned workers would cost more than remote accesses
+	const UINT64 c_minNumaBytes = 64ull << 20;
+
+	const UINT64 c_smallPageSize = 4096;
+
+	// pages touched or cleared by a worker at once
+	const UINT64 c_pagesPerChunk = 256;
+
+	// Enables SeLockMemoryPrivilege for the process, which large pages require; returns the large page size if the account holds
+	// the privilege, and 0 otherwise. AdjustTokenPrivileges succeeds without enabling privileges that are not held, reporting
+	// ERROR_NOT_ALL_ASSIGNED.
+	UINT64 EnableLargePages() {
+		const SIZE_T pageSize = GetLargePageMinimum();
+		if(pageSize == 0)
+			return 0;
+
+		HANDLE token;
+		if(!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return 0;
+
+		TOKEN_PRIVILEGES privileges = {};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		const bool enabled = LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)
+			&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+		CloseHandle(token);
+		return enabled ? UINT64(pageSize) : 0;
+	}
+
+	UINT64 GetLargePageSize() {
+		static const UINT64 pageSize = EnableLargePages();
+		return pageSize;
+	}
+
+	// byte offsets of the nodes' blocks when splitting numRows rows evenly, rounded down to pages; the last one is the size rounded up
+	std::vector<UINT64> SplitRows(UINT64 rowBytes, UINT64 numRows, UINT numNodes, UINT64 pageSize) {
+		std::vector<UINT64> nodeBytes(numNodes + 1);
+		for(UINT n = 0; n < numNodes; n++)
+			nodeBytes[n] = rowBytes * (numRows * n / numNodes) / pageSize * pageSize;
+		nodeBytes[numNodes] = (rowBytes * numRows + pageSize - 1) / pageSize * pageSize;
+		return nodeBytes;
+	}
+
+}
+
+//==============================================================================================================================================================
+
+VoxelMemory::VoxelMemory()
+	: m_data(nullptr), m_size(0), m_rowBytes(0), m_largePages(false)
+{
+}
+
+VoxelMemory::VoxelMemory(VoxelMemory&& other)
+	: m_data(other.m_data), m_size(other.m_size), m_rowBytes(other.m_rowBytes), m_largePages(other.m_largePages),
+	  m_nodeRows(std::move(other.m_nodeRows)), m_allocations(std::move(other.m_allocations))
+{
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_allocations.clear();
+	other.m_nodeRows.clear();
+}
+
+VoxelMemory& VoxelMemory::operator=(VoxelMemory&& other) {
+	if(this != &other) {
+		Free();
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_rowBytes = other.m_rowBytes;
+		m_largePages = other.m_largePages;
+		m_nodeRows.swap(other.m_nodeRows);
+		m_allocations.swap(other.m_allocations);
+		other.m_data = nullptr;
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+VoxelMemory::~VoxelMemory() {
+	Free();
+}
+
+HRESULT VoxelMemory::Allocate(UINT64 rowBytes, UINT64 numRows) {
+	Free();
+
+	const UINT64 size = rowBytes * numRows;
+	if(size == 0)
+		return S_OK;
+
+	const std::vector<NumaNode>& nodes = GetNumaNodes();
+	const UINT numNodes = (nodes.size() > 1 && size >= c_minNumaBytes) ? UINT(nodes.size()) : 1;
+
+	try {
+		m_allocations.reserve(numNodes);
+		if(numNodes > 1)
+			m_nodeRows.resize(numNodes + 1);
+	} catch(const std::bad_alloc&) {
+		Free();
+		return E_OUTOFMEMORY;
+	}
+
+	// large pages are allocated with their physical memory, so they are placed explicitly rather than by touching them
+	std::vector<UINT64> nodeBytes;
+	const UINT64 largePageSize = GetLargePageSize();
+	if(largePageSize != 0 && size >= largePageSize) {
+		nodeBytes = SplitRows(rowBytes, numRows, numNodes, largePageSize);
+		m_largePages = SUCCEEDED(AllocateLargePages(nodeBytes, largePageSize));
+	}
+
+	if(!m_largePages) {
+		nodeBytes = SplitRows(rowBytes, numRows, numNodes, c_smallPageSize);
+		void* data = VirtualAlloc(nullptr, SIZE_T(size), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		if(data == nullptr) {
+			Free();
+			return E_OUTOFMEMORY;
+		}
+		m_allocations.push_back(data);
+		m_data = static_cast<UINT8*>(data);
+	}
+
+	m_size = size;
+	m_rowBytes = rowBytes;
+	if(numNodes > 1) {
+		// a row belongs to the node whose block contains its first byte
+		for(UINT n = 0; n <= numNodes; n++)
+			m_nodeRows[n] = std::min(numRows, (nodeBytes[n] + rowBytes - 1) / rowBytes);
+
+		// first touch by the node's workers places the pages of its rows on it
+		if(!m_largePages) {
+			std::vector<UINT64> nodePages(numNodes + 1);
+			for(UINT n = 0; n <= numNodes; n++)
+				nodePages[n] = nodeBytes[n] / c_smallPageSize;
+			ParallelForNuma(nodePages.data(), c_pagesPerChunk, [&](UINT node, UINT64 begin, UINT64 end) {
+				for(UINT64 page = begin; page < end; page++)
+					m_data[page * c_smallPageSize] = 0;
+			}, false);
+		}
+	}
+
+	return S_OK;
+}
+
+// The nodes' blocks are allocated separately at consecutive addresses of a range that has been reserved to find free address space
+// and released again; fails if another thread allocates in that range meanwhile, or if not enough large pages are available.
+HRESULT VoxelMemory::AllocateLargePages(const std::vector<UINT64>& nodeBytes, UINT64 pageSize) {
+	const std::vector<NumaNode>& nodes = GetNumaNodes();
+	const UINT numNodes = UINT(nodeBytes.size() - 1);
+
+	if(numNodes == 1) {
+		void* data = VirtualAlloc(nullptr, SIZE_T(nodeBytes[1]), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if(data == nullptr)
+			return E_OUTOFMEMORY;
+		m_allocations.push_back(data);
+		m_data = static_cast<UINT8*>(data);
+		return S_OK;
+	}
+
+	void* reserved = VirtualAlloc(nullptr, SIZE_T(nodeBytes[numNodes] + pageSize), MEM_RESERVE, PAGE_NOACCESS);
+	if(reserved == nullptr)
+		return E_OUTOFMEMORY;
+	UINT8* base = reinterpret_cast<UINT8*>((UINT_PTR(reserved) + UINT_PTR(pageSize) - 1) & ~(UINT_PTR(pageSize) - 1));
+	VirtualFree(reserved, 0, MEM_RELEASE);
+
+	for(UINT n = 0; n < numNodes; n++) {
+		if(nodeBytes[n + 1] == nodeBytes[n])
+			continue;
+		void* block = VirtualAllocExNuma(GetCurrentProcess(), base + nodeBytes[n], SIZE_T(nodeBytes[n + 1] - nodeBytes[n]),
+			MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, nodes[n].m_nodeNumber);
+		if(block == nullptr) {
+			for(void* allocation : m_allocations)
+				VirtualFree(allocation, 0, MEM_RELEASE);
+			m_allocations.clear();
+			return E_OUTOFMEMORY;
+		}
+		m_allocations.push_back(block);
+	}
+
+	m_data = base;
+	return S_OK;
+}
+
+void VoxelMemory::Free() {
+	for(void* allocation : m_allocations)
+		VirtualFree(allocation, 0, MEM_RELEASE);
+	m_allocations.clear();
+	m_nodeRows.clear();
+	m_data = nullptr;
+	m_size = 0;
+	m_rowBytes = 0;
+	m_largePages = false;
+}
+
+void VoxelMemory::Clear() {
+	if(m_nodeRows.empty()) {
+		if(m_size > 0)
+			memset(m_data, 0, size_t(m_size));
+		return;
+	}
+
+	const UINT64 rowsPerChunk = std::max<UINT64>(1, c_pagesPerChunk * c_smallPageSize / m_rowBytes);
+	ParallelForNuma(m_nodeRows.data(), rowsPerChunk, [&](UINT node, UINT64 begin, UINT64 end) {
+		memset(m_data + begin * m_rowBytes, 0, size_t((end - begin) * m_rowBytes));
+	}, false);
+}
@@ -0,0 +1,49 @@
+//==============================================================================================================================================================
+// NUMA-aware, large-page backed memory for voxel grids
+//==============================================================================================================================================================
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+
+//==============================================================================================================================================================
+
+// Zero-initialized memory for numRows rows (the Y-slabs of a grid) of rowBytes each. On machines with several NUMA nodes, large
+// allocations are split into one block of consecutive rows per node of GetNumaNodes(), each placed on its node: by the node's
+// pinned workers touching its pages first, or explicitly when using large pages. Large (2 MiB) pages, which reduce TLB misses on
+// scattered voxel writes, are used if the process may lock pages in memory (SeLockMemoryPrivilege) and enough contiguous physical
+// memory is available; otherwise, the allocation falls back to regular pages.
+class VoxelMemory {
+public:
+	VoxelMemory();
+	VoxelMemory(VoxelMemory&& other);
+	VoxelMemory& operator=(VoxelMemory&& other);
+	~VoxelMemory();
+
+	VoxelMemory(const VoxelMemory&) = delete;
+	VoxelMemory& operator=(const VoxelMemory&) = delete;
+
+	HRESULT Allocate(UINT64 rowBytes, UINT64 numRows);
+	void Free();
+
+	// zeroes the memory by the workers of each row's node
+	void Clear();
+
+	void* GetData() const { return m_data; }
+	UINT64 GetSize() const { return m_size; }
+	bool UsesLargePages() const { return m_largePages; }
+
+	// rows [nodeRows[node], nodeRows[node + 1]) are placed on node; empty if the memory is not split across nodes
+	const std::vector<UINT64>& GetNodeRows() const { return m_nodeRows; }
+
+private:
+	HRESULT AllocateLargePages(const std::vector<UINT64>& nodeBytes, UINT64 pageSize);
+
+	UINT8* m_data;
+	UINT64 m_size;
+	UINT64 m_rowBytes;
+	bool m_largePages;
+	std::vector<UINT64> m_nodeRows;
+	std::vector<void*> m_allocations;		// one per node with large pages, as those are allocated separately
+};
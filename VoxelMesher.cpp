@@ -0,0 +1,355 @@
+//==============================================================================================================================================================
+// Extraction of low-polygon meshes from packed voxel grids by greedy meshing
+//==============================================================================================================================================================
+
+#include "VoxelMesher.h"
+#include "BitOps.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include <cstdio>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// axis-aligned rectangle on a face plane: m_min[axis] == m_max[axis] is the plane's position
+	struct Quad {
+		UINT16 m_min[3];
+		UINT16 m_max[3];
+		UINT16 m_face;
+	};
+
+	// first bit at or after begin that is not set (at most 32 * numWords)
+	UINT FindRunEnd(const UINT32* row, UINT numWords, UINT begin) {
+		UINT w = begin >> 5;
+		UINT32 clear = ~row[w] & (~0u << (begin & 31));
+		while(clear == 0u) {
+			if(++w == numWords)
+				return numWords * 32;
+			clear = ~row[w];
+		}
+		return w * 32 + LowestSetBit(clear);
+	}
+
+	bool IsRangeSet(const UINT32* row, UINT begin, UINT end) {
+		const UINT firstWord = begin >> 5;
+		const UINT lastWord = (end - 1) >> 5;
+		for(UINT w = firstWord; w <= lastWord; w++) {
+			const UINT32 mask = BitRangeMask(w == firstWord ? begin & 31 : 0, w == lastWord ? ((end - 1) & 31) + 1 : 32);
+			if((row[w] & mask) != mask)
+				return false;
+		}
+		return true;
+	}
+
+	void ClearRange(UINT32* row, UINT begin, UINT end) {
+		const UINT firstWord = begin >> 5;
+		const UINT lastWord = (end - 1) >> 5;
+		for(UINT w = firstWord; w <= lastWord; w++)
+			row[w] &= ~BitRangeMask(w == firstWord ? begin & 31 : 0, w == lastWord ? ((end - 1) & 31) + 1 : 32);
+	}
+
+	// Greedily covers the set bits of a bit matrix (numRows rows of numWords words, consumed in the process) by rectangles: each run of
+	// set bits within a row is extended over the following rows as long as they contain the entire run. Calls
+	// emit(rowBegin, rowEnd, bitBegin, bitEnd) for each rectangle.
+	template<typename Func>
+	void MergeRectangles(UINT32* bits, UINT numRows, UINT numWords, const Func& emit) {
+		for(UINT r = 0; r < numRows; r++) {
+			UINT32* row = bits + r * numWords;
+			for(UINT w = 0; w < numWords; w++) {
+				while(row[w] != 0u) {
+					const UINT begin = w * 32 + LowestSetBit(row[w]);
+					const UINT end = FindRunEnd(row, numWords, begin);
+					ClearRange(row, begin, end);
+
+					UINT rowEnd = r + 1;
+					for(; rowEnd < numRows && IsRangeSet(row + (rowEnd - r) * numWords, begin, end); rowEnd++)
+						ClearRange(row + (rowEnd - r) * numWords, begin, end);
+
+					emit(r, rowEnd, begin, end);
+				}
+			}
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	class GreedyMesher {
+	public:
+		GreedyMesher(const VoxelGridLayout& layout, const UINT32* voxels)
+			: m_layout(layout), m_voxels(voxels)
+		{
+			m_lastWord = (layout.m_gridSize[2] - 1) >> 5;
+			m_lastMask = ~0u >> (31 - ((layout.m_gridSize[2] - 1) & 31));
+			m_zWordsPerRow = (layout.m_gridSize[0] + 31) / 32;
+			m_zSliceSize = m_zWordsPerRow * layout.m_gridSize[1];
+		}
+
+		// the faces perpendicular to z need to be transposed by PrepareSlicesZ before the slices are meshed
+		HRESULT AllocateSlicesZ() {
+			try {
+				m_zFaces.resize(2 * size_t(m_lastWord + 1) * 32 * m_zSliceSize);
+			} catch(const std::bad_alloc&) {
+				return E_OUTOFMEMORY;
+			}
+			return S_OK;
+		}
+
+		// Finds the faces perpendicular to z of row y by shifting the words of each column, and transposes blocks of 32 columns so that
+		// the faces end up in one bit matrix per z slice, with rows y and bits x. All words of a block of columns are processed together,
+		// so the grid is read only once.
+		void PrepareSlicesZ(UINT y) {
+			const UINT32* row = m_voxels + y * m_layout.m_strideY;
+			UINT32 blocks[2][32];
+			for(UINT xw = 0; xw < m_zWordsPerRow; xw++) {
+				const UINT numColumns = std::min(32u, m_layout.m_gridSize[0] - xw * 32);
+				for(UINT w = 0; w <= m_lastWord; w++) {
+					UINT32 any = 0u;
+					for(UINT i = 0; i < numColumns; i++) {
+						const UINT32* column = row + (xw * 32 + i) * m_layout.m_strideX;
+						const UINT32 voxels = GetWord(column, w);
+						const UINT32 prev = w > 0 ? column[w - 1] : 0u;
+						const UINT32 next = w < m_lastWord ? GetWord(column, w + 1) : 0u;
+						blocks[0][i] = voxels & ~((voxels >> 1) | (next << 31));
+						blocks[1][i] = voxels & ~((voxels << 1) | (prev >> 31));
+						any |= voxels;
+					}
+					for(UINT i = numColumns; i < 32; i++)
+						blocks[0][i] = blocks[1][i] = 0u;
+					if(any == 0u)
+						continue;
+
+					for(UINT face = 0; face < 2; face++) {
+						Transpose32x32(blocks[face]);
+						UINT32* slices = GetSliceZ(face, w * 32) + y * m_zWordsPerRow + xw;
+						for(UINT i = 0; i < 32; i++)
+							slices[i * m_zSliceSize] = blocks[face][i];
+					}
+				}
+			}
+		}
+
+		// tasks are the x, y and z slices, each for both face orientations
+		UINT GetNumTasks() const {
+			return 2 * (m_layout.m_gridSize[0] + m_layout.m_gridSize[1] + m_layout.m_gridSize[2]);
+		}
+
+		void RunTask(UINT task, std::vector<Quad>& quads) {
+			const UINT face = task & 1;
+			UINT slice = task >> 1;
+			if(slice < m_layout.m_gridSize[0]) {
+				MeshSliceX(slice, face == 0, quads);
+				return;
+			}
+			slice -= m_layout.m_gridSize[0];
+			if(slice < m_layout.m_gridSize[1]) {
+				MeshSliceY(slice, face == 0, quads);
+				return;
+			}
+			slice -= m_layout.m_gridSize[1];
+			MeshSliceZ(slice, face == 0, quads);
+		}
+
+	private:
+		// word w of a column, with the bits beyond the grid cleared
+		UINT32 GetWord(const UINT32* column, UINT w) const {
+			return w == m_lastWord ? column[w] & m_lastMask : column[w];
+		}
+
+		// faces of a column not covered by the neighboring column, which is nullptr outside of the grid
+		void FindExposedFaces(const UINT32* column, const UINT32* neighbor, UINT32* faces) const {
+			for(UINT w = 0; w <= m_lastWord; w++)
+				faces[w] = neighbor != nullptr ? column[w] & ~neighbor[w] : column[w];
+			faces[m_lastWord] &= m_lastMask;
+		}
+
+		UINT32* GetSliceZ(UINT face, UINT z) {
+			return &m_zFaces[(size_t(face) * (m_lastWord + 1) * 32 + z) * m_zSliceSize];
+		}
+
+		static void AddQuad(std::vector<Quad>& quads, UINT face, UINT axis, UINT position, UINT bBegin, UINT bEnd, UINT cBegin, UINT cEnd) {
+			// b and c are the other two axes such that (axis, b, c) is right-handed
+			const UINT b = (axis + 1) % 3;
+			const UINT c = (axis + 2) % 3;
+			Quad quad;
+			quad.m_min[axis] = quad.m_max[axis] = UINT16(position);
+			quad.m_min[b] = UINT16(bBegin);
+			quad.m_max[b] = UINT16(bEnd);
+			quad.m_min[c] = UINT16(cBegin);
+			quad.m_max[c] = UINT16(cEnd);
+			quad.m_face = UINT16(face);
+			quads.push_back(quad);
+		}
+
+		// faces perpendicular to x: rows are y, bits are z
+		void MeshSliceX(UINT x, bool positive, std::vector<Quad>& quads) const {
+			const UINT numWords = m_lastWord + 1;
+			const UINT neighbor = positive ? x + 1 : x - 1;
+			const bool hasNeighbor = neighbor < m_layout.m_gridSize[0];
+			std::vector<UINT32> bits(m_layout.m_gridSize[1] * numWords);
+			for(UINT y = 0; y < m_layout.m_gridSize[1]; y++) {
+				const UINT32* row = m_voxels + y * m_layout.m_strideY;
+				FindExposedFaces(row + x * m_layout.m_strideX, hasNeighbor ? row + neighbor * m_layout.m_strideX : nullptr, &bits[y * numWords]);
+			}
+
+			const UINT face = positive ? VOXEL_FACE_POS_X : VOXEL_FACE_NEG_X;
+			const UINT position = positive ? x + 1 : x;
+			MergeRectangles(bits.data(), m_layout.m_gridSize[1], numWords, [&](UINT rowBegin, UINT rowEnd, UINT bitBegin, UINT bitEnd) {
+				AddQuad(quads, face, 0, position, rowBegin, rowEnd, bitBegin, bitEnd);
+			});
+		}
+
+		// faces perpendicular to y: rows are x, bits are z
+		void MeshSliceY(UINT y, bool positive, std::vector<Quad>& quads) const {
+			const UINT numWords = m_lastWord + 1;
+			const UINT neighbor = positive ? y + 1 : y - 1;
+			const UINT32* row = m_voxels + y * m_layout.m_strideY;
+			const UINT32* neighborRow = neighbor < m_layout.m_gridSize[1] ? m_voxels + neighbor * m_layout.m_strideY : nullptr;
+			std::vector<UINT32> bits(m_layout.m_gridSize[0] * numWords);
+			for(UINT x = 0; x < m_layout.m_gridSize[0]; x++) {
+				const UINT offset = x * m_layout.m_strideX;
+				FindExposedFaces(row + offset, neighborRow != nullptr ? neighborRow + offset : nullptr, &bits[x * numWords]);
+			}
+
+			const UINT face = positive ? VOXEL_FACE_POS_Y : VOXEL_FACE_NEG_Y;
+			const UINT position = positive ? y + 1 : y;
+			MergeRectangles(bits.data(), m_layout.m_gridSize[0], numWords, [&](UINT rowBegin, UINT rowEnd, UINT bitBegin, UINT bitEnd) {
+				AddQuad(quads, face, 1, position, bitBegin, bitEnd, rowBegin, rowEnd);
+			});
+		}
+
+		// faces perpendicular to z, as prepared by PrepareSlicesZ: rows are y, bits are x
+		void MeshSliceZ(UINT z, bool positive, std::vector<Quad>& quads) {
+			const UINT face = positive ? VOXEL_FACE_POS_Z : VOXEL_FACE_NEG_Z;
+			const UINT position = positive ? z + 1 : z;
+			MergeRectangles(GetSliceZ(positive ? 0 : 1, z), m_layout.m_gridSize[1], m_zWordsPerRow, [&](UINT rowBegin, UINT rowEnd, UINT bitBegin, UINT bitEnd) {
+				AddQuad(quads, face, 2, position, bitBegin, bitEnd, rowBegin, rowEnd);
+			});
+		}
+
+		const VoxelGridLayout& m_layout;
+		const UINT32* m_voxels;
+		UINT m_lastWord;
+		UINT32 m_lastMask;
+		UINT m_zWordsPerRow;
+		UINT m_zSliceSize;
+		std::vector<UINT32> m_zFaces;			// transposed faces perpendicular to z, for both orientations
+	};
+
+}
+
+//==============================================================================================================================================================
+
+HRESULT ExtractVoxelMesh(const VoxelGridLayout& layout, const UINT32* voxels, VoxelMesh& mesh) {
+	PROFILE_SCOPE("Extract mesh");
+
+	mesh.m_vertices.clear();
+	mesh.m_indices.clear();
+
+	if(voxels == nullptr)
+		return E_INVALIDARG;
+	for(UINT i = 0; i < 3; i++) {
+		if(layout.m_gridSize[i] > 65535)
+			return E_INVALIDARG;
+		if(layout.m_gridSize[i] == 0)
+			return S_OK;
+	}
+
+	HRESULT hr;
+
+	GreedyMesher mesher(layout, voxels);
+	if(FAILED(hr = mesher.AllocateSlicesZ()))
+		return hr;
+
+	ParallelFor(0, layout.m_gridSize[1], 16, [&](UINT64 begin, UINT64 end) {
+		for(UINT64 y = begin; y < end; y++)
+			mesher.PrepareSlicesZ(UINT(y));
+	});
+
+	const UINT numTasks = mesher.GetNumTasks();
+
+	std::vector<std::vector<Quad>> taskQuads(numTasks);
+	ParallelFor(0, numTasks, 1, [&](UINT64 begin, UINT64 end) {
+		PROFILE_SCOPE("Merge quads");
+		for(UINT64 task = begin; task < end; task++)
+			mesher.RunTask(UINT(task), taskQuads[task]);
+	});
+
+	// place the quads of each task consecutively
+	std::vector<UINT64> firstQuad(numTasks + 1, 0);
+	for(UINT task = 0; task < numTasks; task++)
+		firstQuad[task + 1] = firstQuad[task] + taskQuads[task].size();
+
+	const UINT64 numQuads = firstQuad[numTasks];
+	if(numQuads * 4 > UINT64(0xffffffffu))
+		return E_OUTOFMEMORY;
+
+	try {
+		mesh.m_vertices.resize(size_t(numQuads * 4));
+		mesh.m_indices.resize(size_t(numQuads * 6));
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	ParallelFor(0, numTasks, 16, [&](UINT64 begin, UINT64 end) {
+		for(UINT64 task = begin; task < end; task++) {
+			UINT64 q = firstQuad[task];
+			for(const Quad& quad : taskQuads[task]) {
+				// corners in counter-clockwise order around the positive axis; negative faces use them in reverse
+				const UINT axis = quad.m_face / 2;
+				const UINT b = (axis + 1) % 3;
+				const UINT c = (axis + 2) % 3;
+				VoxelMeshVertex* vertices = &mesh.m_vertices[size_t(q * 4)];
+				for(UINT i = 0; i < 4; i++) {
+					vertices[i].m_position[axis] = quad.m_min[axis];
+					vertices[i].m_position[b] = (i == 1 || i == 2) ? quad.m_max[b] : quad.m_min[b];
+					vertices[i].m_position[c] = (i >= 2) ? quad.m_max[c] : quad.m_min[c];
+					vertices[i].m_face = quad.m_face;
+				}
+
+				const UINT32 base = UINT32(q * 4);
+				const bool positive = (quad.m_face & 1) == 0;
+				UINT32* indices = &mesh.m_indices[size_t(q * 6)];
+				indices[0] = base;
+				indices[1] = base + (positive ? 1 : 2);
+				indices[2] = base + (positive ? 2 : 1);
+				indices[3] = base;
+				indices[4] = base + (positive ? 2 : 3);
+				indices[5] = base + (positive ? 3 : 2);
+				q++;
+			}
+		}
+	});
+
+	return S_OK;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+HRESULT SaveVoxelMeshAsObj(const VoxelMesh& mesh, const WCHAR* fileName, const float scale[3], const float offset[3]) {
+	PROFILE_SCOPE("Write OBJ");
+
+	FILE* file = nullptr;
+	if(_wfopen_s(&file, fileName, L"w") != 0 || file == nullptr)
+		return E_FAIL;
+
+	static const char* normals[6] = { "1 0 0", "-1 0 0", "0 1 0", "0 -1 0", "0 0 1", "0 0 -1" };
+	for(UINT i = 0; i < 6; i++)
+		fprintf(file, "vn %s\n", normals[i]);
+
+	for(const VoxelMeshVertex& vertex : mesh.m_vertices) {
+		fprintf(file, "v %g %g %g\n",
+			vertex.m_position[0] * scale[0] + offset[0],
+			vertex.m_position[1] * scale[1] + offset[1],
+			vertex.m_position[2] * scale[2] + offset[2]);
+	}
+
+	for(size_t i = 0; i + 2 < mesh.m_indices.size(); i += 3) {
+		const UINT normal = mesh.m_vertices[mesh.m_indices[i]].m_face + 1;
+		fprintf(file, "f %u//%u %u//%u %u//%u\n", mesh.m_indices[i] + 1, normal, mesh.m_indices[i + 1] + 1, normal, mesh.m_indices[i + 2] + 1, normal);
+	}
+
+	const bool failed = ferror(file) != 0;
+	fclose(file);
+	return failed ? E_FAIL : S_OK;
+}
@@ -0,0 +1,40 @@
+//==============================================================================================================================================================
+// Extraction of low-polygon meshes from packed voxel grids by greedy meshing
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+#include <vector>
+
+//==============================================================================================================================================================
+
+enum VoxelFace {
+	VOXEL_FACE_POS_X,
+	VOXEL_FACE_NEG_X,
+	VOXEL_FACE_POS_Y,
+	VOXEL_FACE_NEG_Y,
+	VOXEL_FACE_POS_Z,
+	VOXEL_FACE_NEG_Z,
+};
+
+// 8 bytes per vertex: integer voxel corner in voxel space, and the face (and thus normal) the vertex belongs to
+struct VoxelMeshVertex {
+	UINT16 m_position[3];
+	UINT16 m_face;
+};
+
+// Indexed triangle list; every quad has its own four vertices, and its triangles are counter-clockwise when seen from outside.
+struct VoxelMesh {
+	std::vector<VoxelMeshVertex> m_vertices;
+	std::vector<UINT32> m_indices;
+};
+
+// Extracts the boundary of the set voxels as a quad mesh in voxel space, where voxel (x, y, z) covers [x, x+1) x [y, y+1) x [z, z+1).
+// Exposed faces are found word-wise (z shifts within columns, and masks of adjacent columns and rows along x and y) and are merged
+// into maximal rectangles per slice using bitmask scans, with the slices distributed across worker threads. Faces on the grid
+// boundary count as exposed. Grid sizes are limited to 65535 per axis.
+HRESULT ExtractVoxelMesh(const VoxelGridLayout& layout, const UINT32* voxels, VoxelMesh& mesh);
+
+// Writes the mesh as Wavefront OBJ file, mapping voxel space positions p to world space as p * scale + offset.
+HRESULT SaveVoxelMeshAsObj(const VoxelMesh& mesh, const WCHAR* fileName, const float scale[3], const float offset[3]);
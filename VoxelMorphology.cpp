@@ -0,0 +1,274 @@
+//==============================================================================================================================================================
+// Morphological operators working directly on packed voxel grids
+//==============================================================================================================================================================
+
+#include "VoxelMorphology.h"
+#include "Parallel.h"
+#include <emmintrin.h>
+#include <vector>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// rows (constant y) are processed in slabs of this height per worker thread
+	const UINT64 c_slabHeight = 8;
+
+	struct DilateOp {
+		static UINT32 Apply(UINT32 a, UINT32 b) { return a | b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+	};
+
+	struct ErodeOp {
+		static UINT32 Apply(UINT32 a, UINT32 b) { return a & b; }
+		static __m128i Apply(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+	};
+
+	inline __m128i Load(const UINT32* p) {
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+	}
+
+	inline void Store(UINT32* p, __m128i v) {
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// applies the operator to each column of a row and its z neighbors; words beyond the grid count as empty
+	template<typename Op>
+	void CombineZ(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst) {
+		const UINT numWords = layout.m_strideX;
+		const UINT lastWord = (layout.m_gridSize[2] - 1) >> 5;
+		const UINT32 lastMask = ~0u >> (31 - ((layout.m_gridSize[2] - 1) & 31));
+
+		// scalar version, which handles the first and last word of a column and the bits beyond the grid
+		auto combineWord = [&](const UINT32* column, UINT w) -> UINT32 {
+			const UINT32 c = w < lastWord ? column[w] : (w == lastWord ? column[w] & lastMask : 0u);
+			const UINT32 prev = w > 0 ? column[w - 1] : 0u;
+			const UINT32 next = w + 1 < lastWord ? column[w + 1] : (w + 1 == lastWord ? column[w + 1] & lastMask : 0u);
+			const UINT32 below = (c << 1) | (prev >> 31);
+			const UINT32 above = (c >> 1) | (next << 31);
+			return Op::Apply(c, Op::Apply(below, above)) & (w == lastWord ? lastMask : (w < lastWord ? ~0u : 0u));
+		};
+
+		for(UINT x = 0; x < layout.m_gridSize[0]; x++) {
+			const UINT32* column = src + x * layout.m_strideX;
+			UINT32* out = dst + x * layout.m_strideX;
+
+			// words 1 to lastWord - 1 have both neighbors inside the column and need no masking
+			UINT w = 0;
+			out[w] = combineWord(column, w);
+			for(w = 1; w + 4 < lastWord; w += 4) {
+				const __m128i c = Load(column + w);
+				const __m128i prev = Load(column + w - 1);
+				const __m128i next = Load(column + w + 1);
+				const __m128i below = _mm_or_si128(_mm_slli_epi32(c, 1), _mm_srli_epi32(prev, 31));
+				const __m128i above = _mm_or_si128(_mm_srli_epi32(c, 1), _mm_slli_epi32(next, 31));
+				Store(out + w, Op::Apply(c, Op::Apply(below, above)));
+			}
+			for(; w < numWords; w++)
+				out[w] = combineWord(column, w);
+		}
+	}
+
+	// applies the operator to each column of a row and its x neighbors; columns beyond the grid count as empty
+	template<typename Op>
+	void CombineX(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst) {
+		const UINT stride = layout.m_strideX;
+		const UINT rowSize = stride * layout.m_gridSize[0];
+
+		if(layout.m_gridSize[0] == 1) {
+			for(UINT i = 0; i < rowSize; i++)
+				dst[i] = Op::Apply(src[i], 0u);
+			return;
+		}
+
+		// first and last column have a single neighbor
+		for(UINT i = 0; i < stride; i++) {
+			dst[i] = Op::Apply(Op::Apply(src[i], src[i + stride]), 0u);
+			dst[rowSize - stride + i] = Op::Apply(Op::Apply(src[rowSize - stride + i], src[rowSize - 2 * stride + i]), 0u);
+		}
+
+		UINT i = stride;
+		for(; i + 4 <= rowSize - stride; i += 4)
+			Store(dst + i, Op::Apply(Load(src + i), Op::Apply(Load(src + i - stride), Load(src + i + stride))));
+		for(; i < rowSize - stride; i++)
+			dst[i] = Op::Apply(src[i], Op::Apply(src[i - stride], src[i + stride]));
+	}
+
+	// dst = op(rows[0], ..., rows[numRows - 1]), word by word
+	template<typename Op>
+	void CombineRows(UINT rowSize, const UINT32* const* rows, UINT numRows, UINT32* dst) {
+		UINT i = 0;
+		for(; i + 4 <= rowSize; i += 4) {
+			__m128i v = Load(rows[0] + i);
+			for(UINT r = 1; r < numRows; r++)
+				v = Op::Apply(v, Load(rows[r] + i));
+			Store(dst + i, v);
+		}
+		for(; i < rowSize; i++) {
+			UINT32 v = rows[0][i];
+			for(UINT r = 1; r < numRows; r++)
+				v = Op::Apply(v, rows[r][i]);
+			dst[i] = v;
+		}
+	}
+
+	// clears the bits beyond the grid's z extent, which x and y neighbors may have brought in
+	void MaskRow(const VoxelGridLayout& layout, UINT32* row) {
+		const UINT lastWord = (layout.m_gridSize[2] - 1) >> 5;
+		const UINT32 lastMask = ~0u >> (31 - ((layout.m_gridSize[2] - 1) & 31));
+		for(UINT x = 0; x < layout.m_gridSize[0]; x++) {
+			UINT32* column = row + x * layout.m_strideX;
+			column[lastWord] &= lastMask;
+			for(UINT w = lastWord + 1; w < layout.m_strideX; w++)
+				column[w] = 0u;
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------------------------------------------------------------------
+
+	// keeps a transformed version of the last three rows requested, since each one is needed for three output rows
+	class RowCache {
+	public:
+		RowCache(UINT rowSize, const UINT32* emptyRow)
+			: m_rowSize(rowSize), m_rows(3 * rowSize), m_emptyRow(emptyRow)
+		{
+			m_y[0] = m_y[1] = m_y[2] = -1;
+		}
+
+		// returns the row transformed by compute(y, dst), or an empty row for y outside of [0, sizeY)
+		template<typename Func>
+		const UINT32* Get(int y, int sizeY, const Func& compute) {
+			if(y < 0 || y >= sizeY)
+				return m_emptyRow;
+			UINT32* row = &m_rows[(y % 3) * m_rowSize];
+			if(m_y[y % 3] != y) {
+				compute(y, row);
+				m_y[y % 3] = y;
+			}
+			return row;
+		}
+
+	private:
+		UINT m_rowSize;
+		std::vector<UINT32> m_rows;
+		const UINT32* m_emptyRow;
+		int m_y[3];
+	};
+
+	template<typename Op>
+	void MorphologyStep(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst, VoxelNeighborhood neighborhood) {
+		if(layout.m_gridSize[0] == 0 || layout.m_gridSize[1] == 0 || layout.m_gridSize[2] == 0)
+			return;
+
+		const UINT rowSize = layout.m_strideX * layout.m_gridSize[0];
+		const int sizeY = int(layout.m_gridSize[1]);
+		const std::vector<UINT32> emptyRow(rowSize, 0u);
+
+		ParallelFor(0, UINT64(sizeY), c_slabHeight, [&](UINT64 begin, UINT64 end) {
+			std::vector<UINT32> temp(rowSize);
+			RowCache zRows(rowSize, emptyRow.data());			// neighbors along z
+			RowCache xRows(rowSize, emptyRow.data());			// neighbors along x
+			RowCache xzRows(rowSize, emptyRow.data());			// neighbors in the xz plane
+
+			auto srcRow = [&](int y) -> const UINT32* {
+				return y < 0 || y >= sizeY ? emptyRow.data() : src + UINT(y) * layout.m_strideY;
+			};
+			auto computeZ = [&](int y, UINT32* row) { CombineZ<Op>(layout, srcRow(y), row); };
+			auto computeX = [&](int y, UINT32* row) { CombineX<Op>(layout, srcRow(y), row); };
+			auto computeXZ = [&](int y, UINT32* row) {
+				CombineZ<Op>(layout, srcRow(y), temp.data());
+				CombineX<Op>(layout, temp.data(), row);
+			};
+
+			for(int y = int(begin); y < int(end); y++) {
+				const UINT32* rows[5];
+				UINT numRows = 0;
+
+				switch(neighborhood) {
+				case VOXEL_NEIGHBORHOOD_6:
+					rows[numRows++] = zRows.Get(y, sizeY, computeZ);
+					rows[numRows++] = xRows.Get(y, sizeY, computeX);
+					rows[numRows++] = srcRow(y - 1);
+					rows[numRows++] = srcRow(y + 1);
+					break;
+				case VOXEL_NEIGHBORHOOD_18:
+					// all offsets with at most two non-zero components
+					rows[numRows++] = xzRows.Get(y, sizeY, computeXZ);
+					rows[numRows++] = zRows.Get(y - 1, sizeY, computeZ);
+					rows[numRows++] = zRows.Get(y + 1, sizeY, computeZ);
+					rows[numRows++] = xRows.Get(y - 1, sizeY, computeX);
+					rows[numRows++] = xRows.Get(y + 1, sizeY, computeX);
+					break;
+				default:
+					rows[numRows++] = xzRows.Get(y - 1, sizeY, computeXZ);
+					rows[numRows++] = xzRows.Get(y, sizeY, computeXZ);
+					rows[numRows++] = xzRows.Get(y + 1, sizeY, computeXZ);
+					break;
+				}
+
+				UINT32* row = dst + UINT(y) * layout.m_strideY;
+				CombineRows<Op>(rowSize, rows, numRows, row);
+				MaskRow(layout, row);
+			}
+		});
+	}
+
+}
+
+//==============================================================================================================================================================
+
+void DilateVoxels(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst, VoxelNeighborhood neighborhood) {
+	MorphologyStep<DilateOp>(layout, src, dst, neighborhood);
+}
+
+void ErodeVoxels(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst, VoxelNeighborhood neighborhood) {
+	MorphologyStep<ErodeOp>(layout, src, dst, neighborhood);
+}
+
+HRESULT ApplyVoxelMorphology(const VoxelGridLayout& layout, UINT32* voxels, VoxelMorphologyOp op, VoxelNeighborhood neighborhood, UINT radius) {
+	if(voxels == nullptr || op < VOXEL_MORPHOLOGY_DILATE || op > VOXEL_MORPHOLOGY_CLOSE)
+		return E_INVALIDARG;
+	if(neighborhood != VOXEL_NEIGHBORHOOD_6 && neighborhood != VOXEL_NEIGHBORHOOD_18 && neighborhood != VOXEL_NEIGHBORHOOD_26)
+		return E_INVALIDARG;
+	if(radius == 0 || layout.m_dataSize == 0)
+		return S_OK;
+
+	std::vector<UINT32> temp;
+	try {
+		temp.assign(voxels, voxels + layout.m_dataSize);
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	// ping-pong between the grid and the temporary copy, which keeps any padding words of the layout
+	UINT32* buffers[2] = { voxels, temp.data() };
+	UINT current = 0;
+	auto step = [&](bool dilate) {
+		if(dilate)
+			DilateVoxels(layout, buffers[current], buffers[current ^ 1], neighborhood);
+		else
+			ErodeVoxels(layout, buffers[current], buffers[current ^ 1], neighborhood);
+		current ^= 1;
+	};
+
+	for(UINT pass = 0; pass < 2; pass++) {
+		bool dilate;
+		switch(op) {
+		case VOXEL_MORPHOLOGY_DILATE: dilate = true; break;
+		case VOXEL_MORPHOLOGY_ERODE: dilate = false; break;
+		case VOXEL_MORPHOLOGY_OPEN: dilate = pass == 1; break;
+		default: dilate = pass == 0; break;
+		}
+		for(UINT i = 0; i < radius; i++)
+			step(dilate);
+		if(op == VOXEL_MORPHOLOGY_DILATE || op == VOXEL_MORPHOLOGY_ERODE)
+			break;
+	}
+
+	if(current != 0)
+		std::copy(temp.begin(), temp.end(), voxels);
+
+	return S_OK;
+}
@@ -0,0 +1,32 @@
+//==============================================================================================================================================================
+// Morphological operators working directly on packed voxel grids
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//==============================================================================================================================================================
+
+enum VoxelNeighborhood {
+	VOXEL_NEIGHBORHOOD_6 = 6,			// face neighbors
+	VOXEL_NEIGHBORHOOD_18 = 18,			// face and edge neighbors
+	VOXEL_NEIGHBORHOOD_26 = 26,			// face, edge and corner neighbors
+};
+
+enum VoxelMorphologyOp {
+	VOXEL_MORPHOLOGY_DILATE,
+	VOXEL_MORPHOLOGY_ERODE,
+	VOXEL_MORPHOLOGY_OPEN,				// erode, then dilate
+	VOXEL_MORPHOLOGY_CLOSE,				// dilate, then erode
+};
+
+// Single dilation or erosion step with the voxel and its neighborhood as structuring element. Voxels outside of the grid are treated
+// as empty, so erosion removes all voxels on the grid boundary. Along z, neighbors are found by shifting the 32-bit words (carrying
+// bits between consecutive words); along x and y, neighboring columns and rows are combined word by word. src and dst must not
+// overlap; dst has the same layout as src and any bits beyond the grid's z extent are cleared.
+void DilateVoxels(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst, VoxelNeighborhood neighborhood);
+void ErodeVoxels(const VoxelGridLayout& layout, const UINT32* src, UINT32* dst, VoxelNeighborhood neighborhood);
+
+// Applies op in place, with 'radius' consecutive steps per dilation or erosion.
+HRESULT ApplyVoxelMorphology(const VoxelGridLayout& layout, UINT32* voxels, VoxelMorphologyOp op, VoxelNeighborhood neighborhood, UINT radius = 1);
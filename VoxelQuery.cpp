@@ -0,0 +1,219 @@
+//==============================================================================================================================================================
+// Batched spatial queries against packed voxel grids
+//==============================================================================================================================================================
+
+#include "VoxelQuery.h"
+#include "Parallel.h"
+#include "VoxelizationCommon.hlsli"
+#include <intrin.h>
+#include <cfloat>
+#include <vector>
+
+//==============================================================================================================================================================
+
+namespace {
+
+	// queries are sorted in batches of 2^c_batchBits, small enough for keys and results to stay in the L2 cache; the sort key holds
+	// the voxel's bit address above the query's index within the batch
+	const UINT c_batchBits = 16;
+	const UINT64 c_batchSize = UINT64(1) << c_batchBits;
+	const UINT64 c_batchIndexMask = c_batchSize - 1;
+
+	// stable LSD radix sort by the address bits of the keys
+	void SortByAddress(std::vector<UINT64>& keys, std::vector<UINT64>& temp, UINT addressBits) {
+		const UINT digitBits = 11;
+		const UINT numDigits = 1u << digitBits;
+
+		temp.resize(keys.size());
+		for(UINT shift = c_batchBits; shift < c_batchBits + addressBits; shift += digitBits) {
+			UINT offsets[numDigits] = { 0 };
+			for(UINT64 key : keys)
+				offsets[(key >> shift) & (numDigits - 1)]++;
+
+			UINT sum = 0;
+			for(UINT i = 0; i < numDigits; i++) {
+				const UINT c = offsets[i];
+				offsets[i] = sum;
+				sum += c;
+			}
+
+			for(UINT64 key : keys)
+				temp[offsets[(key >> shift) & (numDigits - 1)]++] = key;
+
+			keys.swap(temp);
+		}
+	}
+
+	// calls func(begin, end, keys, temp) for all batches, distributing them across worker threads
+	template<typename Func>
+	void ForEachBatch(UINT64 count, const Func& func) {
+		ParallelFor(0, (count + c_batchSize - 1) / c_batchSize, 1, [&](UINT64 batchBegin, UINT64 batchEnd) {
+			std::vector<UINT64> keys;
+			std::vector<UINT64> temp;
+			keys.reserve(UINT(std::min(count, c_batchSize)));
+			for(UINT64 batch = batchBegin; batch < batchEnd; batch++) {
+				const UINT64 begin = batch * c_batchSize;
+				keys.clear();
+				func(begin, std::min(begin + c_batchSize, count), keys, temp);
+			}
+		});
+	}
+
+	inline bool IsInside(float p, UINT size) {
+		return p >= 0.0f && p < float(size);		// also false for NaN
+	}
+
+	inline int ClampToGrid(float p, UINT size) {
+		return p >= 0.0f ? (p < float(size) ? int(p) : int(size) - 1) : 0;
+	}
+
+}
+
+//==============================================================================================================================================================
+
+VoxelQuery::VoxelQuery(const VoxelGridLayout& layout, const UINT32* voxels)
+	: m_layout(layout), m_voxels(voxels), m_addressBits(0)
+{
+	// number of bits needed to address any voxel bit in the buffer
+	while((UINT64(1) << m_addressBits) < (m_layout.m_dataSize << 5))
+		m_addressBits++;
+}
+
+UINT64 VoxelQuery::GetVoxelAddress(int x, int y, int z) const {
+	return (GetVoxelWordIndex(m_layout, UINT(x), UINT(y), UINT(z) >> 5) << 5) | (UINT(z) & 31);
+}
+
+bool VoxelQuery::IsSet(int x, int y, int z) const {
+	if(UINT(x) >= m_layout.m_gridSize[0] || UINT(y) >= m_layout.m_gridSize[1] || UINT(z) >= m_layout.m_gridSize[2])
+		return false;
+	const UINT64 address = GetVoxelAddress(x, y, z);
+	return (m_voxels[address >> 5] & (1u << (address & 31))) != 0u;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+UINT64 VoxelQuery::CountInBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) const {
+	// clip box to grid
+	minX = std::max(minX, 0);
+	minY = std::max(minY, 0);
+	minZ = std::max(minZ, 0);
+	maxX = std::min(maxX, int(m_layout.m_gridSize[0]));
+	maxY = std::min(maxY, int(m_layout.m_gridSize[1]));
+	maxZ = std::min(maxZ, int(m_layout.m_gridSize[2]));
+
+	if(minX >= maxX || minY >= maxY || minZ >= maxZ)
+		return 0;
+
+	// masks selecting the box's z range within the first and last word of each column
+	const UINT firstWord = UINT(minZ) >> 5;
+	const UINT lastWord = UINT(maxZ - 1) >> 5;
+	const UINT32 firstMask = ~0u << (UINT(minZ) & 31);
+	const UINT32 lastMask = ~0u >> (31 - (UINT(maxZ - 1) & 31));
+
+	UINT64 count = 0;
+	for(int y = minY; y < maxY; y++) {
+		const UINT32* column = m_voxels + GetVoxelWordIndex(m_layout, UINT(minX), UINT(y), 0);
+		for(int x = minX; x < maxX; x++) {
+			if(firstWord == lastWord) {
+				count += __popcnt(column[firstWord] & firstMask & lastMask);
+			} else {
+				count += __popcnt(column[firstWord] & firstMask);
+				for(UINT w = firstWord + 1; w < lastWord; w++)
+					count += __popcnt(column[w]);
+				count += __popcnt(column[lastWord] & lastMask);
+			}
+			column += m_layout.m_strideX;
+		}
+	}
+	return count;
+}
+
+//--------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+float VoxelQuery::IntersectSegment(float x0, float y0, float z0, float x1, float y1, float z1) const {
+	const hlsl::uint3 gridSize(m_layout.m_gridSize[0], m_layout.m_gridSize[1], m_layout.m_gridSize[2]);
+	hlsl::VoxelRayHit hit;
+	if(!hlsl::CastVoxelRay(hlsl::float3(x0, y0, z0), hlsl::float3(x1 - x0, y1 - y0, z1 - z0), 1.0f,
+		hlsl::VOXEL_RAY_TEST_START_CELL, gridSize, hlsl::Buffer<UINT32>(m_voxels), m_layout.m_strideX, m_layout.m_strideY, hit))
+	{
+		return -1.0f;
+	}
+	return hit.t;
+}
+
+float VoxelQuery::CastRay(const float origin[3], const float direction[3], int cell[3], float normal[3]) const {
+	const hlsl::uint3 gridSize(m_layout.m_gridSize[0], m_layout.m_gridSize[1], m_layout.m_gridSize[2]);
+	hlsl::VoxelRayHit hit;
+	if(!hlsl::CastVoxelRay(hlsl::float3(origin[0], origin[1], origin[2]), hlsl::float3(direction[0], direction[1], direction[2]), FLT_MAX,
+		hlsl::VOXEL_RAY_SKIP_ZERO_CELLS, gridSize, hlsl::Buffer<UINT32>(m_voxels), m_layout.m_strideX, m_layout.m_strideY, hit))
+	{
+		return -1.0f;
+	}
+
+	cell[0] = hit.cell.x;
+	cell[1] = hit.cell.y;
+	cell[2] = hit.cell.z;
+	normal[0] = hit.normal.x;
+	normal[1] = hit.normal.y;
+	normal[2] = hit.normal.z;
+	return hit.t;
+}
+
+//==============================================================================================================================================================
+
+void VoxelQuery::QueryPoints(UINT64 count, const float* x, const float* y, const float* z, UINT8* results) const {
+	ForEachBatch(count, [&](UINT64 begin, UINT64 end, std::vector<UINT64>& keys, std::vector<UINT64>& temp) {
+		for(UINT64 i = begin; i < end; i++) {
+			if(!IsInside(x[i], m_layout.m_gridSize[0]) || !IsInside(y[i], m_layout.m_gridSize[1]) || !IsInside(z[i], m_layout.m_gridSize[2])) {
+				results[i] = 0;
+				continue;
+			}
+			keys.push_back((GetVoxelAddress(int(x[i]), int(y[i]), int(z[i])) << c_batchBits) | (i - begin));
+		}
+
+		SortByAddress(keys, temp, m_addressBits);
+
+		for(UINT64 key : keys) {
+			const UINT64 address = key >> c_batchBits;
+			results[begin + (key & c_batchIndexMask)] = UINT8((m_voxels[address >> 5] >> (address & 31)) & 1u);
+		}
+	});
+}
+
+void VoxelQuery::CountInBoxes(UINT64 count, const INT32* minX, const INT32* minY, const INT32* minZ, const INT32* maxX, const INT32* maxY, const INT32* maxZ, UINT64* counts) const {
+	ForEachBatch(count, [&](UINT64 begin, UINT64 end, std::vector<UINT64>& keys, std::vector<UINT64>& temp) {
+		// order boxes by their first column
+		for(UINT64 i = begin; i < end; i++) {
+			const int x = std::max(0, std::min(int(minX[i]), int(m_layout.m_gridSize[0]) - 1));
+			const int y = std::max(0, std::min(int(minY[i]), int(m_layout.m_gridSize[1]) - 1));
+			const int z = std::max(0, std::min(int(minZ[i]), int(m_layout.m_gridSize[2]) - 1));
+			keys.push_back((GetVoxelAddress(x, y, z) << c_batchBits) | (i - begin));
+		}
+
+		SortByAddress(keys, temp, m_addressBits);
+
+		for(UINT64 key : keys) {
+			const UINT64 i = begin + (key & c_batchIndexMask);
+			counts[i] = CountInBox(minX[i], minY[i], minZ[i], maxX[i], maxY[i], maxZ[i]);
+		}
+	});
+}
+
+void VoxelQuery::IntersectSegments(UINT64 count, const float* x0, const float* y0, const float* z0, const float* x1, const float* y1, const float* z1, float* tHits) const {
+	ForEachBatch(count, [&](UINT64 begin, UINT64 end, std::vector<UINT64>& keys, std::vector<UINT64>& temp) {
+		// order segments by their start voxel
+		for(UINT64 i = begin; i < end; i++) {
+			const int x = ClampToGrid(x0[i], m_layout.m_gridSize[0]);
+			const int y = ClampToGrid(y0[i], m_layout.m_gridSize[1]);
+			const int z = ClampToGrid(z0[i], m_layout.m_gridSize[2]);
+			keys.push_back((GetVoxelAddress(x, y, z) << c_batchBits) | (i - begin));
+		}
+
+		SortByAddress(keys, temp, m_addressBits);
+
+		for(UINT64 key : keys) {
+			const UINT64 i = begin + (key & c_batchIndexMask);
+			tHits[i] = IntersectSegment(x0[i], y0[i], z0[i], x1[i], y1[i], z1[i]);
+		}
+	});
+}
@@ -0,0 +1,45 @@
+//==============================================================================================================================================================
+// Batched spatial queries against packed voxel grids
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+
+//==============================================================================================================================================================
+
+// Answers point-in-solid, box occupancy and segment queries on a voxel grid in the layout of the voxelization buffer. Coordinates are
+// given in voxel space, i.e. after transformation by g_matWorldToVoxel, so voxel (x, y, z) covers [x, x+1) x [y, y+1) x [z, z+1).
+// Queries are passed as structure-of-arrays batches; within a batch, they are reordered by grid address before being processed to
+// make memory accesses coherent, and large batches are distributed across worker threads. A VoxelQuery never modifies the grid, so
+// it may be used from several threads simultaneously.
+class VoxelQuery {
+public:
+	VoxelQuery(const VoxelGridLayout& layout, const UINT32* voxels);
+
+	// results[i] = 1 if the voxel containing point i is set, 0 otherwise (including points outside of the grid)
+	void QueryPoints(UINT64 count, const float* x, const float* y, const float* z, UINT8* results) const;
+
+	// counts[i] = number of set voxels in the integer box [min, max) of query i, which is clipped to the grid
+	void CountInBoxes(UINT64 count, const INT32* minX, const INT32* minY, const INT32* minZ, const INT32* maxX, const INT32* maxY, const INT32* maxZ, UINT64* counts) const;
+
+	// tHits[i] = segment parameter in [0, 1] at which the segment from p0 to p1 enters the first set voxel, or -1 if it hits none
+	void IntersectSegments(UINT64 count, const float* x0, const float* y0, const float* z0, const float* x1, const float* y1, const float* z1, float* tHits) const;
+
+	// single queries
+	bool IsSet(int x, int y, int z) const;
+	UINT64 CountInBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) const;
+	float IntersectSegment(float x0, float y0, float z0, float x1, float y1, float z1) const;
+
+	// Casts the ray origin + t * direction exactly like CastRay in Raycasting.hlsl, which does not test cells with a coordinate of 0, and
+	// returns the t of the point at which it enters the hit voxel, or -1 if it hits none; cell and normal receive the voxel and the
+	// normal of the faces through which the ray enters it. Meant as a reference for the raycasting pass.
+	float CastRay(const float origin[3], const float direction[3], int cell[3], float normal[3]) const;
+
+private:
+	UINT64 GetVoxelAddress(int x, int y, int z) const;
+
+	VoxelGridLayout m_layout;
+	const UINT32* m_voxels;
+	UINT m_addressBits;
+};
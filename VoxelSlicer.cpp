@@ -0,0 +1,92 @@
+//==============================================================================================================================================================
+// Extraction of z-slices from packed voxel grids as row-major bitmaps
+//==============================================================================================================================================================
+
+#include "VoxelSlicer.h"
+#include "BitOps.h"
+#include "Parallel.h"
+#include <cstring>
+
+//==============================================================================================================================================================
+
+VoxelSliceLayout MakeVoxelSliceLayout(const VoxelGridLayout& layout) {
+	VoxelSliceLayout sliceLayout;
+	sliceLayout.m_gridSize[0] = layout.m_gridSize[0];
+	sliceLayout.m_gridSize[1] = layout.m_gridSize[1];
+	sliceLayout.m_rowStride = (layout.m_gridSize[0] + 31) / 32;
+	sliceLayout.m_sliceStride = UINT64(sliceLayout.m_rowStride) * layout.m_gridSize[1];
+	return sliceLayout;
+}
+
+HRESULT ExtractVoxelSlices(const VoxelGridLayout& layout, const UINT32* voxels, UINT zBegin, UINT zEnd, UINT32* slices) {
+	if(zBegin > zEnd || zEnd > layout.m_gridSize[2])
+		return E_INVALIDARG;
+	if(zBegin == zEnd)
+		return S_OK;
+	if(voxels == nullptr || slices == nullptr)
+		return E_INVALIDARG;
+
+	const VoxelSliceLayout sliceLayout = MakeVoxelSliceLayout(layout);
+	const UINT wBegin = zBegin >> 5;
+	const UINT wEnd = (zEnd + 31) >> 5;
+
+	// Per row of the grid, the words [wBegin, wEnd) of each block of 32 columns are loaded and transposed in one pass, which reads
+	// the columns sequentially, and the resulting slice rows are assembled in a buffer; the rows of the slices in [zBegin, zEnd) are
+	// then copied out one after the other. Storing the transposed words directly would hit 32 slices in turn, whose stride usually is
+	// a power of two, so that they would evict each other from the cache. The rows are split evenly between the workers, each of which
+	// has its own buffer.
+	const UINT numWorkers = std::min(GetWorkerThreadCount(), layout.m_gridSize[1]);
+	const UINT64 bufferSize = 32 * UINT64(wEnd - wBegin) * sliceLayout.m_rowStride;
+
+	std::vector<UINT32> buffers;
+	try {
+		buffers.resize(size_t(numWorkers * bufferSize));
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	ParallelFor(0, numWorkers, 1, [&](UINT64 workerBegin, UINT64 workerEnd) {
+		for(UINT64 worker = workerBegin; worker < workerEnd; worker++) {
+			// slice row z of the row of the grid is buffer + (z - wBegin * 32) * m_rowStride
+			UINT32* buffer = &buffers[size_t(worker * bufferSize)];
+			UINT32 m[32];
+
+			const UINT yBegin = UINT(worker * layout.m_gridSize[1] / numWorkers);
+			const UINT yEnd = UINT((worker + 1) * layout.m_gridSize[1] / numWorkers);
+			for(UINT y = yBegin; y < yEnd; y++) {
+				const UINT32* gridRow = voxels + GetVoxelWordIndex(layout, 0, y, 0);
+				for(UINT xBlock = 0; xBlock < sliceLayout.m_rowStride; xBlock++) {
+					const UINT x0 = xBlock * 32;
+					const UINT numColumns = std::min(32u, layout.m_gridSize[0] - x0);
+					const UINT32* src = gridRow + UINT64(x0) * layout.m_strideX;
+
+					for(UINT w = wBegin; w < wEnd; w++) {
+						// gather word w of 32 columns: bit j of m[i] is voxel (x0 + i, y, w * 32 + j)
+						UINT32 any = 0;
+						for(UINT i = 0; i < numColumns; i++) {
+							m[i] = src[UINT64(i) * layout.m_strideX + w];
+							any |= m[i];
+						}
+						for(UINT i = numColumns; i < 32; i++)
+							m[i] = 0;
+
+						// transpose, so that bit i of m[j] is voxel (x0 + i, y, w * 32 + j)
+						if(any != 0)
+							Transpose32x32Sse2(m);
+
+						UINT32* rows = buffer + UINT64(w - wBegin) * 32 * sliceLayout.m_rowStride + xBlock;
+						for(UINT j = 0; j < 32; j++)
+							rows[j * sliceLayout.m_rowStride] = m[j];
+					}
+				}
+
+				for(UINT z = zBegin; z < zEnd; z++) {
+					UINT32* dst = slices + (z - zBegin) * sliceLayout.m_sliceStride + UINT64(y) * sliceLayout.m_rowStride;
+					memcpy(dst, buffer + UINT64(z - wBegin * 32) * sliceLayout.m_rowStride, sliceLayout.m_rowStride * sizeof(UINT32));
+				}
+			}
+		}
+	});
+
+	return S_OK;
+}
@@ -0,0 +1,59 @@
+//==============================================================================================================================================================
+// Extraction of z-slices from packed voxel grids as row-major bitmaps
+//==============================================================================================================================================================
+
+#pragma once
+
+#include "VoxelGrid.h"
+#include <algorithm>
+#include <vector>
+
+//==============================================================================================================================================================
+
+// Layout of one z-slice as bitmap: voxel (x, y) is bit (x & 31) of word y * m_rowStride + (x >> 5). Slices of consecutive z follow
+// each other at m_sliceStride words, so a stack of all slices is the grid in z-major order.
+struct VoxelSliceLayout {
+	UINT m_gridSize[2];				// x, y
+	UINT m_rowStride;				// in words
+	UINT64 m_sliceStride;			// in words
+};
+
+VoxelSliceLayout MakeVoxelSliceLayout(const VoxelGridLayout& layout);
+
+// Writes the slices [zBegin, zEnd) of a grid in the layout of the voxelization buffer to slices, which has to hold
+// (zEnd - zBegin) * m_sliceStride words. Since the grid packs z into the bits of each word, every block of 32 columns along x and 32
+// voxels along z is a 32x32 bit matrix whose transpose holds 32 slice words. The rows of the grid are distributed across worker
+// threads, each of which reads the words of a row covering [zBegin, zEnd) in a single pass.
+HRESULT ExtractVoxelSlices(const VoxelGridLayout& layout, const UINT32* voxels, UINT zBegin, UINT zEnd, UINT32* slices);
+
+// upper bound for the slices buffered by ForEachVoxelSlice, unless a single block of 32 slices exceeds it
+const UINT64 c_maxVoxelSliceBlockWords = UINT64(1) << 24;		// 64 MiB
+
+// Calls func(z, slice) for all slices in ascending z, and stops at the first failure returned by func. The slices are extracted
+// into a reused buffer in blocks of as many multiples of 32 slices as fit into c_maxVoxelSliceBlockWords, which usually is the
+// whole stack, so that the grid is streamed once by a single team of worker threads.
+template<typename Func>
+HRESULT ForEachVoxelSlice(const VoxelGridLayout& layout, const UINT32* voxels, const Func& func) {
+	const VoxelSliceLayout sliceLayout = MakeVoxelSliceLayout(layout);
+	const UINT64 wordsPerBlock = std::max<UINT64>(1, c_maxVoxelSliceBlockWords / (32 * std::max<UINT64>(sliceLayout.m_sliceStride, 1)));
+	const UINT slicesPerBlock = UINT(std::min<UINT64>(wordsPerBlock * 32, layout.m_gridSize[2]));
+
+	std::vector<UINT32> slices;
+	try {
+		slices.resize(size_t(sliceLayout.m_sliceStride * slicesPerBlock));
+	} catch(const std::bad_alloc&) {
+		return E_OUTOFMEMORY;
+	}
+
+	HRESULT hr;
+	for(UINT zBegin = 0; zBegin < layout.m_gridSize[2]; zBegin += slicesPerBlock) {
+		const UINT zEnd = std::min(zBegin + slicesPerBlock, layout.m_gridSize[2]);
+		if(FAILED(hr = ExtractVoxelSlices(layout, voxels, zBegin, zEnd, slices.data())))
+			return hr;
+		for(UINT z = zBegin; z < zEnd; z++) {
+			if(FAILED(hr = func(z, static_cast<const UINT32*>(&slices[size_t((z - zBegin) * sliceLayout.m_sliceStride)]))))
+				return hr;
+		}
+	}
+	return S_OK;
+}
@@ -8,6 +8,7 @@ cbuffer cbVoxelGrid : register(b0) {
 cbuffer cbModelInput : register(b1) {
 	uint g_numModelTriangles;
 	uint g_vertexFloatStride;
+	uint g_triangleSetupStride;
 };
 
 //==============================================================================================================================================================
@@ -17,6 +18,8 @@ RWByteAddressBuffer g_rwbufVoxels : register(u1);
 Buffer<float> g_bufVertices : register(t0);
 Buffer<uint> g_bufIndices : register(t1);
 
+#include "VoxelizationCommon.hlsli"
+
 //==============================================================================================================================================================
 
 struct VSInput_Model {
@@ -69,9 +72,10 @@ PSOutput_Color PS_VoxelizeSurface(PSInput_Voxelize input) {
 PSOutput_Color PS_VoxelizeSolid(PSInput_Voxelize input) {
 	PSOutput_Color output;
 
-	// determine first voxel
+	// determine first voxel; crossings in front of the grid, which are not clipped, flip the whole column
 	float3 gridPos = input.gridPos.xyz / input.gridPos.w;
 	int3 p = int3(gridPos.x, gridPos.y, gridPos.z + 0.5);
+	p.z = max(p.z, 0);
 
 	// flip all voxels below
 	if(p.z < int(g_gridSize.z)) {
@@ -93,8 +97,60 @@ PSOutput_Color PS_VoxelizeSolid(PSInput_Voxelize input) {
 
 //==============================================================================================================================================================
 
+// Triangle setup stream, written by CS_SetupTriangles for the current g_matModelToVoxel and read by the compute shader voxelizations
+// compiled with TRIANGLE_SETUP = 1 instead of gathering and transforming the vertices themselves. A 16-byte header holding the number
+// of triangles is followed by c_numTriangleSetupArrays arrays of g_triangleSetupStride bytes, each with one float4 per triangle:
+// - v0 in voxel space, the vertices being ordered ascending by index, with the dominant axis of the normal (0, 1, 2 for x, y, z) in w
+// - the unnormalized normal cross(v1 - v0, v2 - v0)
+// - minimum and maximum of the bounding box in voxel space
+// - for each of the yz, xz and xy projections, the equations (ne, de) of the edges v0v1, v1v2 and v2v0 without the offsets of the
+//   conservative tests (see Determine2dEdge), evaluated at the edge's vertex of lower index so that triangles sharing an edge agree
+// Degenerate triangles are removed. In a closed mesh, they cover no voxels beyond those of the triangles sharing their edges.
+#ifndef TRIANGLE_SETUP
+#define TRIANGLE_SETUP 0
+#endif
+
+static const uint c_triangleSetupV0 = 0;
+static const uint c_triangleSetupNormal = 1;
+static const uint c_triangleSetupMin = 2;
+static const uint c_triangleSetupMax = 3;
+static const uint c_triangleSetupEdges = 4;			// three arrays for each of the yz, xz and xy projections
+static const uint c_numTriangleSetupArrays = 13;
+
+RWByteAddressBuffer g_rwbufTriangleSetup : register(u2);
+ByteAddressBuffer g_bufTriangleSetup : register(t3);
+
+uint GetTriangleSetupAddress(uint tri, uint array) {
+	return 16 + array * g_triangleSetupStride + tri * 16;
+}
+
+float4 LoadTriangleSetup(uint tri, uint array) {
+	return asfloat(g_bufTriangleSetup.Load4(GetTriangleSetupAddress(tri, array)));
+}
+
+// loads the edge equations of the given projection (0: yz, 1: xz, 2: xy)
+void LoadTriangleSetupEdges(uint tri, uint projection, out float2 ne0, out float de0, out float2 ne1, out float de1, out float2 ne2, out float de2) {
+	const float4 edge0 = LoadTriangleSetup(tri, c_triangleSetupEdges + projection * 3);
+	const float4 edge1 = LoadTriangleSetup(tri, c_triangleSetupEdges + projection * 3 + 1);
+	const float4 edge2 = LoadTriangleSetup(tri, c_triangleSetupEdges + projection * 3 + 2);
+	ne0 = edge0.xy; de0 = edge0.z;
+	ne1 = edge1.xy; de1 = edge1.z;
+	ne2 = edge2.xy; de2 = edge2.z;
+}
+
+void StoreTriangleSetupEdges(uint tri, uint projection, float orientation, float2 e0, float2 e1, float2 e2, float2 v0, float2 v1) {
+	float2 ne;
+	float de;
+	Determine2dEdgeEquation(ne, de, orientation, e0.x, e0.y, v0.x, v0.y);
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(tri, c_triangleSetupEdges + projection * 3), asuint(float4(ne, de, 0.0)));
+	Determine2dEdgeEquation(ne, de, orientation, e1.x, e1.y, v1.x, v1.y);
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(tri, c_triangleSetupEdges + projection * 3 + 1), asuint(float4(ne, de, 0.0)));
+	Determine2dEdgeEquation(ne, de, orientation, e2.x, e2.y, v0.x, v0.y);
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(tri, c_triangleSetupEdges + projection * 3 + 2), asuint(float4(ne, de, 0.0)));
+}
+
 [numthreads(256, 1, 1)]
-void CS_VoxelizeSolid(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
+void CS_SetupTriangles(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
 	const uint c_numthreads = 256;
 	const uint c_groupCountX = 256;
 
@@ -105,18 +161,74 @@ void CS_VoxelizeSolid(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
 		return;
 
 	// load triangle's vertices and order them ascending by index
-	uint3 indices;
-	indices.x = g_bufIndices[tri * 3];
-	indices.y = g_bufIndices[tri * 3 + 1];
-	indices.z = g_bufIndices[tri * 3 + 2];
+	const uint3 indices = SortTriangleIndices(uint3(g_bufIndices[tri * 3], g_bufIndices[tri * 3 + 1], g_bufIndices[tri * 3 + 2]));
+
+	float3 v0, v1, v2;
+	v0.x = g_bufVertices[indices.x * g_vertexFloatStride];
+	v0.y = g_bufVertices[indices.x * g_vertexFloatStride + 1];
+	v0.z = g_bufVertices[indices.x * g_vertexFloatStride + 2];
+	v1.x = g_bufVertices[indices.y * g_vertexFloatStride];
+	v1.y = g_bufVertices[indices.y * g_vertexFloatStride + 1];
+	v1.z = g_bufVertices[indices.y * g_vertexFloatStride + 2];
+	v2.x = g_bufVertices[indices.z * g_vertexFloatStride];
+	v2.y = g_bufVertices[indices.z * g_vertexFloatStride + 1];
+	v2.z = g_bufVertices[indices.z * g_vertexFloatStride + 2];
+
+	// transform vertices to voxel space
+	float4 v;
+	v = mul(g_matModelToVoxel, float4(v0, 1.0)); v0 = v.xyz / v.w;
+	v = mul(g_matModelToVoxel, float4(v1, 1.0)); v1 = v.xyz / v.w;
+	v = mul(g_matModelToVoxel, float4(v2, 1.0)); v2 = v.xyz / v.w;
+
+	// remove degenerate triangles
+	const float3 e0 = v1-v0;
+	const float3 e1 = v2-v1;
+	const float3 e2 = v0-v2;
+	const float3 n = cross(e2, e0);
+
+	if(all(n == 0.0))
+		return;
+
+	// determine dominant axis as CS_VoxelizeSurfaceConservative does
+	const uint dominantAxis = DetermineDominantAxis(normalize(n));
+
+	// append triangle
+	uint setupTri;
+	g_rwbufTriangleSetup.InterlockedAdd(0, 1, setupTri);
+
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(setupTri, c_triangleSetupV0), uint4(asuint(v0), dominantAxis));
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(setupTri, c_triangleSetupNormal), asuint(float4(n, 0.0)));
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(setupTri, c_triangleSetupMin), asuint(float4(min(v0, min(v1, v2)), 0.0)));
+	g_rwbufTriangleSetup.Store4(GetTriangleSetupAddress(setupTri, c_triangleSetupMax), asuint(float4(max(v0, max(v1, v2)), 0.0)));
+
+	StoreTriangleSetupEdges(setupTri, 0, n.x < 0.0 ? -1.0 : 1.0, e0.yz, e1.yz, e2.yz, v0.yz, v1.yz);
+	StoreTriangleSetupEdges(setupTri, 1, n.y > 0.0 ? -1.0 : 1.0, e0.xz, e1.xz, e2.xz, v0.xz, v1.xz);
+	StoreTriangleSetupEdges(setupTri, 2, n.z < 0.0 ? -1.0 : 1.0, e0.xy, e1.xy, e2.xy, v0.xy, v1.xy);
+}
+
+//==============================================================================================================================================================
+
+[numthreads(256, 1, 1)]
+void CS_VoxelizeSolid(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
+	const uint c_numthreads = 256;
+	const uint c_groupCountX = 256;
 
-	uint i0 = min(indices.x, indices.y);
-	uint i1 = max(indices.x, indices.y);
+	// determine triangle
+	const uint tri = gtidx + gid.x * c_numthreads + gid.y * c_numthreads * c_groupCountX;
+
+#if TRIANGLE_SETUP
+	if(tri >= g_bufTriangleSetup.Load(0))
+		return;
 
-	indices.x = min(i0, indices.z);
-	i0        = max(i0, indices.z);
-	indices.y = min(i1, i0);
-	indices.z = max(i1, i0);
+	// load bounding box in xz
+	const float2 vMin = LoadTriangleSetup(tri, c_triangleSetupMin).xz;
+	const float2 vMax = LoadTriangleSetup(tri, c_triangleSetupMax).xz;
+#else
+	if(tri >= g_numModelTriangles)
+		return;
+
+	// load triangle's vertices and order them ascending by index
+	const uint3 indices = SortTriangleIndices(uint3(g_bufIndices[tri * 3], g_bufIndices[tri * 3 + 1], g_bufIndices[tri * 3 + 2]));
 
 	float3 v0, v1, v2;
 	v0.x = g_bufVertices[indices.x * g_vertexFloatStride];
@@ -138,22 +250,17 @@ void CS_VoxelizeSolid(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
 	// determine bounding box in xz
 	const float2 vMin = float2(min(v0.x, min(v1.x, v2.x)), min(v0.z, min(v1.z, v2.z)));
 	const float2 vMax = float2(max(v0.x, max(v1.x, v2.x)), max(v0.z, max(v1.z, v2.z)));
+#endif
 
-	// derive bounding box of covered voxel columns
-	const int2 voxMin = int2(max(0, int(floor(vMin.x + 0.4999))),
-	                         max(0, int(floor(vMin.y + 0.4999))));
-	const int2 voxMax = int2(min(int(g_gridSize.x), int(floor(vMax.x + 0.5))),
-	                         min(int(g_gridSize.z), int(floor(vMax.y + 0.5))));
-
-	// check if any voxel columns are covered at all
-	if(voxMin.x >= voxMax.x || voxMin.y >= voxMax.y)
+	// derive bounding box of covered voxel columns and check if any are covered at all
+	int2 voxMin, voxMax;
+	if(!DetermineSolidColumns(vMin, vMax, g_gridSize, voxMin, voxMax))
 		return;
 
-	// triangle setup
-	const float3 e0 = v1-v0;
-	const float3 e1 = v2-v1;
-	const float3 e2 = v2-v0;
-	const float3 n = cross(e0, e2);
+#if TRIANGLE_SETUP
+	// load plane and edge equations in xz
+	const float3 v0 = LoadTriangleSetup(tri, c_triangleSetupV0).xyz;
+	const float3 n = LoadTriangleSetup(tri, c_triangleSetupNormal).xyz;
 
 	if(n.y == 0.0)
 		return;
@@ -162,59 +269,32 @@ void CS_VoxelizeSolid(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
 	const float dTri = -dot(n, v0);
 
 	// edge equations
-	float2 ne0 = float2(-e0.z,  e0.x);
-	float2 ne1 = float2(-e1.z,  e1.x);
-	float2 ne2 = float2( e2.z, -e2.x);
-	if(n.y > 0.0) {
-		ne0 = -ne0;
-		ne1 = -ne1;
-		ne2 = -ne2;
-	}
-
-	const float de0 = -(ne0.x * v0.x + ne0.y * v0.z);
-	const float de1 = -(ne1.x * v1.x + ne1.y * v1.z);
-	const float de2 = -(ne2.x * v0.x + ne2.y * v0.z);
-
-	// determine whether edge is left edge or top edge
-	const float eps = 1.175494351e-38f;		// smallest normalized positive number
-
-	float ce0 = 0.0;
-	float ce1 = 0.0;
-	float ce2 = 0.0;
-
-	if(ne0.x > 0.0 || (ne0.x == 0.0 && ne0.y < 0.0))
-		ce0 = eps;
-	if(ne1.x > 0.0 || (ne1.x == 0.0 && ne1.y < 0.0))
-		ce1 = eps;
-	if(ne2.x > 0.0 || (ne2.x == 0.0 && ne2.y < 0.0))
-		ce2 = eps;
-
-	const float nyInv = 1.0 / n.y;
-
-	// determine covered pixels/voxel columns
-	for(int z = voxMin.y; z < voxMax.y; z++) {
-		for(int x = voxMin.x; x < voxMax.x; x++) {
-			// pixel center
-			float2 p = float2(float(x) + 0.5, float(z) + 0.5);
-
-			// test whether pixel is inside triangle
-			// if it is exactly on an edge, the ce* term makes the expression positive if the edge is a left or top edge
-			if((dot(ne0, p) + de0) + ce0 <= 0.0) continue;
-			if((dot(ne1, p) + de1) + ce1 <= 0.0) continue;
-			if((dot(ne2, p) + de2) + ce2 <= 0.0) continue;
+	float2 ne0, ne1, ne2;
+	float de0, de1, de2;
+	LoadTriangleSetupEdges(tri, 1, ne0, de0, ne1, de1, ne2, de2);
+#else
+	// triangle setup as in CS_SetupTriangles
+	const float3 e0 = v1-v0;
+	const float3 e1 = v2-v1;
+	const float3 e2 = v0-v2;
+	const float3 n = cross(e2, e0);
 
-			// project p onto plane along y axis (ray/plane intersection)
-			const float py = -(p.x * n.x + p.y * n.z + dTri) * nyInv;
+	if(n.y == 0.0)
+		return;
 
-			int y = max(0, int(py + 0.5));
-			if(int(g_gridSize.y) <= y)
-				continue;
+	// triangle's plane
+	const float dTri = -dot(n, v0);
 
-			// flip voxel's state
-			uint address = uint(x) * g_stride.x + uint(y) * g_stride.y + (uint(z) >> 5) * 4;
-			g_rwbufVoxels.InterlockedXor(address, 1u << (z & 31));
-		}
-	}
+	// edge equations
+	float2 ne0, ne1, ne2;
+	float de0, de1, de2;
+	const float orientation = n.y > 0.0 ? -1.0 : 1.0;
+	Determine2dEdgeEquation(ne0, de0, orientation, e0.x, e0.z, v0.x, v0.z);
+	Determine2dEdgeEquation(ne1, de1, orientation, e1.x, e1.z, v1.x, v1.z);
+	Determine2dEdgeEquation(ne2, de2, orientation, e2.x, e2.z, v0.x, v0.z);
+#endif
+
+	VoxelizeSolidColumns(g_rwbufVoxels, g_gridSize, g_stride.x, g_stride.y, voxMin, voxMax, n, dTri, ne0, de0, ne1, de1, ne2, de2);
 }
 
 //--------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -245,11 +325,15 @@ void CS_VoxelizeSolid_Propagate(uint gtidx : SV_GroupIndex, uint3 gid : SV_Group
 
 //==============================================================================================================================================================
 
-void Determine2dEdge(out float2 ne, out float de, float orientation, float edge_x, float edge_y, float vertex_x, float vertex_y) {
-	ne = float2(-orientation * edge_y, orientation * edge_x);
-	de = -(ne.x * vertex_x + ne.y * vertex_y);
-	de += max(0.0, ne.x);
-	de += max(0.0, ne.y);
+// loads the edge equations of the given projection from the triangle setup stream and adds the offsets of Determine2dEdge
+void LoadConservative2dEdges(uint tri, uint projection, out float2 ne0, out float de0, out float2 ne1, out float de1, out float2 ne2, out float de2) {
+	LoadTriangleSetupEdges(tri, projection, ne0, de0, ne1, de1, ne2, de2);
+	de0 += max(0.0, ne0.x);
+	de0 += max(0.0, ne0.y);
+	de1 += max(0.0, ne1.x);
+	de1 += max(0.0, ne1.y);
+	de2 += max(0.0, ne2.x);
+	de2 += max(0.0, ne2.y);
 }
 
 [numthreads(256, 1, 1)]
@@ -260,6 +344,14 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 	// determine triangle
 	const uint tri = gtidx + gid.x * c_numthreads + gid.y * c_numthreads * c_groupCountX;
 
+#if TRIANGLE_SETUP
+	if(tri >= g_bufTriangleSetup.Load(0))
+		return;
+
+	// load bounding box
+	const float3 vMin = LoadTriangleSetup(tri, c_triangleSetupMin).xyz;
+	const float3 vMax = LoadTriangleSetup(tri, c_triangleSetupMax).xyz;
+#else
 	if(tri >= g_numModelTriangles)
 		return;
 
@@ -293,59 +385,31 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 	const float3 vMax = float3(max(v0.x, max(v1.x, v2.x)),
 	                           max(v0.y, max(v1.y, v2.y)),
 	                           max(v0.z, max(v1.z, v2.z)));
+#endif
 
-	float3 voxOrigMin = float3(floor(vMin.x),
-	                           floor(vMin.y),
-	                           floor(vMin.z));
-	voxOrigMin -= voxOrigMin == vMin;
-	const float3 voxOrigMax = float3(floor(vMax.x + 1.0),
-	                                 floor(vMax.y + 1.0),
-	                                 floor(vMax.z + 1.0));
-
-	const float3 voxOrigExtent = voxOrigMax - voxOrigMin;
-
-	// determine bounding box clipped to voxel grid
-	const float3 voxMin = float3(max(0.0, voxOrigMin.x),
-	                             max(0.0, voxOrigMin.y),
-	                             max(0.0, voxOrigMin.z));
-	const float3 voxMax = float3(min(float(g_gridSize.x), voxOrigMax.x),
-	                             min(float(g_gridSize.y), voxOrigMax.y),
-	                             min(float(g_gridSize.z), voxOrigMax.z));
-
-	const float3 voxExtent = voxMax - voxMin;
-
-	// check if any voxels are covered at all
-	if(any(voxExtent <= 0.0))
+	// determine bounding box clipped to voxel grid and dimensions of unclipped extent, and check if any voxels are covered at all
+	float3 voxMin, voxMax;
+	uint flatDimensions;
+	if(!DetermineConservativeBounds(vMin, vMax, g_gridSize, voxMin, voxMax, flatDimensions))
 		return;
 
-	// determine dimensions of unclipped extent
-	const uint FLATDIM_X = 4;
-	const uint FLATDIM_Y = 8;
-	const uint FLATDIM_Z = 16;
-
-	uint flatDimensions = 0;
-	if(voxOrigExtent.x == 1.0) flatDimensions += 1 | FLATDIM_X;
-	if(voxOrigExtent.y == 1.0) flatDimensions += 1 | FLATDIM_Y;
-	if(voxOrigExtent.z == 1.0) flatDimensions += 1 | FLATDIM_Z;
-
 	//---- 1D: set all voxels in bounding box ----
 	if((flatDimensions & 3) >= 2) {
 		uint address = uint(voxMin.x) * g_stride.x + uint(voxMin.y) * g_stride.y + (uint(voxMin.z) >> 5) * 4;
+		const uint2 range = DetermineLineRange(voxMin, voxMax, flatDimensions);
 
 		// 1x1xN: set all voxels, up to 32 consecutive ones at a time
 		if((flatDimensions & FLATDIM_Z) == 0) {
-			const uint voxMax_z = uint(voxMin.z);
-
-			uint voxels = (~0u) << (uint(voxMin.z) & 31);
-			uint lastZ = (uint(voxMax_z) & (~31));
+			uint voxels = (~0u) << (range.x & 31);
+			const uint lastZ = range.y & (~31);
 
-			for(uint z = uint(voxMin.z); z < lastZ; z += 32) {
+			for(uint z = range.x & (~31); z < lastZ; z += 32) {
 				g_rwbufVoxels.InterlockedOr(address, voxels);
 				address += 4;
 				voxels = ~0;
 			}
 
-			uint restCount = uint(voxMax_z) & 31;
+			const uint restCount = range.y & 31;
 			if(restCount > 0) {
 				voxels &= ~(0xffffffff << restCount);
 				g_rwbufVoxels.InterlockedOr(address, voxels);
@@ -355,7 +419,7 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 		// Nx1x1 or 1xNx1: set all voxels, one at a time
 		else {
 			const uint stride = (flatDimensions & FLATDIM_X) == 0 ? g_stride.x : g_stride.y;
-			const uint count = uint(max(voxExtent.x, voxExtent.y));
+			const uint count = range.y - range.x;
 			const uint voxels = 1u << (uint(voxMin.z) & 31);
 
 			for(uint i = 0; i < count; i++) {
@@ -367,11 +431,18 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 
 	//---- 2D or 3D ----
 	else {
+#if TRIANGLE_SETUP
+		// load triangle setup
+		const float4 v0_dominantAxis = LoadTriangleSetup(tri, c_triangleSetupV0);
+		const float3 v0 = v0_dominantAxis.xyz;
+		float3 n = LoadTriangleSetup(tri, c_triangleSetupNormal).xyz;
+#else
 		// triangle setup
 		const float3 e0 = v1-v0;
 		const float3 e1 = v2-v1;
 		const float3 e2 = v0-v2;
 		float3 n = cross(e2, e0);
+#endif
 
 		//---- 2D: test only for 2D triangle/voxel overlap ----
 		if((flatDimensions & 3) == 1) {
@@ -382,10 +453,14 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 				float2 ne0, ne1, ne2;
 				float  de0, de1, de2;
 
+#if TRIANGLE_SETUP
+				LoadConservative2dEdges(tri, 2, ne0, de0, ne1, de1, ne2, de2);
+#else
 				const float orientation = n.z < 0.0 ? -1.0 : 1.0;
 				Determine2dEdge(ne0, de0, orientation, e0.x, e0.y, v0.x, v0.y);
 				Determine2dEdge(ne1, de1, orientation, e1.x, e1.y, v1.x, v1.y);
 				Determine2dEdge(ne2, de2, orientation, e2.x, e2.y, v2.x, v2.y);
+#endif
 
 				const uint voxels = 1 << (int(voxMin.z) & 31);
 
@@ -415,18 +490,26 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 				float pxMax;
 
 				if(flatDimensions & FLATDIM_X) {
+#if TRIANGLE_SETUP
+					LoadConservative2dEdges(tri, 0, ne0, de0, ne1, de1, ne2, de2);
+#else
 					const float orientation = n.x < 0.0 ? -1.0 : 1.0;
 					Determine2dEdge(ne0, de0, orientation, e0.y, e0.z, v0.y, v0.z);
 					Determine2dEdge(ne1, de1, orientation, e1.y, e1.z, v1.y, v1.z);
 					Determine2dEdge(ne2, de2, orientation, e2.y, e2.z, v2.y, v2.z);
+#endif
 					stride = g_stride.y;
 					p.x = voxMin.y;
 					pxMax = voxMax.y;
 				} else {
+#if TRIANGLE_SETUP
+					LoadConservative2dEdges(tri, 1, ne0, de0, ne1, de1, ne2, de2);
+#else
 					const float orientation = n.y > 0.0 ? -1.0 : 1.0;
 					Determine2dEdge(ne0, de0, orientation, e0.x, e0.z, v0.x, v0.z);
 					Determine2dEdge(ne1, de1, orientation, e1.x, e1.z, v1.x, v1.z);
 					Determine2dEdge(ne2, de2, orientation, e2.x, e2.z, v2.x, v2.z);
+#endif
 					stride = g_stride.x;
 					p.x = voxMin.x;
 					pxMax = voxMax.x;
@@ -466,6 +549,22 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 		else {
 			n = normalize(n);
 
+#if TRIANGLE_SETUP
+			// load edge equations and add offsets
+			float2 ne0_xy, ne1_xy, ne2_xy;
+			float de0_xy, de1_xy, de2_xy;
+			LoadConservative2dEdges(tri, 2, ne0_xy, de0_xy, ne1_xy, de1_xy, ne2_xy, de2_xy);
+
+			float2 ne0_xz, ne1_xz, ne2_xz;
+			float de0_xz, de1_xz, de2_xz;
+			LoadConservative2dEdges(tri, 1, ne0_xz, de0_xz, ne1_xz, de1_xz, ne2_xz, de2_xz);
+
+			float2 ne0_yz, ne1_yz, ne2_yz;
+			float de0_yz, de1_yz, de2_yz;
+			LoadConservative2dEdges(tri, 0, ne0_yz, de0_yz, ne1_yz, de1_yz, ne2_yz, de2_yz);
+
+			const uint dominantAxis = asuint(v0_dominantAxis.w);
+#else
 			// determine edge equations and offsets
 			float2 ne0_xy, ne1_xy, ne2_xy;
 			float de0_xy, de1_xy, de2_xy;
@@ -488,10 +587,11 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 			Determine2dEdge(ne1_yz, de1_yz, orientation_yz, e1.y, e1.z, v1.y, v1.z);
 			Determine2dEdge(ne2_yz, de2_yz, orientation_yz, e2.y, e2.z, v2.y, v2.z);
 
-			const float maxComponentValue = max(abs(n.x), max(abs(n.y), abs(n.z)));
+			const uint dominantAxis = DetermineDominantAxis(n);
+#endif
 
 			// triangle aligns best to yz
-			if(maxComponentValue == abs(n.x)) {
+			if(dominantAxis == 0) {
 				// make normal point in +x direction
 				if(n.x < 0.0) {
 					n.x = -n.x;
@@ -499,16 +599,9 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 					n.z = -n.z;
 				}
 
-				// determine triangle plane equation and offset
+				// determine triangle plane equation and offsets
 				const float dTri = -dot(n, v0);
-
-				float dTriProjMin = dTri;
-				dTriProjMin += max(0.0, n.y);
-				dTriProjMin += max(0.0, n.z);
-
-				float dTriProjMax = dTri;
-				dTriProjMax += min(0.0, n.y);
-				dTriProjMax += min(0.0, n.z);
+				const float2 dTriProj = DetermineProjectedPlaneOffsets(dTri, n.y, n.z);
 
 				const float nxInv = 1.0 / n.x;
 
@@ -521,16 +614,10 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 						   (ne1_yz.x * p.y + ne1_yz.y * p.z + de1_yz >= 0.0) &&
 						   (ne2_yz.x * p.y + ne2_yz.y * p.z + de2_yz >= 0.0))
 						{
-							// determine x range: project adjusted p onto plane along x axis (ray/plane intersection)
-							float x = -(p.y * n.y + p.z * n.z + dTriProjMin) * nxInv;
-							float minX = floor(x);
-							if(x == minX) minX--;
-							minX = max(voxMin.x, minX);
-
-							x = -(p.y * n.y + p.z * n.z + dTriProjMax) * nxInv + 1.0;
-							float maxX = floor(x);
-							maxX = max(maxX, minX + 1.0);
-							maxX = min(voxMax.x, maxX);
+							// determine x range
+							const float2 rangeX = DetermineDepthRange(p.y * n.y + p.z * n.z, dTriProj, nxInv, voxMin.x, voxMax.x);
+							const float minX = rangeX.x;
+							const float maxX = rangeX.y;
 
 							// test voxels in x range
 							uint address = address0 + uint(minX) * g_stride.x + (uint(p.z) >> 5) * 4;
@@ -555,7 +642,7 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 			}
 
 			// triangle aligns best to xz
-			else if(maxComponentValue == abs(n.y)) {
+			else if(dominantAxis == 1) {
 				// make normal point in +y direction
 				if(n.y < 0.0) {
 					n.x = -n.x;
@@ -563,16 +650,9 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 					n.z = -n.z;
 				}
 
-				// determine triangle plane equation and offset
+				// determine triangle plane equation and offsets
 				const float dTri = -dot(n, v0);
-
-				float dTriProjMin = dTri;
-				dTriProjMin += max(0.0, n.x);
-				dTriProjMin += max(0.0, n.z);
-
-				float dTriProjMax = dTri;
-				dTriProjMax += min(0.0, n.x);
-				dTriProjMax += min(0.0, n.z);
+				const float2 dTriProj = DetermineProjectedPlaneOffsets(dTri, n.x, n.z);
 
 				const float nyInv = 1.0 / n.y;
 
@@ -585,16 +665,10 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 						   (ne1_xz.x * p.x + ne1_xz.y * p.z + de1_xz >= 0.0) &&
 						   (ne2_xz.x * p.x + ne2_xz.y * p.z + de2_xz >= 0.0))
 						{
-							// determine y range: project adjusted p onto plane along y axis (ray/plane intersection)
-							float y = -(p.x * n.x + p.z * n.z + dTriProjMin) * nyInv;
-							float minY = floor(y);
-							if(y == minY) minY--;
-							minY = max(voxMin.y, minY);
-
-							y = -(p.x * n.x + p.z * n.z + dTriProjMax) * nyInv + 1.0;
-							float maxY = floor(y);
-							maxY = max(maxY, minY + 1.0);
-							maxY = min(voxMax.y, maxY);
+							// determine y range
+							const float2 rangeY = DetermineDepthRange(p.x * n.x + p.z * n.z, dTriProj, nyInv, voxMin.y, voxMax.y);
+							const float minY = rangeY.x;
+							const float maxY = rangeY.y;
 
 							// test voxels in y range
 							uint address = address0 + uint(minY) * g_stride.y + (uint(p.z) >> 5) * 4;
@@ -627,16 +701,9 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 					n.z = -n.z;
 				}
 
-				// determine triangle plane equation and offset
+				// determine triangle plane equation and offsets
 				const float dTri = -dot(n, v0);
-
-				float dTriProjMin = dTri;
-				dTriProjMin += max(0.0, n.x);
-				dTriProjMin += max(0.0, n.y);
-
-				float dTriProjMax = dTri;
-				dTriProjMax += min(0.0, n.x);
-				dTriProjMax += min(0.0, n.y);
+				const float2 dTriProj = DetermineProjectedPlaneOffsets(dTri, n.x, n.y);
 
 				const float nzInv = 1.0 / n.z;
 
@@ -650,16 +717,10 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 						   (ne1_xy.x * p.x + ne1_xy.y * p.y + de1_xy >= 0.0) &&
 						   (ne2_xy.x * p.x + ne2_xy.y * p.y + de2_xy >= 0.0))
 						{
-							// determine z range: project adjusted p onto plane along z axis (ray/plane intersection)
-							float z = -(p.x * n.x + p.y * n.y + dTriProjMin) * nzInv;
-							float minZ = floor(z);
-							if(z == minZ) minZ--;
-							minZ = max(voxMin.z, minZ);
-
-							z = -(p.x * n.x + p.y * n.y + dTriProjMax) * nzInv + 1.0;
-							float maxZ = floor(z);
-							maxZ = max(maxZ, minZ + 1.0);
-							maxZ = min(voxMax.z, maxZ);
+							// determine z range
+							const float2 rangeZ = DetermineDepthRange(p.x * n.x + p.y * n.y, dTriProj, nzInv, voxMin.z, voxMax.z);
+							const float minZ = rangeZ.x;
+							const float maxZ = rangeZ.y;
 
 							// test voxels in z range
 							uint address = address1 + (uint(minZ) >> 5) * 4;
@@ -698,3 +759,93 @@ void CS_VoxelizeSurfaceConservative(uint gtidx : SV_GroupIndex, uint3 gid : SV_G
 		}
 	}
 }
+
+//==============================================================================================================================================================
+
+// Dilation or erosion of a voxelization, writing one 32-bit word per thread from g_bufVoxelsIn to g_rwbufVoxels. The operator and
+// the structuring element are selected at compile time by MORPHOLOGY_ERODE (0 or 1) and MORPHOLOGY_NEIGHBORHOOD (6, 18 or 26); see
+// VoxelMorphology.h for the CPU counterpart.
+#ifndef MORPHOLOGY_ERODE
+#define MORPHOLOGY_ERODE 0
+#endif
+#ifndef MORPHOLOGY_NEIGHBORHOOD
+#define MORPHOLOGY_NEIGHBORHOOD 26
+#endif
+
+Buffer<uint> g_bufVoxelsIn : register(t2);
+
+uint MorphologyCombine(uint a, uint b) {
+#if MORPHOLOGY_ERODE
+	return a & b;
+#else
+	return a | b;
+#endif
+}
+
+// word w of column (x, y) with the bits beyond the grid cleared; words outside of the grid are empty
+uint LoadVoxelWord(int x, int y, uint w) {
+	const uint lastWord = (g_gridSize.z - 1) >> 5;
+	if(x < 0 || y < 0 || x >= int(g_gridSize.x) || y >= int(g_gridSize.y) || w > lastWord)
+		return 0;
+
+	uint voxels = g_bufVoxelsIn[(x * g_stride.x + y * g_stride.y) / 4 + w];
+	if(w == lastWord)
+		voxels &= 0xffffffffu >> (31 - ((g_gridSize.z - 1) & 31));
+	return voxels;
+}
+
+// combines each voxel of the word with its z neighbors by shifting, carrying bits over from the adjacent words
+uint LoadVoxelWordZ(int x, int y, uint w) {
+	const uint voxels = LoadVoxelWord(x, y, w);
+	const uint below = (voxels << 1) | (LoadVoxelWord(x, y, w - 1) >> 31);
+	const uint above = (voxels >> 1) | (LoadVoxelWord(x, y, w + 1) << 31);
+	return MorphologyCombine(voxels, MorphologyCombine(below, above));
+}
+
+[numthreads(256, 1, 1)]
+void CS_Morphology(uint gtidx : SV_GroupIndex, uint3 gid : SV_GroupID) {
+	const uint c_numthreads = 256;
+	const uint c_groupCountX = 256;
+
+	const uint section = gtidx + gid.x * c_numthreads + gid.y * c_numthreads * c_groupCountX;
+
+	if(section >= (g_stride.y >> 2) * g_gridSize.y)
+		return;
+
+	// determine column and word
+	const uint wordsPerColumn = g_stride.x >> 2;
+	const uint wordsPerRow = g_stride.y >> 2;
+	const int y = section / wordsPerRow;
+	const int x = (section - y * wordsPerRow) / wordsPerColumn;
+	const uint w = section - y * wordsPerRow - x * wordsPerColumn;
+
+	uint voxels = LoadVoxelWordZ(x, y, w);
+	[unroll]
+	for(int dy = -1; dy <= 1; dy++) {
+		[unroll]
+		for(int dx = -1; dx <= 1; dx++) {
+			if(dx == 0 && dy == 0)
+				continue;
+#if MORPHOLOGY_NEIGHBORHOOD == 6
+			if(dx == 0 || dy == 0)
+				voxels = MorphologyCombine(voxels, LoadVoxelWord(x + dx, y + dy, w));
+#elif MORPHOLOGY_NEIGHBORHOOD == 18
+			if(dx == 0 || dy == 0)
+				voxels = MorphologyCombine(voxels, LoadVoxelWordZ(x + dx, y + dy, w));
+			else
+				voxels = MorphologyCombine(voxels, LoadVoxelWord(x + dx, y + dy, w));
+#else
+			voxels = MorphologyCombine(voxels, LoadVoxelWordZ(x + dx, y + dy, w));
+#endif
+		}
+	}
+
+	// keep bits beyond the grid cleared
+	const uint lastWord = (g_gridSize.z - 1) >> 5;
+	if(w > lastWord)
+		voxels = 0;
+	else if(w == lastWord)
+		voxels &= 0xffffffffu >> (31 - ((g_gridSize.z - 1) & 31));
+
+	g_rwbufVoxels.Store(section * 4, voxels);
+}
@@ -0,0 +1,388 @@
+//==============================================================================================================================================================
+// Voxelization and ray casting code shared by the shaders and the CPU implementation
+//==============================================================================================================================================================
+
+// This file is written in the common subset of HLSL and C++. Voxelization.hlsl and Raycasting.hlsl include it as is; the CPU voxelizer,
+// VoxelQuery and MeshRaycaster compile it as C++ in namespace hlsl, where HlslShim.h provides the vector types, intrinsics and buffers.
+// To stay in that subset, floating-point literals carry the f suffix (unsuffixed ones would be double in C++), vectors are constructed
+// from all of their components, out and inout parameters are declared with HLSL_OUT and HLSL_INOUT and buffers are passed to the
+// functions rather than accessed as globals. Voxel addresses are 64-bit on the CPU, where grids may exceed 4 GiB.
+
+#ifndef VOXELIZATION_COMMON_HLSLI
+#define VOXELIZATION_COMMON_HLSLI
+
+#ifdef __cplusplus
+#include "HlslShim.h"
+#define HLSL_OUT(type) type&
+#define HLSL_INOUT(type) type&
+namespace hlsl {
+typedef UINT64 VoxelAddress;
+#else
+#define HLSL_OUT(type) out type
+#define HLSL_INOUT(type) inout type
+typedef uint VoxelAddress;
+#endif
+
+//==============================================================================================================================================================
+// Triangle setup
+//==============================================================================================================================================================
+
+// orders a triangle's vertex indices ascending, so that triangles sharing an edge set it up from the same vertices
+inline uint3 SortTriangleIndices(uint3 indices) {
+	uint i0 = min(indices.x, indices.y);
+	uint i1 = max(indices.x, indices.y);
+
+	indices.x = min(i0, indices.z);
+	i0        = max(i0, indices.z);
+	indices.y = min(i1, i0);
+	indices.z = max(i1, i0);
+	return indices;
+}
+
+// axis (0, 1, 2 for x, y, z) of the largest component of the normalized normal n; on ties, x is preferred over y over z
+inline uint DetermineDominantAxis(float3 n) {
+	const float3 nAbs = abs(n);
+	const float maxComponentValue = max(nAbs.x, max(nAbs.y, nAbs.z));
+	return maxComponentValue == nAbs.x ? 0u : (maxComponentValue == nAbs.y ? 1u : 2u);
+}
+
+// equation dot(ne, p) + de of the 2D edge through vertex along edge, positive on the left side for orientation 1
+inline void Determine2dEdgeEquation(HLSL_OUT(float2) ne, HLSL_OUT(float) de, float orientation, float edge_x, float edge_y, float vertex_x, float vertex_y) {
+	ne = float2(-orientation * edge_y, orientation * edge_x);
+	de = -(ne.x * vertex_x + ne.y * vertex_y);
+}
+
+// edge equation offset such that it is non-negative at the minimum corner p of every unit cell that overlaps the edge's inner half plane
+inline void Determine2dEdge(HLSL_OUT(float2) ne, HLSL_OUT(float) de, float orientation, float edge_x, float edge_y, float vertex_x, float vertex_y) {
+	Determine2dEdgeEquation(ne, de, orientation, edge_x, edge_y, vertex_x, vertex_y);
+	de += max(0.0f, ne.x);
+	de += max(0.0f, ne.y);
+}
+
+// term making an edge equation positive rather than zero at points on the edge if it is a left or top edge, and changing nothing else
+inline float DetermineTopLeftBias(float2 ne) {
+	const float eps = 1.175494351e-38f;		// smallest normalized positive number
+	return (ne.x > 0.0f || (ne.x == 0.0f && ne.y < 0.0f)) ? eps : 0.0f;
+}
+
+//==============================================================================================================================================================
+// Solid voxelization
+//==============================================================================================================================================================
+
+// Determines the range [voxMin, voxMax) in xz of the voxel columns whose centers the triangle with xz bounding box [vMin, vMax] may
+// cover, clipped to the grid; returns false if there are none.
+inline bool DetermineSolidColumns(float2 vMin, float2 vMax, uint3 gridSize, HLSL_OUT(int2) voxMin, HLSL_OUT(int2) voxMax) {
+	voxMin = int2(max(0, int(floor(vMin.x + 0.4999f))),
+	              max(0, int(floor(vMin.y + 0.4999f))));
+	voxMax = int2(min(int(gridSize.x), int(floor(vMax.x + 0.5f))),
+	              min(int(gridSize.z), int(floor(vMax.y + 0.5f))));
+	return voxMin.x < voxMax.x && voxMin.y < voxMax.y;
+}
+
+// Flips, for each voxel column in [voxMin, voxMax) whose center lies inside of the triangle's xz projection, the voxel in which the
+// column crosses the triangle's plane dot(n, p) + dTri = 0, which must not be parallel to y. The edge equations ne*, de* are those
+// of CS_SetupTriangles for xz. A center exactly on an edge is inside if the edge is a left or top edge, so that a column through an
+// edge shared by two triangles flips one voxel, not two or none.
+inline void VoxelizeSolidColumns(RWByteAddressBuffer voxels, uint3 gridSize, VoxelAddress strideX, VoxelAddress strideY, int2 voxMin, int2 voxMax,
+                                 float3 n, float dTri, float2 ne0, float de0, float2 ne1, float de1, float2 ne2, float de2)
+{
+	// determine whether edge is left edge or top edge
+	const float ce0 = DetermineTopLeftBias(ne0);
+	const float ce1 = DetermineTopLeftBias(ne1);
+	const float ce2 = DetermineTopLeftBias(ne2);
+
+	const float nyInv = 1.0f / n.y;
+
+	// determine covered pixels/voxel columns
+	for(int z = voxMin.y; z < voxMax.y; z++) {
+		for(int x = voxMin.x; x < voxMax.x; x++) {
+			// pixel center
+			const float2 p = float2(float(x) + 0.5f, float(z) + 0.5f);
+
+			// test whether pixel is inside triangle
+			// if it is exactly on an edge, the ce* term makes the expression positive if the edge is a left or top edge
+			if((dot(ne0, p) + de0) + ce0 <= 0.0f) continue;
+			if((dot(ne1, p) + de1) + ce1 <= 0.0f) continue;
+			if((dot(ne2, p) + de2) + ce2 <= 0.0f) continue;
+
+			// project p onto plane along y axis (ray/plane intersection)
+			const float py = -(p.x * n.x + p.y * n.z + dTri) * nyInv;
+
+			const int y = max(0, int(py + 0.5f));
+			if(int(gridSize.y) <= y)
+				continue;
+
+			// flip voxel's state
+			const VoxelAddress address = (VoxelAddress)x * strideX + (VoxelAddress)y * strideY + ((VoxelAddress)z >> 5) * 4;
+			voxels.InterlockedXor(address, 1u << (z & 31));
+		}
+	}
+}
+
+//==============================================================================================================================================================
+// Conservative surface voxelization
+//==============================================================================================================================================================
+
+// dimensions in which a triangle's unclipped voxel bounding box is one voxel thick; the lowest two bits count them
+static const uint FLATDIM_X = 4;
+static const uint FLATDIM_Y = 8;
+static const uint FLATDIM_Z = 16;
+
+// Determines the bounding box [voxMin, voxMax) of the voxels touched by the triangle with bounding box [vMin, vMax], clipped to the
+// grid, and the FLATDIM_* flags of its unclipped extent; returns false if no voxels are covered.
+inline bool DetermineConservativeBounds(float3 vMin, float3 vMax, uint3 gridSize, HLSL_OUT(float3) voxMin, HLSL_OUT(float3) voxMax, HLSL_OUT(uint) flatDimensions) {
+	float3 voxOrigMin = float3(floor(vMin.x),
+	                           floor(vMin.y),
+	                           floor(vMin.z));
+	if(voxOrigMin.x == vMin.x) voxOrigMin.x--;
+	if(voxOrigMin.y == vMin.y) voxOrigMin.y--;
+	if(voxOrigMin.z == vMin.z) voxOrigMin.z--;
+	const float3 voxOrigMax = float3(floor(vMax.x + 1.0f),
+	                                 floor(vMax.y + 1.0f),
+	                                 floor(vMax.z + 1.0f));
+
+	const float3 voxOrigExtent = voxOrigMax - voxOrigMin;
+
+	// determine bounding box clipped to voxel grid
+	voxMin = float3(max(0.0f, voxOrigMin.x),
+	                max(0.0f, voxOrigMin.y),
+	                max(0.0f, voxOrigMin.z));
+	voxMax = float3(min(float(gridSize.x), voxOrigMax.x),
+	                min(float(gridSize.y), voxOrigMax.y),
+	                min(float(gridSize.z), voxOrigMax.z));
+
+	// determine dimensions of unclipped extent
+	flatDimensions = 0;
+	if(voxOrigExtent.x == 1.0f) flatDimensions += 1 | FLATDIM_X;
+	if(voxOrigExtent.y == 1.0f) flatDimensions += 1 | FLATDIM_Y;
+	if(voxOrigExtent.z == 1.0f) flatDimensions += 1 | FLATDIM_Z;
+
+	// check if any voxels are covered at all
+	const float3 voxExtent = voxMax - voxMin;
+	return !(voxExtent.x <= 0.0f || voxExtent.y <= 0.0f || voxExtent.z <= 0.0f);
+}
+
+// Range [begin, end) of the voxels along the one axis along which the clipped bounding box [voxMin, voxMax) of a triangle that is flat
+// in at least two dimensions is longer than one voxel: z for 1x1xN, x for Nx1x1 and y for 1xNx1, which also covers 1x1x1.
+inline uint2 DetermineLineRange(float3 voxMin, float3 voxMax, uint flatDimensions) {
+	if((flatDimensions & FLATDIM_Z) == 0)
+		return uint2(uint(voxMin.z), uint(voxMax.z));
+	if((flatDimensions & FLATDIM_X) == 0)
+		return uint2(uint(voxMin.x), uint(voxMax.x));
+	return uint2(uint(voxMin.y), uint(voxMax.y));
+}
+
+// Offsets (min, max) of the triangle's plane dot(n, p) + dTri, with n pointing in the positive direction of the dominant axis and
+// na, nb its other two components, by which a voxel's minimum corner is moved towards the plane's near and far side.
+inline float2 DetermineProjectedPlaneOffsets(float dTri, float na, float nb) {
+	float dTriProjMin = dTri;
+	dTriProjMin += max(0.0f, na);
+	dTriProjMin += max(0.0f, nb);
+
+	float dTriProjMax = dTri;
+	dTriProjMax += min(0.0f, na);
+	dTriProjMax += min(0.0f, nb);
+
+	return float2(dTriProjMin, dTriProjMax);
+}
+
+// Range [min, max) along the dominant axis of the voxels in the column at p that may touch the triangle's plane, where nDotP is the dot
+// product of p and the normal without the dominant axis, nInv is 1 over the normal's dominant component and dTriProj are the offsets of
+// DetermineProjectedPlaneOffsets. The range covers at least one voxel before it is clipped to [voxMin, voxMax).
+inline float2 DetermineDepthRange(float nDotP, float2 dTriProj, float nInv, float voxMin, float voxMax) {
+	// project adjusted p onto plane along dominant axis (ray/plane intersection)
+	float d = -(nDotP + dTriProj.x) * nInv;
+	float minD = floor(d);
+	if(d == minD) minD--;
+	minD = max(voxMin, minD);
+
+	d = -(nDotP + dTriProj.y) * nInv + 1.0f;
+	float maxD = floor(d);
+	maxD = max(maxD, minD + 1.0f);
+	maxD = min(voxMax, maxD);
+
+	return float2(minD, maxD);
+}
+
+//==============================================================================================================================================================
+// Ray casting
+//==============================================================================================================================================================
+
+// voxel pos of a grid of 32-bit words with strides in words
+inline bool IsVoxelSet(Buffer<uint> voxels, VoxelAddress strideX, VoxelAddress strideY, int3 pos) {
+	const VoxelAddress p = (VoxelAddress)pos.x * strideX + (VoxelAddress)pos.y * strideY + (VoxelAddress)(pos.z >> 5);
+	const int bit = pos.z & 31;
+	return (voxels[p] & (1u << uint(bit))) != 0u;
+}
+
+struct VoxelRayHit {
+	int3 cell;
+	float t;				// ray parameter of pos
+	float3 pos;				// point at which the ray enters the cell
+	float3 normal;			// normalized sum of the normals of the faces through which the ray enters the cell, zero along the other axes
+};
+
+// options of CastVoxelRay
+static const uint VOXEL_RAY_TEST_START_CELL = 1;		// also test the cell containing the ray's origin, reporting a hit there at t = 0 with a zero normal
+static const uint VOXEL_RAY_SKIP_ZERO_CELLS = 2;		// do not test cells with a coordinate of 0, as the raycasting pass
+
+// Traversal of the voxels along a ray, stepping from cell to cell as in [Amanatides and Woo 1987]. It starts in the cell containing
+// the ray's origin or, if the origin lies outside of the grid, in the cell just before the ray enters it, so cell may lie outside of
+// the grid. The t of the cell boundaries are kept relative to t0 to retain precision for origins far from the grid.
+struct VoxelRayTraversal {
+	int3 cell;
+	int3 cellStep;
+	float3 deltaT;			// distance in t between the cell boundaries along each axis
+	float3 tMax;			// t at which the ray leaves the cell along each axis, relative to t0
+	float3 tMaxPrev;		// tMax before the last step
+	float t0;				// t at which the traversal starts
+	float t;				// t at which the ray enters the cell, relative to t0
+	float tEnter;			// t at which the ray enters the grid, 0 if its origin lies inside
+	float tExit;			// t at which the ray leaves the grid or ends, whichever comes first
+};
+
+// Sets up the traversal of the voxels along the ray o + t * d, t in [0, tEnd], through the grid; returns false if that part of the
+// ray misses the grid.
+inline bool BeginVoxelRayTraversal(float3 o, float3 d, uint3 gridSize, float tEnd, HLSL_OUT(VoxelRayTraversal) ray) {
+	const float fltMax = 3.402823466e+38f;
+	const float eps = exp2(-50.0f);
+
+	ray.cell = int3(0, 0, 0);
+	ray.cellStep = int3(0, 0, 0);
+	ray.deltaT = float3(0.0f, 0.0f, 0.0f);
+	ray.tMax = float3(fltMax, fltMax, fltMax);
+	ray.tMaxPrev = float3(fltMax, fltMax, fltMax);
+	ray.t0 = 0.0f;
+	ray.t = 0.0f;
+	ray.tEnter = 0.0f;
+	ray.tExit = 0.0f;
+
+	if(abs(d.x) < eps) d.x = d.x < 0.0f ? -eps : eps;
+	if(abs(d.y) < eps) d.y = d.y < 0.0f ? -eps : eps;
+	if(abs(d.z) < eps) d.z = d.z < 0.0f ? -eps : eps;
+
+	float3 deltaT = 1.0f / d;
+
+	// determine intersection points with voxel grid box
+	const float3 tBox0 = (0.0f - o) * deltaT;
+	const float3 tBox1 = (float3(gridSize) - o) * deltaT;
+
+	const float3 tBoxMax = max(tBox0, tBox1);
+	const float3 tBoxMin = min(tBox0, tBox1);
+
+	const float tEnter = max(tBoxMin.x, max(tBoxMin.y, tBoxMin.z));
+	const float tExit  = min(tEnd, min(tBoxMax.x, min(tBoxMax.y, tBoxMax.z)));
+
+	if(!(tEnter <= tExit) || tExit < 0.0f)		// also true for NaN
+		return false;
+
+	deltaT = abs(deltaT);
+	const float t0 = max(tEnter - 0.5f * min(deltaT.x, min(deltaT.y, deltaT.z)), 0.0f);		// start outside grid unless origin is inside
+
+	const float3 p = o + t0 * d;
+
+	int3 cellStep = int3(1, 1, 1);
+	if(d.x < 0.0f) cellStep.x = -1;
+	if(d.y < 0.0f) cellStep.y = -1;
+	if(d.z < 0.0f) cellStep.z = -1;
+
+	int3 cell = int3(int(floor(p.x)),
+	                 int(floor(p.y)),
+	                 int(floor(p.z)));
+
+	if(d.x < 0.0f && frac(p.x) == 0.0f) cell.x--;
+	if(d.y < 0.0f && frac(p.y) == 0.0f) cell.y--;
+	if(d.z < 0.0f && frac(p.z) == 0.0f) cell.z--;
+
+	float3 tMax = float3(fltMax, fltMax, fltMax);
+	if(d.x > 0.0f) tMax.x = (float(cell.x + 1) - p.x) * deltaT.x;
+	if(d.x < 0.0f) tMax.x = (p.x - float(cell.x)) * deltaT.x;
+	if(d.y > 0.0f) tMax.y = (float(cell.y + 1) - p.y) * deltaT.y;
+	if(d.y < 0.0f) tMax.y = (p.y - float(cell.y)) * deltaT.y;
+	if(d.z > 0.0f) tMax.z = (float(cell.z + 1) - p.z) * deltaT.z;
+	if(d.z < 0.0f) tMax.z = (p.z - float(cell.z)) * deltaT.z;
+
+	ray.cell = cell;
+	ray.cellStep = cellStep;
+	ray.deltaT = deltaT;
+	ray.tMax = tMax;
+	ray.t0 = t0;
+	ray.tEnter = max(tEnter, 0.0f);
+	ray.tExit = tExit;
+	return true;
+}
+
+// Steps the traversal into the next cell along the ray; returns false, leaving the traversal unchanged, if the ray leaves the grid or
+// ends before reaching it.
+inline bool StepVoxelRayTraversal(HLSL_INOUT(VoxelRayTraversal) ray) {
+	const float t = min(ray.tMax.x, min(ray.tMax.y, ray.tMax.z));
+	if(ray.t0 + t >= ray.tExit)
+		return false;
+
+	ray.t = t;
+	ray.tMaxPrev = ray.tMax;
+	if(ray.tMax.x <= t) { ray.tMax.x += ray.deltaT.x; ray.cell.x += ray.cellStep.x; }
+	if(ray.tMax.y <= t) { ray.tMax.y += ray.deltaT.y; ray.cell.y += ray.cellStep.y; }
+	if(ray.tMax.z <= t) { ray.tMax.z += ray.deltaT.z; ray.cell.z += ray.cellStep.z; }
+	return true;
+}
+
+// whether cell lies inside of the grid, is tested with the VOXEL_RAY_ options and is set
+inline bool IsVoxelRayCellSet(int3 cell, uint options, uint3 gridSize, Buffer<uint> voxels, VoxelAddress strideX, VoxelAddress strideY) {
+	const int minCell = (options & VOXEL_RAY_SKIP_ZERO_CELLS) != 0u ? 1 : 0;
+	if(cell.x < minCell || cell.y < minCell || cell.z < minCell)
+		return false;
+	if(cell.x >= int(gridSize.x) || cell.y >= int(gridSize.y) || cell.z >= int(gridSize.z))
+		return false;
+	return IsVoxelSet(voxels, strideX, strideY, cell);
+}
+
+// Traverses the voxels along the ray o + t * d, t in [0, tEnd], through the grid until it hits a set voxel, testing the cells as
+// selected by options, a combination of the VOXEL_RAY_ flags. Returns false if the ray misses the grid or leaves it or ends without
+// hitting a voxel.
+inline bool CastVoxelRay(float3 o, float3 d, float tEnd, uint options, uint3 gridSize, Buffer<uint> voxels, VoxelAddress strideX, VoxelAddress strideY,
+                         HLSL_OUT(VoxelRayHit) hit)
+{
+	hit.cell = int3(0, 0, 0);
+	hit.t = 0.0f;
+	hit.pos = float3(0.0f, 0.0f, 0.0f);
+	hit.normal = float3(0.0f, 0.0f, 0.0f);
+
+	VoxelRayTraversal ray;
+	if(!BeginVoxelRayTraversal(o, d, gridSize, tEnd, ray))
+		return false;
+
+	bool isSet = false;
+	if((options & VOXEL_RAY_TEST_START_CELL) != 0u)
+		isSet = IsVoxelRayCellSet(ray.cell, options, gridSize, voxels, strideX, strideY);
+
+	// traverse voxel grid until ray hits a voxel or grid is left
+	const int maxSteps = int(gridSize.x + gridSize.y + gridSize.z + 1);
+	for(int i = 0; i < maxSteps && !isSet; i++) {
+		if(!StepVoxelRayTraversal(ray))
+			return false;
+		isSet = IsVoxelRayCellSet(ray.cell, options, gridSize, voxels, strideX, strideY);
+	}
+	if(!isSet)
+		return false;
+
+	// process hit point
+	float3 n = float3(0.0f, 0.0f, 0.0f);
+	if(ray.tMaxPrev.x <= ray.t) n.x = d.x > 0.0f ? -1.0f : 1.0f;
+	if(ray.tMaxPrev.y <= ray.t) n.y = d.y > 0.0f ? -1.0f : 1.0f;
+	if(ray.tMaxPrev.z <= ray.t) n.z = d.z > 0.0f ? -1.0f : 1.0f;
+
+	hit.cell = ray.cell;
+	hit.t = ray.t0 + ray.t;
+	hit.pos = o + hit.t * d;
+	hit.normal = dot(n, n) > 0.0f ? normalize(n) : n;		// zero for a hit in the start cell
+	return true;
+}
+
+//==============================================================================================================================================================
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif